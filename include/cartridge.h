@@ -1,6 +1,7 @@
 #ifndef CARTRIDGE_H
 #define CARTRIDGE_H
 
+#include "region.h"
 #include "system.h"
 
 #include <stdbool.h>
@@ -8,8 +9,18 @@
 
 int cartridgeLoadRom( const char* filepath );
 void deleteRom();
+// From the loaded ROM's header
+Region cartridgeRegion();
 
 void cartridgeMemoryAccess( MemoryAddress addressBus, uint8_t *dataBus, bool writeLine );
+// Host pointer to the ROM byte at addressBus, or NULL if unmapped.
+// contiguousBytes receives how many bytes follow linearly from the pointer.
+const uint8_t *cartridgeHostPointer( MemoryAddress addressBus, uint32_t *contiguousBytes );
+
+// Header heuristics, usable on any ROM image in host memory (e.g. from tools).
+// size is the full image size, including the copier header if skip_header is set.
+int cartridgeScoreHiROM( const uint8_t *rom, const uint32_t size, const bool skip_header );
+int cartridgeScoreLoROM( const uint8_t *rom, const uint32_t size, const bool skip_header );
 
 
 #endif //CARTRIDGE_H
\ No newline at end of file
@@ -6,10 +6,15 @@
 
 void cpuInitialise();
 
-void cpuTick();
+// One master clock tick, built for each region's timing
+void cpuTickNTSC();
+void cpuTickPAL();
 
 // DMA needs this - TODO - consider moving stuff so this isn't accessible
 void MemoryAccess( MemoryAddress addressBus, uint8_t *dataBus, bool writeLine );
+// Direct host pointer for DMA fast paths, NULL if the address isn't plain memory
+uint8_t *ABusHostPointer( MemoryAddress addressBus, uint32_t *contiguousBytes, bool writeLine );
+int32_t ABusWRAMIndex( MemoryAddress addressBus );
 
 // true for v-blank, false for h-blank
 void vBlank( bool level );
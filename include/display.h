@@ -0,0 +1,34 @@
+#ifndef DISPLAY_H
+#define DISPLAY_H
+
+#include "framebuffer.h"
+
+#include <stdbool.h>
+
+// Where finished frames go. One backend is selected before startup and is
+// handed the framebuffer once per frame.
+
+typedef struct DisplayBackend {
+    const char *name;
+    FramebufferFormat preferredFormat;
+    // target is backend specific, e.g. an output path. May be NULL.
+    bool ( *open )( const Framebuffer *framebuffer, const char *target );
+    void ( *present )( const Framebuffer *framebuffer );
+    void ( *close )();
+} DisplayBackend;
+
+extern const DisplayBackend displayBackendWindow; // display_x11.c
+extern const DisplayBackend displayBackendPPM; // display_capture.c
+extern const DisplayBackend displayBackendPNG; // display_capture.c
+extern const DisplayBackend displayBackendY4M; // display_capture.c
+extern const DisplayBackend displayBackendNone;
+
+// Pick a backend by name ("window", "ppm", "png", "y4m", "none"). Defaults to the window.
+bool displaySelect( const char *name, const char *target );
+FramebufferFormat displayPreferredFormat();
+
+bool displayOpen( const Framebuffer *framebuffer );
+void displayPresent( const Framebuffer *framebuffer );
+void displayClose();
+
+#endif// DISPLAY_H
@@ -1,9 +1,23 @@
 #ifndef DMA_H
 #define DMA_H
 
+#include "system.h"
+
 #include <stdint.h>
 #include <stdbool.h>
 
+#define HDMA_MAX_LINES              240
+#define HDMA_MAX_WRITES_PER_LINE    32 // 8 channels, 4 byte transfer units
+
+// One byte of HDMA. A->B writes carry the value read from the table at compile
+// time; B->A transfers read the B-bus when applied and write to ABusAddress.
+typedef struct HDMAWrite {
+    uint8_t BBusAddress;
+    uint8_t value;
+    bool BToA;
+    MemoryAddress ABusAddress;
+} HDMAWrite;
+
 void dmaInitialise();
 // Returns true if DMA in progress
 bool dmaTick();
@@ -11,4 +25,10 @@ void dmaPortAccess( uint16_t portBus, uint8_t *dataBus, bool writeLine );
 void dmaHBlank();
 void dmaVBlank( bool level );
 
+// Mark the compiled HDMA schedule of the given channels stale (e.g. a watched table in WRAM changed)
+void dmaHDMAInvalidate( uint8_t channels );
+// Transfers HDMA will make at the end of the given line of the current frame.
+// Channels with tables outside WRAM and ROM are read as they run, and aren't included.
+const HDMAWrite *dmaHDMALineWrites( uint16_t line, uint8_t *numWrites );
+
 #endif //DMA_H
\ No newline at end of file
@@ -4,8 +4,16 @@
 #include <stdbool.h>
 #include <stdint.h>
 
+// Play through PortAudio, the default. Without it samples are only produced by dspNextSample.
+// Builds with DSP_NO_PORTAUDIO never play.
+void dspUseAudioOutput( bool enable );
 void dspInitialise();
+// All 128 registers, e.g. from a snapshot, after dspInitialise and once the SPC700's RAM
+// holds the samples. Voices the registers show as sounding are started.
+void dspLoadRegisters( const uint8_t *values );
 void dspTick();
+// Mix the next 32KHz stereo frame
+void dspNextSample( int16_t *left, int16_t *right );
 void accessDspAddressLatch( uint8_t *dataBus, bool writeLine );
 void accessDspRegister( uint8_t *dataBus, bool writeLine );
 
@@ -0,0 +1,25 @@
+#ifndef FRAME_HASH_H
+#define FRAME_HASH_H
+
+#include "framebuffer.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// 64-bit hashes of presented frames, for checking that changes to rendering
+// don't change its output. Hashes are stable across hosts and SIMD levels.
+
+// Hash of the visible pixels, their dimensions and format
+uint64_t frameHash( const Framebuffer *framebuffer );
+
+// Write "frame hash" lines to logPath, and/or compare against a golden file in
+// the same format, stopping execution at the first frame that differs.
+// Either path may be NULL. Call before startup.
+bool frameHashOpen( const char *logPath, const char *goldenPath );
+bool frameHashEnabled();
+void frameHashPresent( const Framebuffer *framebuffer );
+// True once a frame hasn't matched its golden hash
+bool frameHashFailed();
+void frameHashClose();
+
+#endif// FRAME_HASH_H
@@ -0,0 +1,65 @@
+#ifndef FRAMEBUFFER_H
+#define FRAMEBUFFER_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Emulator-owned picture the PPU renders into, presented once per frame
+
+typedef enum FramebufferFormat {
+    FRAMEBUFFER_BGR555,     // 16-bit, the PPU's native colour format
+    FRAMEBUFFER_XRGB8888,   // 32-bit, 0x00RRGGBB
+} FramebufferFormat;
+
+// The size can change from frame to frame, up to the size it was allocated with
+typedef struct Framebuffer {
+    uint8_t *pixels;
+    uint32_t pitch; // Bytes per line
+    uint16_t width;
+    uint16_t height;
+    uint16_t maxWidth;
+    uint16_t maxHeight;
+    FramebufferFormat format;
+    uint64_t frameCount; // Frames presented so far
+    uint64_t frameNumber; // Emulated frame the picture is from, frames may be skipped
+    bool *dirtyLines; // maxHeight flags, set for lines that changed since the last present
+} Framebuffer;
+
+// Allocate for frames up to maxWidth x maxHeight, starting at width x height
+bool framebufferInitialise( Framebuffer *framebuffer, uint16_t width, uint16_t height, uint16_t maxWidth, uint16_t maxHeight,
+                            FramebufferFormat format );
+// Lines are packed at the new width, existing pixels are not moved. A new size dirties every line.
+void framebufferResize( Framebuffer *framebuffer, uint16_t width, uint16_t height );
+void framebufferFree( Framebuffer *framebuffer );
+
+static inline uint8_t *framebufferLine( const Framebuffer *framebuffer, uint16_t line ) {
+    return framebuffer->pixels + (uint32_t)line * framebuffer->pitch;
+}
+
+// Lines may be marked from several threads, each flag is written by the one drawing it
+static inline void framebufferMarkDirty( Framebuffer *framebuffer, uint16_t line ) {
+    framebuffer->dirtyLines[ line ] = true;
+}
+
+// Once the frame has been presented
+void framebufferClearDirty( Framebuffer *framebuffer );
+bool framebufferIsDirty( const Framebuffer *framebuffer );
+// Find the next run of dirty lines starting at or after *first, as [ *first, *end ).
+// Returns false when no dirty lines are left.
+bool framebufferNextDirtyRange( const Framebuffer *framebuffer, uint16_t *first, uint16_t *end );
+
+static inline uint8_t framebufferBytesPerPixel( FramebufferFormat format ) {
+    return format == FRAMEBUFFER_BGR555 ? 2 : 4;
+}
+
+// 5 bit channels are widened by replicating their top bits so 0x1F maps to 0xFF
+static inline uint32_t bgr555ToXRGB8888( uint16_t colour ) {
+    const uint32_t r = colour & 0x1F;
+    const uint32_t g = ( colour >> 5 ) & 0x1F;
+    const uint32_t b = ( colour >> 10 ) & 0x1F;
+    return ( ( ( r << 3 ) | ( r >> 2 ) ) << 16 )
+        | ( ( ( g << 3 ) | ( g >> 2 ) ) << 8 )
+        | ( ( b << 3 ) | ( b >> 2 ) );
+}
+
+#endif// FRAMEBUFFER_H
@@ -0,0 +1,23 @@
+#ifndef PIXEL_CONVERT_H
+#define PIXEL_CONVERT_H
+
+#include <stdint.h>
+
+// Pixel format conversion and scaling kernels used when presenting frames
+
+// Convert width BGR555 pixels to XRGB8888
+void convertBGR555ToXRGB8888( const uint16_t *source, uint32_t *destination, uint32_t width );
+
+#define PIXEL_SCALE_MAX 8
+
+// Repeat each of width pixels scale times.
+// source must be readable for 8 pixels past width.
+void scaleLineXRGB8888( const uint32_t *source, uint32_t *destination, uint32_t width, uint8_t scale );
+
+// Repeat each of width BGR555 pixels twice, for low-res lines in a hi-res frame
+void doubleLineBGR555( const uint16_t *source, uint16_t *destination, uint32_t width );
+
+// Alternate width pixels from each of even and odd, starting with even
+void interleaveLinesBGR555( const uint16_t *even, const uint16_t *odd, uint16_t *destination, uint32_t width );
+
+#endif// PIXEL_CONVERT_H
@@ -4,9 +4,42 @@
 #include <stdint.h>
 #include <stdbool.h>
 
-void ppuInitialise();
-void ppuTick();
+// Render on a separate thread fed by a log of PPU writes. Call before ppuInitialise.
+void ppuUseRenderThread( bool enabled );
+// Render each frame's lines in bands across numWorkers threads, including the emulation thread.
+// Ignored with a render thread. Call before ppuInitialise.
+void ppuUseRenderWorkers( uint8_t numWorkers );
+
+// Which frames have their pixels drawn. Timing, counters, blanking and the
+// STAT77 sprite flags run the same either way; skipped frames aren't presented.
+typedef enum PPUFrameSkip {
+    PPU_FRAME_SKIP_NONE,        // Draw every frame
+    PPU_FRAME_SKIP_INTERVAL,    // Draw every interval-th frame, starting with the first
+    PPU_FRAME_SKIP_ON_DEMAND,   // Draw only frames asked for with ppuRequestFrame
+    PPU_FRAME_SKIP_ADAPTIVE,    // Skip frames while the host is behind real time
+} PPUFrameSkip;
+
+void ppuSetFrameSkip( PPUFrameSkip mode, uint32_t interval );
+// Draw the given emulated frame in on demand mode, replacing any earlier request
+void ppuRequestFrame( uint64_t frame );
+// Stop execution after this many frames, 0 to run forever
+void ppuSetFrameLimit( uint64_t frames );
+// Emulated frames completed so far
+uint64_t ppuFrameNumber();
+
+int ppuInitialise();
+// Present any frames still being rendered, once execution has ended
+void ppuFinish();
+// One master clock tick, built for each region's timing
+void ppuTickNTSC();
+void ppuTickPAL();
 void ppuPortAccess( uint8_t addressBus, uint8_t *dataBus, bool writeLine );
 void ppuInterruptStateAccess( uint8_t offset, uint8_t *dataBus, bool writeLine );
 
+// DMA fast paths, equivalent to length port writes.
+// fixedSource repeats *source rather than advancing through it.
+void ppuVRAMBulkWrite( const uint8_t *source, uint32_t length, bool fixedSource ); // 0x2118/0x2119, mode 1
+void ppuCGRAMBulkWrite( const uint8_t *source, uint32_t length, bool fixedSource ); // 0x2122
+void ppuOAMBulkWrite( const uint8_t *source, uint32_t length, bool fixedSource ); // 0x2104
+
 #endif //PPU_H
\ No newline at end of file
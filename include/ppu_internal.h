@@ -0,0 +1,398 @@
+#ifndef PPU_INTERNAL_H
+#define PPU_INTERNAL_H
+
+#include "framebuffer.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// State shared between the PPU port handling in ppu.c and the scanline renderer
+
+#define SCREEN_WIDTH 256
+#define HIRES_WIDTH ( SCREEN_WIDTH * 2 )
+#define SCREEN_HEIGHT 240 // Visible lines per field
+#define INTERLACE_HEIGHT ( SCREEN_HEIGHT * 2 )
+
+#define VRAM_SIZE 0x10000 // 64KB
+#define CGRAM_SIZE 0x200 // 512B
+#define OAMRAM_SIZE ( 0x200 + 0x20 ) // 512B + 32B
+
+typedef struct Ports {
+    // Write-only region
+    uint8_t INIDISP; // 2100h - Display Control 1                                  8xh
+    uint8_t OBSEL; // 2101h   - Object Size and Object Base                        (?)
+    uint8_t OAMADDL; // 2102h - OAM Address (lower 8bit)                           (?)
+    uint8_t OAMADDH; // 2103h - OAM Address (upper 1bit) and Priority Rotation     (?)
+    uint8_t OAMDATA; // 2104h - OAM Data Write (write-twice)                       (?)
+    uint8_t BGMODE; // 2105h  - BG Mode and BG Character Size                      (xFh)
+    uint8_t MOSAIC; // 2106h  - Mosaic Size and Mosaic Enable                      (?)
+    uint8_t BG1SC; // 2107h   - BG1 Screen Base and Screen Size                    (?)
+    uint8_t BG2SC; // 2108h   - BG2 Screen Base and Screen Size                    (?)
+    uint8_t BG3SC; // 2109h   - BG3 Screen Base and Screen Size                    (?)
+    uint8_t BG4SC; // 210Ah   - BG4 Screen Base and Screen Size                    (?)
+    uint8_t BG12NBA; // 210Bh - BG Character Data Area Designation                 (?)
+    uint8_t BG34NBA; // 210Ch - BG Character Data Area Designation                 (?)
+    uint8_t BG1HOFS; // 210Dh - BG1 Horizontal Scroll (X) (write-twice) / M7HOFS   (?,?)
+    uint8_t BG1VOFS; // 210Eh - BG1 Vertical Scroll (Y)   (write-twice) / M7VOFS   (?,?)
+    uint8_t BG2HOFS; // 210Fh - BG2 Horizontal Scroll (X) (write-twice)            (?,?)
+    uint8_t BG2VOFS; // 2110h - BG2 Vertical Scroll (Y)   (write-twice)            (?,?)
+    uint8_t BG3HOFS; // 2111h - BG3 Horizontal Scroll (X) (write-twice)            (?,?)
+    uint8_t BG3VOFS; // 2112h - BG3 Vertical Scroll (Y)   (write-twice)            (?,?)
+    uint8_t BG4HOFS; // 2113h - BG4 Horizontal Scroll (X) (write-twice)            (?,?)
+    uint8_t BG4VOFS; // 2114h - BG4 Vertical Scroll (Y)   (write-twice)            (?,?)
+    uint8_t VMAIN; // 2115h   - VRAM Address Increment Mode                        (?Fh)
+    uint8_t VMADDL; // 2116h  - VRAM Address (lower 8bit)                          (?)
+    uint8_t VMADDH; // 2117h  - VRAM Address (upper 8bit)                          (?)
+    uint8_t VMDATAL; // 2118h - VRAM Data Write (lower 8bit)                       (?)
+    uint8_t VMDATAH; // 2119h - VRAM Data Write (upper 8bit)                       (?)
+    uint8_t M7SEL; // 211Ah   - Rotation/Scaling Mode Settings                     (?)
+    uint8_t M7A; // 211Bh     - Rotation/Scaling Parameter A & Maths 16bit operand(FFh)(w2)
+    uint8_t M7B; // 211Ch     - Rotation/Scaling Parameter B & Maths 8bit operand (FFh)(w2)
+    uint8_t M7C; // 211Dh     - Rotation/Scaling Parameter C         (write-twice) (?)
+    uint8_t M7D; // 211Eh     - Rotation/Scaling Parameter D         (write-twice) (?)
+    uint8_t M7X; // 211Fh     - Rotation/Scaling Center Coordinate X (write-twice) (?)
+    uint8_t M7Y; // 2120h     - Rotation/Scaling Center Coordinate Y (write-twice) (?)
+    uint8_t CGADD; // 2121h   - Palette CGRAM Address                              (?)
+    uint8_t CGDATA; // 2122h  - Palette CGRAM Data Write             (write-twice) (?)
+    uint8_t W12SEL; // 2123h  - Window BG1/BG2 Mask Settings                       (?)
+    uint8_t W34SEL; // 2124h  - Window BG3/BG4 Mask Settings                       (?)
+    uint8_t WOBJSEL; // 2125h - Window OBJ/MATH Mask Settings                      (?)
+    uint8_t WH0; // 2126h     - Window 1 Left Position (X1)                        (?)
+    uint8_t WH1; // 2127h     - Window 1 Right Position (X2)                       (?)
+    uint8_t WH2; // 2128h     - Window 2 Left Position (X1)                        (?)
+    uint8_t WH3; // 2129h     - Window 2 Right Position (X2)                       (?)
+    uint8_t WBGLOG; // 212Ah  - Window 1/2 Mask Logic (BG1-BG4)                    (?)
+    uint8_t WOBJLOG; // 212Bh - Window 1/2 Mask Logic (OBJ/MATH)                   (?)
+    uint8_t TM; // 212Ch      - Main Screen Designation                            (?)
+    uint8_t TS; // 212Dh      - Sub Screen Designation                             (?)
+    uint8_t TMW; // 212Eh     - Window Area Main Screen Disable                    (?)
+    uint8_t TSW; // 212Fh     - Window Area Sub Screen Disable                     (?)
+    uint8_t CGWSEL; // 2130h  - Color Math Control Register A                      (?)
+    uint8_t CGADSUB; // 2131h - Color Math Control Register B                      (?)
+    uint8_t COLDATA; // 2132h - Color Math Sub Screen Backdrop Color               (?)
+    uint8_t SETINI; // 2133h  - Display Control 2                                  00h?
+
+    // Read-only region
+    uint8_t MPYL; // 2134h    - PPU1 Signed Multiply Result   (lower 8bit)         (01h)
+    uint8_t MPYM; // 2135h    - PPU1 Signed Multiply Result   (middle 8bit)        (00h)
+    uint8_t MPYH; // 2136h    - PPU1 Signed Multiply Result   (upper 8bit)         (00h)
+    uint8_t SLHV; // 2137h    - PPU1 Latch H/V-Counter by Software (Read=Strobe)
+    uint8_t RDOAM; // 2138h   - PPU1 OAM Data Read            (read-twice)
+    uint8_t RDVRAML; // 2139h - PPU1 VRAM Data Read           (lower 8bits)
+    uint8_t RDVRAMH; // 213Ah - PPU1 VRAM Data Read           (upper 8bits)
+    uint8_t RDCGRAM; // 213Bh - PPU2 CGRAM Data Read (Palette)(read-twice)
+    uint8_t OPHCT; // 213Ch   - PPU2 Horizontal Counter Latch (read-twice)         (01FFh)
+    uint8_t OPVCT; // 213Dh   - PPU2 Vertical Counter Latch   (read-twice)         (01FFh)
+    uint8_t STAT77; // 213Eh  - PPU1 Status and PPU1 Version Number
+    uint8_t STAT78; // 213Fh  - PPU2 Status and PPU2 Version Number                Bit7=0
+} Ports;
+
+#define LAYER_BG1 0
+#define LAYER_BG2 1
+#define LAYER_BG3 2
+#define LAYER_BG4 3
+#define LAYER_OBJ 4
+#define NUM_LAYERS 5
+#define LAYER_BACKDROP 5 // Bit 5 of CGADSUB
+
+// One layer's contribution to a line.
+// depth 0 is transparent, otherwise a larger depth is closer to the viewer.
+typedef struct LayerLine {
+    uint8_t colour[ SCREEN_WIDTH ]; // CGRAM index
+    uint8_t depth[ SCREEN_WIDTH ];
+    uint8_t directPalette[ SCREEN_WIDTH ]; // Tile palette bits, only filled for BG1 where ppuDirectColour
+} LayerLine;
+
+#pragma region Windows
+
+// Per-line window masks, bit x set where pixel x is inside the layer's window
+// after W1/W2 inversion and mask logic.
+#define WINDOW_COLOUR 5 // Colour math window, alongside the five layers
+#define NUM_WINDOW_MASKS 6
+
+typedef struct PPUWindowMask {
+    uint64_t bits[ SCREEN_WIDTH / 64 ];
+} PPUWindowMask;
+
+// Evaluate every layer's window from W12SEL/W34SEL/WOBJSEL, WH0-WH3 and WBGLOG/WOBJLOG
+void ppuWindowEvaluate( const Ports *ports, PPUWindowMask masks[ NUM_WINDOW_MASKS ] );
+
+static inline bool ppuWindowTest( const PPUWindowMask *mask, uint16_t x ) {
+    return ( mask->bits[ x / 64 ] >> ( x % 64 ) ) & 0x01;
+}
+
+#pragma endregion
+
+// Decoded values of registers whose port byte alone isn't enough to render with
+typedef struct PPURenderRegisters {
+    uint16_t bgHOffset[ 4 ]; // BGnHOFS, 10 bits
+    uint16_t bgVOffset[ 4 ]; // BGnVOFS, 10 bits
+
+    int16_t m7Matrix[ 4 ]; // M7A-M7D, signed 8.8 fixed point
+    int16_t m7CentreX; // M7X, 13-bit signed
+    int16_t m7CentreY; // M7Y, 13-bit signed
+    int16_t m7HOffset; // M7HOFS, 13-bit signed
+    int16_t m7VOffset; // M7VOFS, 13-bit signed
+
+    uint16_t fixedColour; // COLDATA, BGR555
+} PPURenderRegisters;
+
+#pragma region Kernels
+
+// One 8 pixel tile row of a BG line
+typedef struct PPUTileRow {
+    const uint8_t *pixels; // Decoded, from the tile cache
+    uint8_t colourBase; // CGRAM index of the row's palette
+    uint8_t depth; // Layer depth of the row's priority
+    bool hFlip;
+} PPUTileRow;
+
+// Affine walk across one Mode 7 line, in 8.8 fixed point playfield coordinates
+typedef struct PPUMode7Line {
+    int32_t startX;
+    int32_t startY;
+    int32_t stepX;
+    int32_t stepY;
+    uint8_t screenOver; // M7SEL bits 6-7
+} PPUMode7Line;
+
+typedef struct PPUKernels {
+    const char *name;
+    // Planar to chunky conversion of a 2, 4 or 8bpp tile into 64 bytes
+    void ( *decodeTile )( const uint8_t *tileData, uint8_t bitDepth, uint8_t *pixels );
+    // Expand numRows tile rows into numRows * 8 colour and depth bytes
+    void ( *drawTileRows )( const PPUTileRow *rows, uint16_t numRows, uint8_t *colour, uint8_t *depth );
+    // SCREEN_WIDTH raw 8-bit Mode 7 pixels, 0 where the playfield is transparent
+    void ( *drawMode7Line )( const PPUMode7Line *walk, const uint8_t *VRAM, uint8_t *pixels );
+    // Merge a layer into the closest pixels so far, skipping pixels whose bit is set in hidden
+    void ( *resolveLayer )( const LayerLine *layer, uint8_t layerId, const PPUWindowMask *hidden, uint8_t *bestDepth, uint8_t *colour, uint8_t *source );
+    // Add or subtract sub from main in place wherever math is non-zero, halving wherever halve is non-zero
+    void ( *colourMath )( uint16_t *main, const uint16_t *sub, const uint8_t *math, const uint8_t *halve, bool subtract, uint16_t count );
+} PPUKernels;
+
+// Best kernels the host CPU supports, set by ppuKernelsInitialise()
+extern const PPUKernels *ppuKernels;
+void ppuKernelsInitialise();
+
+#pragma endregion
+
+#pragma region Tile cache
+
+// Every 8x8 tile in VRAM decoded to one byte per pixel, at each bit depth.
+// Tiles are decoded on first use after the VRAM behind them changes.
+
+#define TILE_CACHE_2BPP_TILES ( VRAM_SIZE / 16 )
+#define TILE_CACHE_4BPP_TILES ( VRAM_SIZE / 32 )
+#define TILE_CACHE_8BPP_TILES ( VRAM_SIZE / 64 )
+#define TILE_CACHE_TILES ( TILE_CACHE_2BPP_TILES + TILE_CACHE_4BPP_TILES + TILE_CACHE_8BPP_TILES )
+
+typedef struct PPUTileCache {
+    uint8_t pixels[ TILE_CACHE_TILES ][ 64 ]; // Row-major, 8 bytes per row
+    uint64_t dirty[ TILE_CACHE_TILES / 64 ];
+} PPUTileCache;
+
+void ppuTileCacheInitialise( PPUTileCache *cache );
+// Mark every tile overlapping length bytes of VRAM from address as stale
+void ppuTileCacheInvalidate( PPUTileCache *cache, uint32_t address, uint32_t length );
+// Decode every stale tile, after which lookups no longer write to the cache
+void ppuTileCacheRefresh( PPUTileCache *cache, const uint8_t *VRAM );
+// Decoded pixels of the tile at VRAM byte address (wrapped to 64KB, rounded down to the tile)
+const uint8_t *ppuTileCacheGet( PPUTileCache *cache, const uint8_t *VRAM, uint8_t bitDepth, uint32_t address );
+
+#pragma endregion
+
+#pragma region Sprite table
+
+// OAM decoded as it is written, with each sprite binned into the 256 Y
+// positions it covers so a line only looks at the sprites on it.
+
+#define NUM_SPRITES 128
+
+typedef struct PPUSprite {
+    int16_t x; // 9-bit signed
+    uint8_t y;
+    uint16_t tile; // Bit 8 selects the second name table
+    uint8_t palette;
+    uint8_t priority;
+    bool hFlip;
+    bool vFlip;
+    bool large;
+    uint8_t width; // From OBSEL
+    uint8_t height;
+} PPUSprite;
+
+typedef struct PPUSpriteTable {
+    PPUSprite sprites[ NUM_SPRITES ];
+    uint8_t sizeSelect; // OBSEL bits 5-7 the sizes were decoded with
+    uint64_t lines[ 256 ][ NUM_SPRITES / 64 ]; // Bit set for each sprite on the line
+} PPUSpriteTable;
+
+void ppuSpriteTableInitialise( PPUSpriteTable *table, const uint8_t *OAMRAM, uint8_t OBSEL );
+// Redecode the sprites behind an OAM byte address after it is written
+void ppuSpriteTableUpdate( PPUSpriteTable *table, const uint8_t *OAMRAM, uint16_t byteAddress );
+// Redecode everything if the OBSEL size select changed
+void ppuSpriteTableSetSize( PPUSpriteTable *table, const uint8_t *OAMRAM, uint8_t OBSEL );
+// Indices of the sprites on a line, in evaluation order starting from first. Returns the count.
+uint8_t ppuSpritesOnLine( const PPUSpriteTable *table, uint8_t line, uint8_t first, uint8_t *indices );
+
+#pragma endregion
+
+#pragma region Palette
+
+// CGRAM decoded to BGR555 as it is written, and the final lookup from BGR555
+// to the framebuffer's format with master brightness applied. The lookup is
+// only rebuilt when the INIDISP brightness changes.
+
+typedef struct PPUPalette {
+    uint16_t colours[ CGRAM_SIZE / 2 ];
+    FramebufferFormat format;
+    uint8_t brightness; // INIDISP bits 0-3 the output table was built for
+    uint32_t output[ 0x8000 ];
+} PPUPalette;
+
+void ppuPaletteInitialise( PPUPalette *palette, FramebufferFormat format, uint8_t brightness );
+// Refresh one entry after CGRAM changes
+void ppuPaletteUpdate( PPUPalette *palette, const uint8_t *CGRAM, uint8_t index );
+void ppuPaletteSetBrightness( PPUPalette *palette, uint8_t brightness );
+// Convert count BGR555 pixels to the framebuffer's format
+void ppuPaletteOutputLine( const PPUPalette *palette, const uint16_t *colours, uint16_t count, uint8_t *destination );
+
+#pragma endregion
+
+// Everything the renderer may look at for one scanline
+typedef struct PPURenderContext {
+    const Ports *ports;
+    const PPURenderRegisters *registers;
+    const uint8_t *VRAM;
+    const uint8_t *CGRAM;
+    const uint16_t *palette; // CGRAM as BGR555
+    const uint8_t *OAMRAM;
+    const PPUSpriteTable *sprites;
+    PPUTileCache *tileCache;
+    uint8_t field; // Interlace field, 0 on even frames and 1 on odd
+} PPURenderContext;
+
+// Combine the rendered layers into the main and sub screens, apply colour math
+// and write SCREEN_WIDTH BGR555 pixels. The masks are TM/TS bits of layers
+// that were rendered for the line.
+void ppuComposeLine( const PPURenderContext *context, const LayerLine *layers, uint8_t mainLayers, uint8_t subLayers, uint16_t *output );
+
+// Lines are 512 wide in modes 5 and 6 and with pseudo hi-res, other than in F-blank
+static inline bool ppuLineIsHiRes( const Ports *ports ) {
+    const uint8_t mode = ports->BGMODE & 0x07;
+    return !( ports->INIDISP & 0x80 ) && ( mode == 5 || mode == 6 || ( ports->SETINI & 0x08 ) );
+}
+
+static inline bool ppuLineIsInterlaced( const Ports *ports ) {
+    return ports->SETINI & 0x01;
+}
+
+// With CGWSEL bit 0, 8bpp BG1 pixels in modes 3, 4 and 7 are BGR233 colours rather than CGRAM indices
+static inline bool ppuDirectColour( const Ports *ports ) {
+    const uint8_t mode = ports->BGMODE & 0x07;
+    return ( ports->CGWSEL & 0x01 ) && ( mode == 3 || mode == 4 || mode == 7 );
+}
+
+#pragma region Output
+
+// Where rendered lines go in the framebuffer. Every frame starts out 256x240,
+// and is only widened to 512 once a hi-res line is drawn, or doubled to 480
+// rows once an interlaced one is, so frames that use neither don't pay for
+// them. Interlaced frames keep their size into the next frame, since each
+// field only draws every other row.
+
+typedef struct PPUOutput {
+    Framebuffer *framebuffer;
+    const PPUPalette *palette;
+    bool interlaced; // A line of the current frame was interlaced
+} PPUOutput;
+
+void ppuOutputInitialise( PPUOutput *output, Framebuffer *framebuffer, const PPUPalette *palette );
+// Resize the frame if line needs it, converting the lines already drawn. Only
+// the thread drawing the frame may call this, with no lines being output.
+void ppuOutputPrepareLine( PPUOutput *output, uint16_t line, bool hiRes, bool interlaced );
+// Apply the palette to a line from ppuRenderScanline and store it, marking the row dirty
+// if it changed. Lines may be output concurrently.
+void ppuOutputLine( const PPUOutput *output, const uint16_t *colours, bool hiRes, uint16_t line, uint8_t field );
+// Once the frame has been presented
+void ppuOutputEndFrame( PPUOutput *output );
+
+#pragma endregion
+
+#pragma region Render thread
+
+// Optional mode where the emulation thread logs everything the renderer can
+// see, and a render thread replays the log into its own copy of the PPU state.
+// Lines are rendered at the same points in the log as they would be inline,
+// so output is identical.
+
+typedef enum PPULogKind {
+    PPU_LOG_PORT,           // address = port, value = the Ports byte after the write
+    PPU_LOG_REGISTER,       // address = word index into PPURenderRegisters
+    PPU_LOG_VRAM,           // address = byte address
+    PPU_LOG_CGRAM,          // address = entry, value = the 16-bit colour
+    PPU_LOG_OAM,            // address = byte address
+    PPU_LOG_LINE,           // Render line address
+    PPU_LOG_SKIP_LINE,      // Evaluate sprites on line address for STAT77, without drawing
+    PPU_LOG_FRAME,          // End of a frame, value is set if it was drawn and should be presented
+    PPU_LOG_CLEAR_STAT77,   // Start of frame, clear the sprite overflow flags
+} PPULogKind;
+
+typedef struct PPULogEntry {
+    uint32_t dot; // Position in the frame when logged, vCount * H_MAX + hCount
+    uint16_t address;
+    uint16_t value;
+    uint8_t kind;
+} PPULogEntry;
+
+// Copy the current PPU state and start rendering on a new thread
+bool ppuRenderThreadStart( Framebuffer *framebuffer, const Ports *ports, const PPURenderRegisters *registers,
+                           const uint8_t *VRAM, const uint8_t *CGRAM, const uint8_t *OAMRAM );
+void ppuRenderThreadStop();
+// Append to the log, waiting if the log is full or the renderer is a frame behind
+void ppuRenderThreadLog( PPULogKind kind, uint16_t address, uint16_t value, uint32_t dot );
+// Wait until every logged entry has been replayed
+void ppuRenderThreadSync();
+// STAT77 sprite overflow flags raised by the renderer, only meaningful after a sync
+uint8_t ppuRenderThreadStat77();
+
+#pragma endregion
+
+#pragma region Band rendering
+
+// Lines can be deferred and rendered as horizontal bands by a pool of worker
+// threads. Each line keeps a snapshot of the registers and palette it would
+// have been rendered with, while VRAM, the sprite table, tile cache and output
+// palette are shared and must not change until the lines are rendered.
+
+#define PPU_MAX_RENDER_WORKERS 16
+
+typedef struct PPULineSnapshot {
+    Ports ports;
+    PPURenderRegisters registers;
+    uint16_t palette[ CGRAM_SIZE / 2 ];
+} PPULineSnapshot;
+
+// Start numWorkers - 1 threads, the caller renders the first band itself
+bool ppuBandsStart( uint8_t numWorkers );
+void ppuBandsStop();
+// Render count lines from first, each from snapshots[ line ]. Returns the STAT77 flags raised.
+uint8_t ppuBandsRender( const PPULineSnapshot *snapshots, uint16_t first, uint16_t count, uint8_t field, const uint8_t *VRAM,
+                        const PPUSpriteTable *spriteTable, PPUTileCache *tileCache, PPUOutput *output );
+
+#pragma endregion
+
+// STAT77 flags raised by sprite evaluation
+#define STAT77_TIME_OVER 0x80
+#define STAT77_RANGE_OVER 0x40
+
+void ppuRenderInitialise();
+
+// Render one visible line into BGR555 pixels, before master brightness. Lines
+// are HIRES_WIDTH wide where ppuLineIsHiRes, otherwise SCREEN_WIDTH.
+// Returns any STAT77 flags raised while evaluating sprites for the line.
+uint8_t ppuRenderScanline( const PPURenderContext *context, uint16_t line, uint16_t *output );
+// The STAT77 flags ppuRenderScanline would return, without drawing anything
+uint8_t ppuEvaluateSpriteFlags( const PPURenderContext *context, uint16_t line );
+
+#endif// PPU_INTERNAL_H
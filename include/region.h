@@ -0,0 +1,62 @@
+#ifndef REGION_H
+#define REGION_H
+
+#include <stdint.h>
+
+// Video timing of the console a cartridge was made for. The hot tick functions
+// are built once per region with the REGION_* constants below, so their line
+// and frame boundaries are immediates; RegionTiming carries the same numbers
+// for everything else.
+
+typedef enum Region {
+    REGION_NTSC,
+    REGION_PAL,
+} Region;
+
+#define MASTER_CYCLES_PER_DOT 4
+// Two dots of every line are 6 master cycles long, making lines 1364 cycles rather than 1360
+#define LONG_DOT_CYCLES 6
+#define FIRST_LONG_DOT 323
+#define SECOND_LONG_DOT 327
+
+// V-blank starts here, or at OVERSCAN_V_BLANK_LINE when SETINI bit 2 is set at this line
+#define V_BLANK_LINE 225
+#define OVERSCAN_V_BLANK_LINE 240
+
+#define NTSC_MASTER_CLOCK 21477272 // Hz
+#define NTSC_DOTS_PER_LINE 340
+#define NTSC_MASTER_CYCLES_PER_LINE 1364
+#define NTSC_LINES_PER_FRAME 262
+
+#define PAL_MASTER_CLOCK 21281370 // Hz
+#define PAL_DOTS_PER_LINE 340
+#define PAL_MASTER_CYCLES_PER_LINE 1364
+#define PAL_LINES_PER_FRAME 312
+
+typedef struct RegionTiming {
+    const char *name;
+    uint32_t masterClock;
+    uint16_t dotsPerLine;
+    uint16_t masterCyclesPerLine;
+    uint16_t linesPerFrame;
+} RegionTiming;
+
+// Select before startup, the default is NTSC
+void regionSelect( Region region );
+Region regionCurrent();
+const RegionTiming *regionTiming();
+
+// Master cycles the given dot of a line lasts
+static inline uint8_t regionDotCycles( uint16_t dot ) {
+    return ( dot == FIRST_LONG_DOT || dot == SECOND_LONG_DOT ) ? LONG_DOT_CYCLES : MASTER_CYCLES_PER_DOT;
+}
+
+static inline uint32_t regionFrameMasterCycles( const RegionTiming *timing ) {
+    return (uint32_t)timing->linesPerFrame * timing->masterCyclesPerLine;
+}
+
+static inline int64_t regionFrameNanoseconds( const RegionTiming *timing ) {
+    return (int64_t)regionFrameMasterCycles( timing ) * 1000000000ll / timing->masterClock;
+}
+
+#endif// REGION_H
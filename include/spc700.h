@@ -4,8 +4,27 @@
 #include <stdbool.h>
 #include <stdint.h>
 
+#define SPC700_RAM_SIZE 0x10000
+
+// Everything needed to resume from a snapshot such as a .spc file. The
+// register page of ram holds CONTROL, the timer targets and counters, and the
+// ports as last written by the main CPU.
+typedef struct SPC700Snapshot {
+    uint8_t ram[ SPC700_RAM_SIZE ];
+    uint16_t PC;
+    uint8_t A;
+    uint8_t X;
+    uint8_t Y;
+    uint8_t PSW;
+    uint8_t SP;
+} SPC700Snapshot;
+
 void spc700Initialise();
+// After spc700Initialise, in place of the power on state
+void spc700LoadSnapshot( const SPC700Snapshot *snapshot );
 void spc700Tick();
+// CPU cycles executed so far, at 1024KHz
+uint64_t spc700Cycles();
 void spc700PortAccess( uint8_t addressBus, uint8_t *dataBus, bool writeLine );
 
 uint8_t spcMemoryMapRead( uint16_t addr );
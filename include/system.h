@@ -27,6 +27,9 @@ int startup();
 //Begin execution of the loaded cartridge
 void begin_execution();
 
+//Stop execution once the current cycle completes
+void end_execution();
+
 // Get a pointer to host memory equivalent to emulated-memory address
 void snesMemoryMap( MemoryAddress addressBus, uint8_t *dataBus, bool writeLine );
 
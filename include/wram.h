@@ -9,5 +9,15 @@
 void wramInitialise();
 void wramBBusAccess( uint8_t addressBus, uint8_t *dataBus, bool writeLine );
 void wramABusAccess( MemoryAddress addressBus, uint8_t *dataBus, bool writeLine );
+// Host pointer to WRAM at a 17-bit index
+uint8_t *wramHostPointer( uint32_t wramIndex );
+// Invalidate an HDMA channel's schedule on the next write within [low, high],
+// or stop watching for it when low > high
+void wramWatchWrites( uint8_t channel, uint32_t low, uint32_t high );
+
+// Move a whole run through WMDATA (0x2180) in one call, for DMA.
+void wramBBusBulkWrite( const uint8_t *source, uint32_t length );
+void wramBBusBulkRead( uint8_t *destination, uint32_t length );
+void wramBBusBulkFill( uint8_t value, uint32_t length );
 
 #endif // WRAM_H
\ No newline at end of file
@@ -9,6 +9,8 @@
 #define EX_LOROM            0x32
 #define EX_HIROM            0x35
 
+#define COPIER_HEADER_SIZE  0x200
+
 typedef enum RomTypes {
     HiRom,
     LoRom,
@@ -22,14 +24,21 @@ typedef struct EmulatedCartridge {
     bool        rom_loaded;
     uint32_t    size;
     RomTypes    romType;
+    Region      region;
 } EmulatedCartridge;
 
 EmulatedCartridge emulatedCartridge;
 
-static int ScoreHiROM(const _Bool skip_header) {
-    uint8_t    *buf = emulatedCartridge.rom + 0xff00U + 0U + (skip_header ? 0x200U : 0U);
+// Returned by the scoring functions when the image is too small to hold the header
+#define SCORE_INVALID   -100
+
+int cartridgeScoreHiROM(const uint8_t *rom, const uint32_t size, const _Bool skip_header) {
+    const uint8_t *buf = rom + 0xff00U + 0U + (skip_header ? 0x200U : 0U);
     int        score = 0;
 
+    if (size < 0x10000U + (skip_header ? 0x200U : 0U))
+        return (SCORE_INVALID);
+
     if (buf[0xd5] & 0x1)
         score += 2;
 
@@ -58,19 +67,22 @@ static int ScoreHiROM(const _Bool skip_header) {
     if ((buf[0xfc] + (buf[0xfd] << 8)) > 0xffb0)
         score -= 2; // reduced after looking at a scan by Cowering
 
-    if (emulatedCartridge.size > 1024 * 1024 * 3)
+    if (size > 1024 * 1024 * 3)
         score += 4;
 
-    if ((1 << (buf[0xd7] - 7)) > 48)
+    if (buf[0xd7] < 7 || buf[0xd7] > 12)
         score -= 1;
 
     return (score);
 }
 
-static int ScoreLoROM(const _Bool skip_header) {
-    uint8_t    *buf = emulatedCartridge.rom + 0x7f00 + 0 + (skip_header ? 0x200 : 0);
+int cartridgeScoreLoROM(const uint8_t *rom, const uint32_t size, const _Bool skip_header) {
+    const uint8_t *buf = rom + 0x7f00 + 0 + (skip_header ? 0x200 : 0);
     int        score = 0;
 
+    if (size < 0x8000U + (skip_header ? 0x200U : 0U))
+        return (SCORE_INVALID);
+
     if (!(buf[0xd5] & 0x1))
         score += 3;
 
@@ -96,16 +108,32 @@ static int ScoreLoROM(const _Bool skip_header) {
     if ((buf[0xfc] + (buf[0xfd] << 8)) > 0xffb0)
         score -= 2; // reduced per Cowering suggestion
 
-    if (emulatedCartridge.size <= 1024 * 1024 * 16)
+    if (size <= 1024 * 1024 * 16)
         score += 2;
 
-    if ((1 << (buf[0xd7] - 7)) > 48)
+    if (buf[0xd7] < 7 || buf[0xd7] > 12)
         score -= 1;
 
 
     return (score);
 }
 
+// Country codes 02-0C (Europe) and 11 (Australia) are 50Hz PAL, the rest 60Hz
+static Region headerRegion( const uint8_t *rom, uint32_t size, uint32_t headerBase ) {
+    if ( ( size & 0x3FF ) == COPIER_HEADER_SIZE ) {
+        headerBase += COPIER_HEADER_SIZE;
+    }
+    if ( headerBase + 0x20 > size ) {
+        return REGION_NTSC;
+    }
+    const uint8_t country = rom[ headerBase + 0x19 ];
+    return ( ( country >= 0x02 && country <= 0x0C ) || country == 0x11 ) ? REGION_PAL : REGION_NTSC;
+}
+
+Region cartridgeRegion() {
+    return emulatedCartridge.region;
+}
+
 //Load rom from file into dynamically allocated memory
 //Returns 0 if success, -1 if rom size incorrect
 int cartridgeLoadRom( const char* filepath ) {
@@ -127,10 +155,11 @@ int cartridgeLoadRom( const char* filepath ) {
     emulatedCartridge.rom_loaded = 1;
     emulatedCartridge.size = romSize;
 
-    const int hiScore = ScoreHiROM( 1 );
-    const int loScore = ScoreLoROM( 1 );
+    const int hiScore = cartridgeScoreHiROM( emulatedCartridge.rom, emulatedCartridge.size, 1 );
+    const int loScore = cartridgeScoreLoROM( emulatedCartridge.rom, emulatedCartridge.size, 1 );
 
     emulatedCartridge.romType = loScore > hiScore ? LoRom : HiRom;
+    emulatedCartridge.region = headerRegion( emulatedCartridge.rom, emulatedCartridge.size, loScore > hiScore ? 0x7FC0 : 0xFFC0 );
 
     // TODO - fix this bug
     emulatedCartridge.romType = HiRom;
@@ -143,17 +172,12 @@ void deleteRom() {
     }
 }
 
-void cartridgeMemoryAccess( MemoryAddress addressBus, uint8_t *dataBus, bool writeLine ) {
+// Translate a bus address to an offset into the ROM image
+static inline uint32_t cartridgeRomOffset( MemoryAddress addressBus ) {
     // TODO
     // Will be based on hi/lo rom score.
     // Just HiRom for now
     // Can probably re-use some of the old code
-    if ( writeLine ) {
-        // Error?
-        printf( "Attempting to write to ROM\n" );
-        return;
-    }
-
     if ( addressBus.bank >= 0x40 && addressBus.bank <= 0x7D ) {
         addressBus.bank -= 0x40;
     }
@@ -167,6 +191,27 @@ void cartridgeMemoryAccess( MemoryAddress addressBus, uint8_t *dataBus, bool wri
     }
     // TODO - GT says we need to do this, but should verify
     addressBus.bank &= 0x07;
-    uint32_t offset = ( (uint32_t)addressBus.bank << 16 ) | ( (uint32_t)addressBus.offset );
-    *dataBus = emulatedCartridge.rom[ offset ];
-}
\ No newline at end of file
+    return ( (uint32_t)addressBus.bank << 16 ) | ( (uint32_t)addressBus.offset );
+}
+
+void cartridgeMemoryAccess( MemoryAddress addressBus, uint8_t *dataBus, bool writeLine ) {
+    if ( writeLine ) {
+        // Error?
+        printf( "Attempting to write to ROM\n" );
+        return;
+    }
+
+    *dataBus = emulatedCartridge.rom[ cartridgeRomOffset( addressBus ) ];
+}
+
+const uint8_t *cartridgeHostPointer( MemoryAddress addressBus, uint32_t *contiguousBytes ) {
+    uint32_t offset = cartridgeRomOffset( addressBus );
+    if ( !emulatedCartridge.rom_loaded || offset >= emulatedCartridge.size ) {
+        return NULL;
+    }
+    // Mapping is linear to the end of the bank
+    uint32_t bankRemaining = 0x10000 - (uint32_t)addressBus.offset;
+    uint32_t romRemaining = emulatedCartridge.size - offset;
+    *contiguousBytes = bankRemaining < romRemaining ? bankRemaining : romRemaining;
+    return &emulatedCartridge.rom[ offset ];
+}
@@ -8,6 +8,7 @@
 #include "core_65816.h"
 #include "dma.h"
 #include "system.h"
+#include "wram.h"
 
 #include <assert.h>
 #include <stdbool.h>
@@ -72,6 +73,7 @@ void hBlank( bool level ) {
     timerState.HVBJOY &= ~40;
     if ( timerState.hBlankLevel == true ) {
         timerState.hCount = 0;
+        timerState.countDivisor = 0;
         dmaHBlank();
     }
     else {
@@ -85,44 +87,48 @@ static inline void triggerBlankIRQ() {
     IRQ( false );
 }
 
-static inline void vTimerTick() {
+// Boundaries are passed as constants from the per-region cpuTick functions
+static inline void vTimerTick( const uint16_t linesPerFrame ) {
     // TODO - verify timing
     ++timerState.vCount;
     if ( timerState.vCount == timerState.VTIME && timerState.vBlankIRQEnable ) {
         // IRQ trigger
         triggerBlankIRQ();
     }
-    // TODO - get actual boundary
-    if ( timerState.vCount == 264 ) {
+    if ( timerState.vCount == linesPerFrame ) {
         // IRQ trigger
         timerState.vCount = 0;
         IRQ( true );
     }
 }
 
-static inline void hTimerTick() {
+static inline void hTimerTick( const uint16_t dotsPerLine, const uint16_t linesPerFrame ) {
     // TODO - verify timing
-    if ( ++timerState.countDivisor % 4 == 0 ) {
+    if ( ++timerState.countDivisor >= regionDotCycles( timerState.hCount ) ) {
+        timerState.countDivisor = 0;
         ++timerState.hCount;
         if ( timerState.hCount == timerState.HTIME && timerState.hBlankIRQEnable ) {
             // IRQ trigger
             triggerBlankIRQ();
         }
-        // TODO - get actual boundary
-        if ( timerState.hCount == 264 ) {
-            vTimerTick();
+        if ( timerState.hCount == dotsPerLine ) {
+            vTimerTick( linesPerFrame );
             timerState.hCount = 0;
             IRQ( true );
         }
     }
 }
 
-void cpuTick() {
-    hTimerTick();
-    if ( !dmaTick() ) {
-        coreTick();
+#define CPU_TICK( REGION ) \
+    void cpuTick##REGION() { \
+        hTimerTick( REGION##_DOTS_PER_LINE, REGION##_LINES_PER_FRAME ); \
+        if ( !dmaTick() ) { \
+            coreTick(); \
+        } \
     }
-}
+
+CPU_TICK( NTSC )
+CPU_TICK( PAL )
 
 /*
 //CPU On-Chip I/O Ports (Write-only) (Read=open bus)
@@ -468,6 +474,46 @@ void MemoryAccess( MemoryAddress addressBus, uint8_t *data, bool writeLine ) {
 
 }
 
+// WRAM index an A-bus address decodes to, or -1 if it isn't WRAM
+int32_t ABusWRAMIndex( MemoryAddress addressBus ) {
+    const bool systemBank = addressBus.bank <= 0x3F || ( addressBus.bank >= 0x80 && addressBus.bank <= 0xBF );
+    if ( systemBank && addressBus.offset <= 0x1FFF ) {
+        return addressBus.offset;
+    }
+    else if ( addressBus.bank == 0x7E || addressBus.bank == 0x7F ) {
+        return ( ( (int32_t)addressBus.bank & 0x01 ) << 16 ) | addressBus.offset;
+    }
+    return -1;
+}
+
+// Host pointer for A-bus addresses that map straight onto WRAM or ROM, NULL for
+// I/O and open-bus regions. Follows the same decoding as MemoryAccess.
+uint8_t *ABusHostPointer( MemoryAddress addressBus, uint32_t *contiguousBytes, bool writeLine ) {
+    const bool systemBank = addressBus.bank <= 0x3F || ( addressBus.bank >= 0x80 && addressBus.bank <= 0xBF );
+    if ( systemBank ) {
+        if ( addressBus.offset <= 0x1FFF ) {
+            // Lower 8K of WRAM
+            *contiguousBytes = 0x2000 - (uint32_t)addressBus.offset;
+            return wramHostPointer( addressBus.offset );
+        }
+        else if ( addressBus.offset <= 0x5FFF ) {
+            // B-bus, CPU registers, open-bus
+            return NULL;
+        }
+    }
+    else if ( addressBus.bank == 0x7E || addressBus.bank == 0x7F ) {
+        *contiguousBytes = 0x10000 - (uint32_t)addressBus.offset;
+        return wramHostPointer( ( ( (uint32_t)addressBus.bank & 0x01 ) << 16 ) | addressBus.offset );
+    }
+
+    if ( writeLine ) {
+        // ROM
+        return NULL;
+    }
+    // Cartridge is read-only, so the cast is safe for readers
+    return (uint8_t*)cartridgeHostPointer( addressBus, contiguousBytes );
+}
+
 uint8_t MainBusReadU8( MemoryAddress addressBus ) {
     uint8_t value;
     MemoryAccess( addressBus, &value, false );
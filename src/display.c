@@ -0,0 +1,89 @@
+#include "display.h"
+
+#include "frame_hash.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#pragma region None
+
+static bool noneOpen( const Framebuffer *framebuffer, const char *target ) {
+    (void)framebuffer;
+    (void)target;
+    return true;
+}
+
+static void nonePresent( const Framebuffer *framebuffer ) {
+    (void)framebuffer;
+}
+
+static void noneClose() {
+}
+
+const DisplayBackend displayBackendNone = {
+    .name = "none",
+    .preferredFormat = FRAMEBUFFER_BGR555,
+    .open = noneOpen,
+    .present = nonePresent,
+    .close = noneClose,
+};
+
+#pragma endregion
+
+static const DisplayBackend *const backends[] = {
+    &displayBackendWindow,
+    &displayBackendPPM,
+    &displayBackendPNG,
+    &displayBackendY4M,
+    &displayBackendNone,
+};
+
+static const DisplayBackend *selectedBackend = &displayBackendWindow;
+static const char *selectedTarget = NULL;
+static bool isOpen = false;
+
+bool displaySelect( const char *name, const char *target ) {
+    for ( size_t i = 0; i < sizeof( backends ) / sizeof( backends[ 0 ] ); ++i ) {
+        if ( strcmp( backends[ i ]->name, name ) == 0 ) {
+            selectedBackend = backends[ i ];
+            selectedTarget = target;
+            return true;
+        }
+    }
+    fprintf( stderr, "Unknown display backend '%s'\n", name );
+    return false;
+}
+
+FramebufferFormat displayPreferredFormat() {
+    return selectedBackend->preferredFormat;
+}
+
+bool displayOpen( const Framebuffer *framebuffer ) {
+    if ( !selectedBackend->open( framebuffer, selectedTarget ) ) {
+        fprintf( stderr, "Unable to open '%s' display\n", selectedBackend->name );
+        if ( selectedBackend != &displayBackendWindow ) {
+            return false;
+        }
+        // No X server is not a reason to stop, e.g. when benchmarking
+        fprintf( stderr, "Continuing without a display\n" );
+        selectedBackend = &displayBackendNone;
+    }
+    isOpen = true;
+    atexit( displayClose );
+    return true;
+}
+
+void displayPresent( const Framebuffer *framebuffer ) {
+    if ( frameHashEnabled() ) {
+        frameHashPresent( framebuffer );
+    }
+    selectedBackend->present( framebuffer );
+}
+
+void displayClose() {
+    if ( isOpen ) {
+        selectedBackend->close();
+        isOpen = false;
+    }
+}
@@ -0,0 +1,435 @@
+#include "display.h"
+
+#include "pixel_convert.h"
+#include "region.h"
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Headless capture backends. Presented frames are copied into a bounded queue
+// and encoded and written on a background thread. When the writer falls
+// behind, frames are dropped rather than stalling emulation.
+//
+// ppm and png write one file per frame when the target contains a %d style
+// frame number (e.g. "frame%05d.png"), otherwise every frame is appended to one
+// stream. y4m always streams, at the size of the first frame; frames of
+// other sizes (hi-res or interlaced) are resampled to it. A target of "-" writes
+// to stdout.
+
+#define QUEUE_FRAMES 16
+#define MAX_CAPTURE_WIDTH 512
+#define MAX_PATH 1024
+
+typedef enum CaptureFormat {
+    CAPTURE_PPM,
+    CAPTURE_PNG,
+    CAPTURE_Y4M,
+} CaptureFormat;
+
+typedef struct CaptureFrame {
+    uint16_t *pixels; // BGR555, width x height packed
+    uint16_t width;
+    uint16_t height;
+    uint64_t frameNumber;
+} CaptureFrame;
+
+typedef struct CaptureState {
+    CaptureFormat format;
+    const char *target;
+    bool perFrameFiles;
+    FILE *stream;
+    uint16_t maxWidth;
+    uint16_t maxHeight;
+    uint16_t streamWidth; // y4m, 0 until the header is written
+    uint16_t streamHeight;
+
+    CaptureFrame queue[ QUEUE_FRAMES ];
+    uint8_t head; // Next frame to write
+    uint8_t count;
+    uint64_t dropped;
+    bool quit;
+    pthread_t thread;
+    pthread_mutex_t lock;
+    pthread_cond_t frameReady;
+    bool threadRunning;
+
+    // Writer thread scratch
+    uint32_t rgbLine[ MAX_CAPTURE_WIDTH + 8 ];
+    uint8_t *encodeBuffer;
+    size_t encodeSize;
+} CaptureState;
+
+static CaptureState captureState;
+
+#pragma region Encoding
+
+static inline uint8_t red( uint32_t colour ) { return ( colour >> 16 ) & 0xFF; }
+static inline uint8_t green( uint32_t colour ) { return ( colour >> 8 ) & 0xFF; }
+static inline uint8_t blue( uint32_t colour ) { return colour & 0xFF; }
+
+static const uint32_t *rgbLine( const CaptureFrame *frame, uint16_t y ) {
+    convertBGR555ToXRGB8888( &frame->pixels[ (uint32_t)y * frame->width ], captureState.rgbLine, frame->width );
+    return captureState.rgbLine;
+}
+
+// Packed RGB rows, with a leading filter byte per row when filterBytes is set (PNG)
+static uint8_t *packRGB( const CaptureFrame *frame, bool filterBytes, size_t *size ) {
+    const size_t rowSize = (size_t)frame->width * 3 + ( filterBytes ? 1 : 0 );
+    uint8_t *out = captureState.encodeBuffer;
+    for ( uint16_t y = 0; y < frame->height; ++y ) {
+        const uint32_t *line = rgbLine( frame, y );
+        uint8_t *row = out + y * rowSize;
+        if ( filterBytes ) {
+            *row++ = 0x00; // No filter
+        }
+        for ( uint16_t x = 0; x < frame->width; ++x ) {
+            row[ x * 3 ] = red( line[ x ] );
+            row[ x * 3 + 1 ] = green( line[ x ] );
+            row[ x * 3 + 2 ] = blue( line[ x ] );
+        }
+    }
+    *size = rowSize * frame->height;
+    return out;
+}
+
+static void writePPM( FILE *file, const CaptureFrame *frame ) {
+    size_t size;
+    const uint8_t *pixels = packRGB( frame, false, &size );
+    fprintf( file, "P6\n%u %u\n255\n", frame->width, frame->height );
+    fwrite( pixels, 1, size, file );
+}
+
+static uint32_t crcTable[ 256 ];
+
+static void buildCRCTable() {
+    for ( uint32_t n = 0; n < 256; ++n ) {
+        uint32_t c = n;
+        for ( uint8_t k = 0; k < 8; ++k ) {
+            c = ( c & 1 ) ? 0xEDB88320u ^ ( c >> 1 ) : c >> 1;
+        }
+        crcTable[ n ] = c;
+    }
+}
+
+static uint32_t crc32Update( uint32_t crc, const uint8_t *data, size_t length ) {
+    for ( size_t i = 0; i < length; ++i ) {
+        crc = crcTable[ ( crc ^ data[ i ] ) & 0xFF ] ^ ( crc >> 8 );
+    }
+    return crc;
+}
+
+static void putU32( uint8_t *out, uint32_t value ) {
+    out[ 0 ] = (uint8_t)( value >> 24 );
+    out[ 1 ] = (uint8_t)( value >> 16 );
+    out[ 2 ] = (uint8_t)( value >> 8 );
+    out[ 3 ] = (uint8_t)value;
+}
+
+static void writeChunk( FILE *file, const char *type, const uint8_t *data, uint32_t length ) {
+    uint8_t header[ 8 ];
+    putU32( header, length );
+    memcpy( &header[ 4 ], type, 4 );
+    uint8_t crc[ 4 ];
+    putU32( crc, crc32Update( crc32Update( 0xFFFFFFFFu, &header[ 4 ], 4 ), data, length ) ^ 0xFFFFFFFFu );
+    fwrite( header, 1, sizeof( header ), file );
+    fwrite( data, 1, length, file );
+    fwrite( crc, 1, sizeof( crc ), file );
+}
+
+// Uncompressed PNG: the zlib stream holds stored deflate blocks, so no zlib dependency
+static void writePNG( FILE *file, const CaptureFrame *frame ) {
+    static const uint8_t signature[ 8 ] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+    fwrite( signature, 1, sizeof( signature ), file );
+
+    uint8_t header[ 13 ];
+    putU32( &header[ 0 ], frame->width );
+    putU32( &header[ 4 ], frame->height );
+    header[ 8 ] = 8; // Bit depth
+    header[ 9 ] = 2; // Truecolour
+    header[ 10 ] = header[ 11 ] = header[ 12 ] = 0;
+    writeChunk( file, "IHDR", header, sizeof( header ) );
+
+    size_t size;
+    const uint8_t *raw = packRGB( frame, true, &size );
+    const size_t numBlocks = ( size + 0xFFFE ) / 0xFFFF;
+    const size_t zlibSize = 2 + size + numBlocks * 5 + 4;
+    uint8_t *zlib = &captureState.encodeBuffer[ size ];
+
+    uint8_t *out = zlib;
+    *out++ = 0x78; // Deflate, 32K window
+    *out++ = 0x01;
+    uint32_t adlerA = 1;
+    uint32_t adlerB = 0;
+    for ( size_t offset = 0; offset < size; offset += 0xFFFF ) {
+        const uint16_t length = (uint16_t)( size - offset < 0xFFFF ? size - offset : 0xFFFF );
+        *out++ = offset + length == size ? 0x01 : 0x00; // Final block flag, stored
+        *out++ = (uint8_t)length;
+        *out++ = (uint8_t)( length >> 8 );
+        *out++ = (uint8_t)~length;
+        *out++ = (uint8_t)( ~length >> 8 );
+        memcpy( out, &raw[ offset ], length );
+        out += length;
+        for ( uint16_t i = 0; i < length; ++i ) {
+            adlerA = ( adlerA + raw[ offset + i ] ) % 65521;
+            adlerB = ( adlerB + adlerA ) % 65521;
+        }
+    }
+    putU32( out, ( adlerB << 16 ) | adlerA );
+    writeChunk( file, "IDAT", zlib, (uint32_t)zlibSize );
+    writeChunk( file, "IEND", NULL, 0 );
+}
+
+// BT.601 limited range, full resolution chroma (C444)
+static void writeY4M( FILE *file, const CaptureFrame *frame ) {
+    if ( !captureState.streamWidth ) {
+        captureState.streamWidth = frame->width;
+        captureState.streamHeight = frame->height;
+        const RegionTiming *timing = regionTiming();
+        fprintf( file, "YUV4MPEG2 W%u H%u F%u:%u Ip A1:1 C444\n", frame->width, frame->height, timing->masterClock,
+                 regionFrameMasterCycles( timing ) );
+    }
+    const uint16_t width = captureState.streamWidth;
+    const uint16_t height = captureState.streamHeight;
+
+    const uint32_t planeSize = (uint32_t)width * height;
+    uint8_t *planeY = captureState.encodeBuffer;
+    uint8_t *planeU = planeY + planeSize;
+    uint8_t *planeV = planeU + planeSize;
+    for ( uint16_t y = 0; y < height; ++y ) {
+        // Nearest neighbour when the frame isn't the stream's size
+        const uint32_t *line = rgbLine( frame, (uint16_t)( (uint32_t)y * frame->height / height ) );
+        for ( uint16_t x = 0; x < width; ++x ) {
+            const uint32_t colour = line[ (uint32_t)x * frame->width / width ];
+            const int32_t r = red( colour );
+            const int32_t g = green( colour );
+            const int32_t b = blue( colour );
+            const uint32_t i = (uint32_t)y * width + x;
+            planeY[ i ] = (uint8_t)( ( ( 66 * r + 129 * g + 25 * b + 128 ) >> 8 ) + 16 );
+            planeU[ i ] = (uint8_t)( ( ( -38 * r - 74 * g + 112 * b + 128 ) >> 8 ) + 128 );
+            planeV[ i ] = (uint8_t)( ( ( 112 * r - 94 * g - 18 * b + 128 ) >> 8 ) + 128 );
+        }
+    }
+    fputs( "FRAME\n", file );
+    fwrite( captureState.encodeBuffer, 1, planeSize * 3, file );
+}
+
+#pragma endregion
+
+#pragma region Writer thread
+
+// Expand the first %d / %0Nd in pattern with the frame number
+static bool framePath( const char *pattern, uint64_t frameNumber, char *path, size_t pathSize ) {
+    const char *percent = strchr( pattern, '%' );
+    const char *end = percent + 1;
+    uint8_t width = 0;
+    while ( *end >= '0' && *end <= '9' ) {
+        width = (uint8_t)( width * 10 + ( *end++ - '0' ) );
+    }
+    if ( *end != 'd' || width > 20 ) {
+        return false;
+    }
+    char number[ 24 ];
+    const int numberLength = snprintf( number, sizeof( number ), "%0*llu", width, (unsigned long long)frameNumber );
+    const int length = snprintf( path, pathSize, "%.*s%s%s", (int)( percent - pattern ), pattern, number, end + 1 );
+    return numberLength > 0 && length > 0 && (size_t)length < pathSize;
+}
+
+static void writeFrame( const CaptureFrame *frame ) {
+    FILE *file = captureState.stream;
+    if ( captureState.perFrameFiles ) {
+        char path[ MAX_PATH ];
+        if ( !framePath( captureState.target, frame->frameNumber, path, sizeof( path ) ) || !( file = fopen( path, "wb" ) ) ) {
+            fprintf( stderr, "Unable to write frame %llu\n", (unsigned long long)frame->frameNumber );
+            return;
+        }
+    }
+
+    switch ( captureState.format ) {
+        case CAPTURE_PPM:
+            writePPM( file, frame );
+            break;
+        case CAPTURE_PNG:
+            writePNG( file, frame );
+            break;
+        case CAPTURE_Y4M:
+            writeY4M( file, frame );
+            break;
+    }
+
+    if ( captureState.perFrameFiles ) {
+        fclose( file );
+    }
+    else {
+        fflush( file );
+    }
+}
+
+static void *writerThread( void *argument ) {
+    (void)argument;
+
+    for ( ;; ) {
+        pthread_mutex_lock( &captureState.lock );
+        while ( captureState.count == 0 && !captureState.quit ) {
+            pthread_cond_wait( &captureState.frameReady, &captureState.lock );
+        }
+        if ( captureState.count == 0 ) {
+            // Quit once everything queued is written
+            pthread_mutex_unlock( &captureState.lock );
+            break;
+        }
+        CaptureFrame *frame = &captureState.queue[ captureState.head ];
+        pthread_mutex_unlock( &captureState.lock );
+
+        writeFrame( frame );
+
+        pthread_mutex_lock( &captureState.lock );
+        captureState.head = ( captureState.head + 1 ) % QUEUE_FRAMES;
+        --captureState.count;
+        pthread_mutex_unlock( &captureState.lock );
+    }
+    return NULL;
+}
+
+#pragma endregion
+
+static void captureClose();
+
+static bool captureOpen( CaptureFormat format, const Framebuffer *framebuffer, const char *target ) {
+    if ( !target ) {
+        fprintf( stderr, "Capture needs an output path, or - for stdout\n" );
+        return false;
+    }
+    if ( framebuffer->format != FRAMEBUFFER_BGR555 || framebuffer->maxWidth > MAX_CAPTURE_WIDTH ) {
+        return false;
+    }
+
+    memset( &captureState, 0x00, sizeof( CaptureState ) );
+    captureState.format = format;
+    captureState.target = target;
+    captureState.maxWidth = framebuffer->maxWidth;
+    captureState.maxHeight = framebuffer->maxHeight;
+    captureState.perFrameFiles = format != CAPTURE_Y4M && strchr( target, '%' ) != NULL;
+    buildCRCTable();
+
+    // Largest is PNG: filtered rows plus the zlib copy of them
+    const size_t rawSize = ( (size_t)framebuffer->maxWidth * 3 + 1 ) * framebuffer->maxHeight;
+    captureState.encodeSize = rawSize * 2 + 1024;
+    captureState.encodeBuffer = malloc( captureState.encodeSize );
+    for ( uint8_t i = 0; i < QUEUE_FRAMES; ++i ) {
+        captureState.queue[ i ].pixels = malloc( (size_t)framebuffer->maxWidth * framebuffer->maxHeight * sizeof( uint16_t ) );
+        if ( !captureState.queue[ i ].pixels ) {
+            captureClose();
+            return false;
+        }
+    }
+    if ( !captureState.encodeBuffer ) {
+        captureClose();
+        return false;
+    }
+
+    if ( !captureState.perFrameFiles ) {
+        captureState.stream = strcmp( target, "-" ) == 0 ? stdout : fopen( target, "wb" );
+        if ( !captureState.stream ) {
+            fprintf( stderr, "Unable to open %s\n", target );
+            captureClose();
+            return false;
+        }
+    }
+
+    pthread_mutex_init( &captureState.lock, NULL );
+    pthread_cond_init( &captureState.frameReady, NULL );
+    if ( pthread_create( &captureState.thread, NULL, writerThread, NULL ) ) {
+        captureClose();
+        return false;
+    }
+    captureState.threadRunning = true;
+    return true;
+}
+
+static void capturePresent( const Framebuffer *framebuffer ) {
+    pthread_mutex_lock( &captureState.lock );
+    if ( captureState.count == QUEUE_FRAMES ) {
+        ++captureState.dropped;
+        pthread_mutex_unlock( &captureState.lock );
+        return;
+    }
+    // The slot past the queued frames is never touched by the writer
+    CaptureFrame *frame = &captureState.queue[ ( captureState.head + captureState.count ) % QUEUE_FRAMES ];
+    pthread_mutex_unlock( &captureState.lock );
+
+    for ( uint16_t y = 0; y < framebuffer->height; ++y ) {
+        memcpy( &frame->pixels[ (uint32_t)y * framebuffer->width ], framebufferLine( framebuffer, y ), framebuffer->width * sizeof( uint16_t ) );
+    }
+    frame->width = framebuffer->width;
+    frame->height = framebuffer->height;
+    frame->frameNumber = framebuffer->frameNumber;
+
+    pthread_mutex_lock( &captureState.lock );
+    ++captureState.count;
+    pthread_cond_signal( &captureState.frameReady );
+    pthread_mutex_unlock( &captureState.lock );
+}
+
+static void captureClose() {
+    if ( captureState.threadRunning ) {
+        pthread_mutex_lock( &captureState.lock );
+        captureState.quit = true;
+        pthread_cond_signal( &captureState.frameReady );
+        pthread_mutex_unlock( &captureState.lock );
+        pthread_join( captureState.thread, NULL );
+        pthread_mutex_destroy( &captureState.lock );
+        pthread_cond_destroy( &captureState.frameReady );
+        captureState.threadRunning = false;
+    }
+    if ( captureState.dropped ) {
+        fprintf( stderr, "Capture dropped %llu frames\n", (unsigned long long)captureState.dropped );
+    }
+    if ( captureState.stream && captureState.stream != stdout ) {
+        fclose( captureState.stream );
+    }
+    captureState.stream = NULL;
+    for ( uint8_t i = 0; i < QUEUE_FRAMES; ++i ) {
+        free( captureState.queue[ i ].pixels );
+        captureState.queue[ i ].pixels = NULL;
+    }
+    free( captureState.encodeBuffer );
+    captureState.encodeBuffer = NULL;
+}
+
+static bool ppmOpen( const Framebuffer *framebuffer, const char *target ) {
+    return captureOpen( CAPTURE_PPM, framebuffer, target );
+}
+
+static bool pngOpen( const Framebuffer *framebuffer, const char *target ) {
+    return captureOpen( CAPTURE_PNG, framebuffer, target );
+}
+
+static bool y4mOpen( const Framebuffer *framebuffer, const char *target ) {
+    return captureOpen( CAPTURE_Y4M, framebuffer, target );
+}
+
+const DisplayBackend displayBackendPPM = {
+    .name = "ppm",
+    .preferredFormat = FRAMEBUFFER_BGR555,
+    .open = ppmOpen,
+    .present = capturePresent,
+    .close = captureClose,
+};
+
+const DisplayBackend displayBackendPNG = {
+    .name = "png",
+    .preferredFormat = FRAMEBUFFER_BGR555,
+    .open = pngOpen,
+    .present = capturePresent,
+    .close = captureClose,
+};
+
+const DisplayBackend displayBackendY4M = {
+    .name = "y4m",
+    .preferredFormat = FRAMEBUFFER_BGR555,
+    .open = y4mOpen,
+    .present = capturePresent,
+    .close = captureClose,
+};
@@ -0,0 +1,410 @@
+#include "display.h"
+
+#include "pixel_convert.h"
+
+#include <X11/Xlib.h>
+#include <X11/Xutil.h>
+#include <X11/extensions/XShm.h>
+#include <sys/ipc.h>
+#include <sys/shm.h>
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// X11 window backend.
+// present() only copies the frame's dirty lines into a pending frame and wakes
+// the present thread, which converts and scales the lines each XImage hasn't
+// seen into one of two shared memory XImages and sends the changed rows with
+// XShmPutImage. Unchanged frames are not sent at all. Emulation never waits on
+// the X server; if the present thread falls behind, dirty lines accumulate and
+// the newest frame wins. Unchanged frames still wake the present thread to
+// handle events, so an exposed window is repainted from the last frame.
+// Falls back to a plain XPutImage when MIT-SHM isn't available.
+// The window is sized for a 256x240 frame times the scale; hi-res and
+// interlaced frames are scaled to fit it.
+
+#define DEFAULT_SCALE 2
+#define NUM_IMAGES 2
+
+typedef struct X11Image {
+    XImage *image;
+    XShmSegmentInfo segment;
+    bool inFlight; // Waiting on the server's ShmCompletion
+    bool *staleLines; // Per frame line, changed since it was last drawn into this image
+} X11Image;
+
+typedef struct X11State {
+    Display *display;
+    Window window;
+    GC gc;
+    bool useShm;
+    int completionEvent;
+
+    X11Image images[ NUM_IMAGES ];
+    uint8_t backImage;
+
+    uint16_t width;
+    uint16_t height;
+    uint8_t scale;
+    uint16_t maxWidth; // Largest frame the framebuffer may present
+    uint16_t maxHeight;
+    uint32_t *convertedLine; // Padded for the scaling kernel
+
+    // Hand-off between emulation and the present thread
+    pthread_t thread;
+    bool threadRunning;
+    pthread_mutex_t lock;
+    pthread_cond_t frameReady;
+    uint16_t *pendingFrame;
+    bool *pendingDirty; // Per line, changed in pendingFrame since the present thread took it
+    uint16_t *workingFrame;
+    uint16_t pendingWidth;
+    uint16_t pendingHeight;
+    bool hasPending;
+    bool checkEvents; // An unchanged frame was presented, only events need handling
+    bool quit;
+} X11State;
+
+static X11State x11State;
+
+#pragma region Images
+
+static bool createImage( X11Image *image, Visual *visual, int depth ) {
+    const uint32_t width = x11State.width * x11State.scale;
+    const uint32_t height = x11State.height * x11State.scale;
+
+    image->staleLines = malloc( x11State.maxHeight * sizeof( bool ) );
+    if ( !image->staleLines ) {
+        return false;
+    }
+    memset( image->staleLines, true, x11State.maxHeight * sizeof( bool ) );
+
+    if ( x11State.useShm ) {
+        image->image = XShmCreateImage( x11State.display, visual, depth, ZPixmap, NULL, &image->segment, width, height );
+        if ( !image->image ) {
+            return false;
+        }
+        image->segment.shmid = shmget( IPC_PRIVATE, image->image->bytes_per_line * image->image->height, IPC_CREAT | 0600 );
+        if ( image->segment.shmid < 0 ) {
+            XDestroyImage( image->image );
+            return false;
+        }
+        image->segment.shmaddr = image->image->data = shmat( image->segment.shmid, NULL, 0 );
+        image->segment.readOnly = False;
+        XShmAttach( x11State.display, &image->segment );
+        XSync( x11State.display, False );
+        // Segment goes away once both sides detach
+        shmctl( image->segment.shmid, IPC_RMID, NULL );
+    }
+    else {
+        char *pixels = calloc( height, width * sizeof( uint32_t ) );
+        image->image = XCreateImage( x11State.display, visual, depth, ZPixmap, 0, pixels, width, height, 32, 0 );
+        if ( !image->image ) {
+            free( pixels );
+            return false;
+        }
+    }
+    image->inFlight = false;
+    return true;
+}
+
+static void destroyImage( X11Image *image ) {
+    free( image->staleLines );
+    image->staleLines = NULL;
+    if ( !image->image ) {
+        return;
+    }
+    if ( x11State.useShm ) {
+        XShmDetach( x11State.display, &image->segment );
+        XDestroyImage( image->image );
+        shmdt( image->segment.shmaddr );
+    }
+    else {
+        XDestroyImage( image->image );
+    }
+    image->image = NULL;
+}
+
+#pragma endregion
+
+#pragma region Present thread
+
+static void handleEvents( bool waitForCompletion, X11Image *image ) {
+    while ( ( waitForCompletion && image->inFlight ) || XPending( x11State.display ) ) {
+        XEvent event;
+        XNextEvent( x11State.display, &event );
+        if ( x11State.useShm && event.type == x11State.completionEvent ) {
+            const XShmCompletionEvent *completion = (const XShmCompletionEvent*)&event;
+            for ( uint8_t i = 0; i < NUM_IMAGES; ++i ) {
+                if ( x11State.images[ i ].segment.shmseg == completion->shmseg ) {
+                    x11State.images[ i ].inFlight = false;
+                }
+            }
+        }
+        else if ( event.type == Expose && event.xexpose.count == 0 ) {
+            // Both images are redrawn in full, whichever is sent next
+            for ( uint8_t i = 0; i < NUM_IMAGES; ++i ) {
+                memset( x11State.images[ i ].staleLines, true, x11State.maxHeight * sizeof( bool ) );
+            }
+        }
+        // TODO - input
+    }
+}
+
+// Draws the frame lines that are stale in the image, returning the window rows they cover
+static bool drawFrame( const uint16_t *frame, uint16_t width, uint16_t height, X11Image *image, uint32_t *firstDrawn,
+                       uint32_t *endDrawn ) {
+    const uint32_t scaledWidth = x11State.width * x11State.scale;
+    const uint32_t scaledHeight = x11State.height * x11State.scale;
+    const uint32_t pitch = image->image->bytes_per_line;
+    uint8_t *destination = (uint8_t*)image->image->data;
+    *firstDrawn = scaledHeight;
+    *endDrawn = 0;
+
+    // Each frame row covers the window rows from its top edge to the next row's,
+    // none when the frame has more rows than the window
+    for ( uint16_t y = 0; y < height; ++y ) {
+        if ( !image->staleLines[ y ] ) {
+            continue;
+        }
+        image->staleLines[ y ] = false;
+        const uint32_t firstRow = (uint32_t)y * scaledHeight / height;
+        const uint32_t endRow = ( (uint32_t)y + 1 ) * scaledHeight / height;
+        if ( firstRow == endRow ) {
+            continue;
+        }
+        if ( firstRow < *firstDrawn ) {
+            *firstDrawn = firstRow;
+        }
+        *endDrawn = endRow;
+        convertBGR555ToXRGB8888( &frame[ (uint32_t)y * width ], x11State.convertedLine, width );
+
+        uint32_t *row = (uint32_t*)( destination + firstRow * pitch );
+        if ( scaledWidth % width == 0 ) {
+            scaleLineXRGB8888( x11State.convertedLine, row, width, (uint8_t)( scaledWidth / width ) );
+        }
+        else {
+            for ( uint32_t x = 0; x < scaledWidth; ++x ) {
+                row[ x ] = x11State.convertedLine[ x * width / scaledWidth ];
+            }
+        }
+        for ( uint32_t repeat = firstRow + 1; repeat < endRow; ++repeat ) {
+            memcpy( destination + repeat * pitch, row, scaledWidth * sizeof( uint32_t ) );
+        }
+    }
+    return *firstDrawn < *endDrawn;
+}
+
+static void *presentThread( void *argument ) {
+    (void)argument;
+
+    for ( ;; ) {
+        pthread_mutex_lock( &x11State.lock );
+        while ( !x11State.hasPending && !x11State.checkEvents && !x11State.quit ) {
+            pthread_cond_wait( &x11State.frameReady, &x11State.lock );
+        }
+        if ( x11State.quit ) {
+            pthread_mutex_unlock( &x11State.lock );
+            break;
+        }
+        // Only the dirty lines are taken, the rest of the working frame is already current
+        const uint16_t frameWidth = x11State.pendingWidth;
+        const uint16_t frameHeight = x11State.pendingHeight;
+        for ( uint16_t y = 0; y < frameHeight; ++y ) {
+            if ( !x11State.pendingDirty[ y ] ) {
+                continue;
+            }
+            memcpy( &x11State.workingFrame[ (uint32_t)y * frameWidth ], &x11State.pendingFrame[ (uint32_t)y * frameWidth ],
+                    frameWidth * sizeof( uint16_t ) );
+            x11State.pendingDirty[ y ] = false;
+            for ( uint8_t i = 0; i < NUM_IMAGES; ++i ) {
+                x11State.images[ i ].staleLines[ y ] = true;
+            }
+        }
+        x11State.hasPending = false;
+        x11State.checkEvents = false;
+        pthread_mutex_unlock( &x11State.lock );
+
+        X11Image *image = &x11State.images[ x11State.backImage ];
+        handleEvents( true, image );
+        uint32_t firstRow;
+        uint32_t endRow;
+        if ( !drawFrame( x11State.workingFrame, frameWidth, frameHeight, image, &firstRow, &endRow ) ) {
+            continue;
+        }
+
+        const uint32_t width = x11State.width * x11State.scale;
+        if ( x11State.useShm ) {
+            XShmPutImage( x11State.display, x11State.window, x11State.gc, image->image, 0, firstRow, 0, firstRow, width,
+                          endRow - firstRow, True );
+            image->inFlight = true;
+        }
+        else {
+            XPutImage( x11State.display, x11State.window, x11State.gc, image->image, 0, firstRow, 0, firstRow, width,
+                       endRow - firstRow );
+        }
+        XFlush( x11State.display );
+        x11State.backImage = ( x11State.backImage + 1 ) % NUM_IMAGES;
+    }
+
+    return NULL;
+}
+
+#pragma endregion
+
+static void windowClose();
+
+// target optionally gives the integer scale factor
+static bool windowOpen( const Framebuffer *framebuffer, const char *target ) {
+    if ( framebuffer->format != FRAMEBUFFER_BGR555 ) {
+        fprintf( stderr, "Window display needs a BGR555 framebuffer\n" );
+        return false;
+    }
+
+    memset( &x11State, 0x00, sizeof( X11State ) );
+    x11State.width = framebuffer->width;
+    x11State.height = framebuffer->height;
+    x11State.maxWidth = framebuffer->maxWidth;
+    x11State.maxHeight = framebuffer->maxHeight;
+    x11State.scale = DEFAULT_SCALE;
+    if ( target ) {
+        const long scale = strtol( target, NULL, 10 );
+        if ( scale < 1 || scale > PIXEL_SCALE_MAX ) {
+            fprintf( stderr, "Window scale must be 1-%d\n", PIXEL_SCALE_MAX );
+            return false;
+        }
+        x11State.scale = (uint8_t)scale;
+    }
+
+    x11State.display = XOpenDisplay( NULL );
+    if ( !x11State.display ) {
+        fprintf( stderr, "Unable to connect to the X server\n" );
+        return false;
+    }
+
+    const int screen = DefaultScreen( x11State.display );
+    Visual *visual = DefaultVisual( x11State.display, screen );
+    const int depth = DefaultDepth( x11State.display, screen );
+    if ( visual->class != TrueColor || depth < 24 ) {
+        fprintf( stderr, "Window display needs a 24-bit TrueColor visual\n" );
+        XCloseDisplay( x11State.display );
+        return false;
+    }
+
+    x11State.useShm = XShmQueryExtension( x11State.display );
+    if ( x11State.useShm ) {
+        x11State.completionEvent = XShmGetEventBase( x11State.display ) + ShmCompletion;
+    }
+    else {
+        printf( "MIT-SHM unavailable, presenting with XPutImage\n" );
+    }
+
+    const unsigned long black = BlackPixel( x11State.display, screen );
+    x11State.window = XCreateSimpleWindow( x11State.display, RootWindow( x11State.display, screen ),
+        0, 0, x11State.width * x11State.scale, x11State.height * x11State.scale, 0, black, black );
+    XStoreName( x11State.display, x11State.window, "SNESmulator" );
+    XSelectInput( x11State.display, x11State.window, StructureNotifyMask | ExposureMask | KeyPressMask | ButtonPressMask );
+    XMapWindow( x11State.display, x11State.window );
+    x11State.gc = XCreateGC( x11State.display, x11State.window, 0, NULL );
+
+    for ( uint8_t i = 0; i < NUM_IMAGES; ++i ) {
+        if ( !createImage( &x11State.images[ i ], visual, depth ) ) {
+            fprintf( stderr, "Unable to create the window images\n" );
+            windowClose();
+            return false;
+        }
+    }
+
+    const size_t frameBytes = (size_t)x11State.maxWidth * x11State.maxHeight * sizeof( uint16_t );
+    x11State.pendingFrame = calloc( 1, frameBytes );
+    x11State.pendingDirty = calloc( x11State.maxHeight, sizeof( bool ) );
+    x11State.workingFrame = calloc( 1, frameBytes );
+    x11State.convertedLine = calloc( x11State.maxWidth + 8, sizeof( uint32_t ) );
+    if ( !x11State.pendingFrame || !x11State.pendingDirty || !x11State.workingFrame || !x11State.convertedLine ) {
+        windowClose();
+        return false;
+    }
+
+    // Wait for the MapNotify event
+    for ( ;; ) {
+        XEvent event;
+        XNextEvent( x11State.display, &event );
+        if ( event.type == MapNotify ) {
+            break;
+        }
+    }
+
+    pthread_mutex_init( &x11State.lock, NULL );
+    pthread_cond_init( &x11State.frameReady, NULL );
+    if ( pthread_create( &x11State.thread, NULL, presentThread, NULL ) ) {
+        windowClose();
+        return false;
+    }
+    x11State.threadRunning = true;
+    return true;
+}
+
+static void windowPresent( const Framebuffer *framebuffer ) {
+    if ( !framebufferIsDirty( framebuffer ) ) {
+        // Nothing to copy, but an Expose may still need the last frame repainted
+        pthread_mutex_lock( &x11State.lock );
+        x11State.checkEvents = true;
+        pthread_cond_signal( &x11State.frameReady );
+        pthread_mutex_unlock( &x11State.lock );
+        return;
+    }
+    // A new size dirties every line, so lines packed at an old width are all replaced
+    pthread_mutex_lock( &x11State.lock );
+    uint16_t first = 0;
+    uint16_t end;
+    for ( ; framebufferNextDirtyRange( framebuffer, &first, &end ); first = end ) {
+        for ( uint16_t y = first; y < end; ++y ) {
+            memcpy( &x11State.pendingFrame[ (uint32_t)y * framebuffer->width ], framebufferLine( framebuffer, y ),
+                    framebuffer->width * sizeof( uint16_t ) );
+            x11State.pendingDirty[ y ] = true;
+        }
+    }
+    x11State.pendingWidth = framebuffer->width;
+    x11State.pendingHeight = framebuffer->height;
+    x11State.hasPending = true;
+    pthread_cond_signal( &x11State.frameReady );
+    pthread_mutex_unlock( &x11State.lock );
+}
+
+static void windowClose() {
+    if ( x11State.threadRunning ) {
+        pthread_mutex_lock( &x11State.lock );
+        x11State.quit = true;
+        pthread_cond_signal( &x11State.frameReady );
+        pthread_mutex_unlock( &x11State.lock );
+        pthread_join( x11State.thread, NULL );
+        pthread_mutex_destroy( &x11State.lock );
+        pthread_cond_destroy( &x11State.frameReady );
+        x11State.threadRunning = false;
+    }
+
+    for ( uint8_t i = 0; i < NUM_IMAGES; ++i ) {
+        destroyImage( &x11State.images[ i ] );
+    }
+    free( x11State.pendingFrame );
+    free( x11State.pendingDirty );
+    free( x11State.workingFrame );
+    free( x11State.convertedLine );
+    x11State.pendingFrame = x11State.workingFrame = NULL;
+    x11State.pendingDirty = NULL;
+    x11State.convertedLine = NULL;
+
+    XFreeGC( x11State.display, x11State.gc );
+    XDestroyWindow( x11State.display, x11State.window );
+    XCloseDisplay( x11State.display );
+}
+
+const DisplayBackend displayBackendWindow = {
+    .name = "window",
+    .preferredFormat = FRAMEBUFFER_BGR555,
+    .open = windowOpen,
+    .present = windowPresent,
+    .close = windowClose,
+};
@@ -1,7 +1,9 @@
 #include "dma.h"
 
 #include "cpu.h"
+#include "ppu.h"
 #include "system.h"
+#include "wram.h"
 
 #include <assert.h>
 #include <memory.h>
@@ -32,26 +34,86 @@ typedef struct DMARegisters {
     // 4380h..5FFFh    - Unused region (open bus)                                -
 } DMARegisters;
 
-typedef struct DMAChannelState {
-    uint8_t currentPos;
-} DMAChannelState;
-
+// Per-channel HDMA progress. The table address, line counter and indirect
+// address live in the channel registers (A2A, NTRL, DAS).
 typedef struct HDMAChannelState {
-    MemoryAddress currentMemoryAddress; // Irrespective of direct/indirect
-    bool repeat;
-    uint8_t linesRemaining;
     bool doTransfer;
+    bool terminated;
 } HDMAChannelState;
 
+// Channel state after a line has been processed, so the live registers can be
+// brought in step when that line's writes are applied.
+typedef struct HDMAChannelSnapshot {
+    uint8_t A2Al;
+    uint8_t A2Ah;
+    uint8_t DASl;
+    uint8_t DASh;
+    uint8_t NTRL;
+    HDMAChannelState state;
+} HDMAChannelSnapshot;
+
+// One channel's part of a line: its B-bus writes, and its state after the line
+typedef struct HDMAChannelLine {
+    HDMAWrite writes[ 4 ];
+    uint8_t numWrites;
+    uint8_t cycles;
+    bool active;
+    HDMAChannelSnapshot snapshot;
+} HDMAChannelLine;
+
+// The frame's HDMA, compiled per channel from the tables into per-line B-bus
+// writes. A channel is recompiled from the current line whenever HDMAEN, one of
+// its registers or the WRAM its table was read from is written. From the line a
+// channel first reads memory without a host pointer (I/O, open bus, ...) it runs
+// live on each line instead, so reads with side effects happen on their line.
+typedef struct HDMASchedule {
+    HDMAChannelLine lines[ HDMA_MAX_LINES ][ 8 ];
+    uint16_t liveLines[ 8 ];
+    uint8_t validChannels;
+} HDMASchedule;
+
+// WRAM a channel's compile read from, and whether it had to stop at a live read
+typedef struct HDMAReadWatch {
+    uint32_t low;
+    uint32_t high;
+    bool live;
+} HDMAReadWatch;
+
 static DMARegisters dmaRegisters[ 8 ];
-static DMAChannelState dmaChannelStates[ 8 ];
 static HDMAChannelState hdmaChannelStates[ 8 ];
+static HDMASchedule hdmaSchedule;
 
 typedef struct DMAState {
-    bool HDMAInProgress;
-    uint8_t currentHDMAChannel;
+    bool HDMAFrameActive;   // Between the end of V-blank and the start of the next
+    uint16_t HDMALine;      // Next line HDMA will run on
+    uint32_t stallCycles;   // Master cycles the CPU is held for by completed DMA/HDMA bursts
 } DMAState;
 
+// GPDMA timing, in master cycles
+#define GPDMA_CYCLES_PER_BYTE       8
+#define GPDMA_CYCLES_PER_CHANNEL    8
+#define GPDMA_CYCLES_OVERHEAD       18
+
+// HDMA timing, in master cycles
+#define HDMA_CYCLES_PER_BYTE        8
+#define HDMA_CYCLES_PER_CHANNEL     8
+#define HDMA_CYCLES_PER_ENTRY       8
+#define HDMA_CYCLES_PER_INDIRECT    16
+#define HDMA_CYCLES_OVERHEAD        18
+
+// B-bus address offsets for each byte of a transfer unit, per DMAP transfer mode
+static const uint8_t transferUnitSizes[ 8 ] = { 1, 2, 2, 4, 4, 4, 2, 4 };
+static const uint8_t transferUnitPatterns[ 8 ][ 4 ] = {
+    { 0, 0, 0, 0 },
+    { 0, 1, 0, 0 },
+    { 0, 0, 0, 0 },
+    { 0, 0, 1, 1 },
+    { 0, 1, 2, 3 },
+    { 0, 1, 0, 1 },
+    { 0, 0, 0, 0 },
+    { 0, 0, 1, 1 }
+};
+
 static DMAState dmaState;
 
 void dmaInitialise() {
@@ -61,291 +123,404 @@ void dmaInitialise() {
     memset( &dmaRegisters, 0xFF, sizeof( DMARegisters ) * 8 );
 }
 
-static inline void GPDMAChannelTick( uint8_t channel ) {
-    static const uint8_t transferUnitSizes[ 8 ] = { 1, 2, 2, 4, 4, 4, 2, 4 };
-
-    DMARegisters *channelRegisters = &dmaRegisters[ channel ];
-    DMAChannelState *dmaChannelState = &dmaChannelStates[ channel ];
+// Per-byte path for transfers without a fast kernel. Returns the final A-bus address.
+static MemoryAddress GPDMATransferGeneric( DMARegisters *channelRegisters, MemoryAddress ABusAddress, uint32_t numBytes, int8_t ABusStep ) {
+    const uint8_t transferUnitMode = channelRegisters->DMAP & 0x07;
+    const uint8_t *pattern = transferUnitPatterns[ transferUnitMode ];
+    const uint8_t unitMask = transferUnitSizes[ transferUnitMode ] - 1;
+    const bool BToA = channelRegisters->DMAP & 0x80;
 
-    uint8_t BBusAddress = channelRegisters->BBAD;
-
-    MemoryAddress ABusAddress = {
-        .bank = channelRegisters->A1Tb,
-        .offset = ( ( (uint16_t)channelRegisters->A1Th ) << 8 ) | ( (uint16_t)channelRegisters->A1Tl )
-    };
-    
-    const uint8_t transferUnitMode = channelRegisters->DMAP & 0x7;
-    const uint8_t transferUnitSize = transferUnitSizes[ transferUnitMode ];
-    uint16_t bytesLeft = ( ( (uint16_t)channelRegisters->DASh ) << 8 ) | ( (uint16_t)channelRegisters->DASl );
-    uint8_t bytesToTransfer = 0;
-    if ( bytesLeft <= transferUnitSize ) {
-        bytesToTransfer = bytesLeft;
-        bytesLeft = 0;
-        channelRegisters->DASl = 0;
-        channelRegisters->DASh = 0;
-    }
-    else {
-        bytesToTransfer = transferUnitSize;
-        bytesLeft -= transferUnitSize;
-        
-        channelRegisters->DASl = (uint8_t)( bytesLeft & 0x00FF );
-        channelRegisters->DASh = (uint8_t)( ( bytesLeft >> 8 ) & 0x00FF );
-    }
-    
-    uint8_t ABusAddressStepMode = ( channelRegisters->DMAP >> 3 ) & 0x03;
-    // TODO - optimise this
-    for ( uint8_t i = 0; i < bytesToTransfer; ++i ) {
+    for ( uint32_t i = 0; i < numBytes; ++i ) {
+        uint8_t BBusAddress = channelRegisters->BBAD + pattern[ i & unitMask ];
+        uint8_t dataBus;
         // Transfer direction (1 is B->A, 0 is A->B)
         // TODO - A-bus access shoudn't be able to map to B-bus
-        if ( channelRegisters->DMAP & 0x80 ) {
-            uint8_t dataBus;
+        if ( BToA ) {
             B_BusAccess( BBusAddress, &dataBus, false );
             MemoryAccess( ABusAddress, &dataBus, true );
         }
         else {
-            uint8_t dataBus;
             MemoryAccess( ABusAddress, &dataBus, false );
             B_BusAccess( BBusAddress, &dataBus, true );
         }
-        
-        switch ( ABusAddressStepMode ) {
-            case 0x00:
-                ++ABusAddress.offset;
-                break;
-            case 0x02:
-                --ABusAddress.offset;
-                break;
-        }
+        ABusAddress.offset += ABusStep;
+    }
+    return ABusAddress;
+}
 
-        switch ( transferUnitMode ) {
-            case 0x00:
-                // NOP
-                assert( bytesToTransfer == 1 );
-                break;
+// Kernels writing straight into the destination memory for the common A->B
+// patterns. Returns false if the transfer doesn't match one.
+static bool GPDMATransferFast( DMARegisters *channelRegisters, MemoryAddress ABusAddress, uint32_t numBytes, int8_t ABusStep ) {
+    if ( ( channelRegisters->DMAP & 0x80 ) || ABusStep < 0 ) {
+        return false;
+    }
+    uint32_t contiguousBytes = 0;
+    const uint8_t *source = ABusHostPointer( ABusAddress, &contiguousBytes, false );
+    const bool fixedSource = ( ABusStep == 0 );
+    if ( !source || ( !fixedSource && contiguousBytes < numBytes ) ) {
+        return false;
+    }
 
-            case 0x01:
-                assert( bytesToTransfer <= 2 );
-                ++BBusAddress;
-                break;
+    const uint8_t transferUnitMode = channelRegisters->DMAP & 0x07;
+    const bool singleRegister = transferUnitMode == 0x00 || transferUnitMode == 0x02 || transferUnitMode == 0x06;
+    switch ( channelRegisters->BBAD ) {
+        case 0x18:
+            // VMDATAL/H, ROM->VRAM
+            if ( transferUnitMode != 0x01 ) {
+                return false;
+            }
+            ppuVRAMBulkWrite( source, numBytes, fixedSource );
+            return true;
+        case 0x22:
+            // CGDATA
+            if ( !singleRegister ) {
+                return false;
+            }
+            ppuCGRAMBulkWrite( source, numBytes, fixedSource );
+            return true;
+        case 0x04:
+            // OAMDATA
+            if ( !singleRegister ) {
+                return false;
+            }
+            ppuOAMBulkWrite( source, numBytes, fixedSource );
+            return true;
+        case 0x80:
+            // WMDATA
+            // A WRAM source can overlap the destination, which only the byte-serial path gets right
+            if ( !singleRegister || ABusWRAMIndex( ABusAddress ) >= 0 ) {
+                return false;
+            }
+            if ( fixedSource ) {
+                wramBBusBulkFill( *source, numBytes );
+            }
+            else {
+                wramBBusBulkWrite( source, numBytes );
+            }
+            return true;
+        default:
+            return false;
+    }
+}
 
-            case 0x02:
-            case 0x06:
-                // NOP
-                assert( bytesToTransfer <= 2 );
-                break;
+// Run a whole channel transfer. Returns the number of bytes moved.
+static uint32_t GPDMAChannelTransfer( uint8_t channel ) {
+    DMARegisters *channelRegisters = &dmaRegisters[ channel ];
 
-            case 0x03:
-            case 0x07:
-                assert( bytesToTransfer <= 4 );
-                if ( i == 1 ){ ++BBusAddress; }
-                break;
+    MemoryAddress ABusAddress = {
+        .bank = channelRegisters->A1Tb,
+        .offset = TEMP_ADDR16_CONCAT( channelRegisters->A1Th, channelRegisters->A1Tl )
+    };
+    uint32_t numBytes = TEMP_ADDR16_CONCAT( channelRegisters->DASh, channelRegisters->DASl );
+    if ( numBytes == 0 ) {
+        numBytes = 0x10000;
+    }
 
-            case 0x04:
-                assert( bytesToTransfer <= 4 );
-                ++BBusAddress;
-                break;
+    // Step mode 0 increments, 2 decrements, 1/3 are fixed
+    static const int8_t ABusSteps[ 4 ] = { 1, 0, -1, 0 };
+    const int8_t ABusStep = ABusSteps[ ( channelRegisters->DMAP >> 3 ) & 0x03 ];
 
-            case 0x05:
-                assert( bytesToTransfer <= 4 );
-                if ( i == 0 || i == 2 ) { ++BBusAddress; }
-                else if ( i == 1 ) { --BBusAddress; }
-                break;
-            
-        }
+    if ( GPDMATransferFast( channelRegisters, ABusAddress, numBytes, ABusStep ) ) {
+        ABusAddress.offset += (uint16_t)( numBytes * ABusStep );
     }
-    
+    else {
+        ABusAddress = GPDMATransferGeneric( channelRegisters, ABusAddress, numBytes, ABusStep );
+    }
+
     channelRegisters->A1Th = (uint8_t)( ( ABusAddress.offset >> 8 ) & 0x00FF );
     channelRegisters->A1Tl = (uint8_t)( ABusAddress.offset & 0x00FF );
+    channelRegisters->DASl = 0;
+    channelRegisters->DASh = 0;
+    return numBytes;
+}
 
-    if ( bytesLeft == 0 ) {
-        channelSelect.DMAChannelSelect &= ~( 1 << channel );
+// Execute every selected channel as one burst when MDMAEN is written, holding
+// the CPU for the cycles the transfer would have taken.
+static void GPDMAExecute() {
+    uint32_t cycles = GPDMA_CYCLES_OVERHEAD;
+    for ( uint8_t i = 0; i < 8; ++i ) {
+        if ( channelSelect.DMAChannelSelect & ( 1 << i ) ) {
+            uint32_t numBytes = GPDMAChannelTransfer( i );
+            cycles += GPDMA_CYCLES_PER_CHANNEL + ( numBytes * GPDMA_CYCLES_PER_BYTE );
+        }
     }
+    channelSelect.DMAChannelSelect = 0x00;
+    dmaState.stallCycles += cycles;
 }
 
-static inline void HDMAChannelTick( uint8_t channel ) {
-    static const uint8_t transferUnitSizes[ 8 ] = { 1, 2, 2, 4, 4, 4, 2, 4 };
+#pragma region HDMA
+// Reads during a compile go through host pointers only and note the WRAM they
+// touch; anything else marks the watch live and reads nothing. Without a watch
+// the read is a real bus access, made on the line it belongs to.
+static inline uint8_t HDMARead( MemoryAddress address, HDMAReadWatch *watch ) {
+    uint8_t dataBus;
+    if ( !watch ) {
+        MemoryAccess( address, &dataBus, false );
+        return dataBus;
+    }
+    uint32_t contiguousBytes;
+    const uint8_t *hostAddress = ABusHostPointer( address, &contiguousBytes, false );
+    if ( !hostAddress ) {
+        watch->live = true;
+        return 0x00;
+    }
+    int32_t wramIndex = ABusWRAMIndex( address );
+    if ( wramIndex >= 0 ) {
+        // Table data in WRAM can change under us, so keep track of what was read
+        watch->low = (uint32_t)wramIndex < watch->low ? (uint32_t)wramIndex : watch->low;
+        watch->high = (uint32_t)wramIndex > watch->high ? (uint32_t)wramIndex : watch->high;
+    }
+    return *hostAddress;
+}
 
-    DMARegisters *channelRegisters = &dmaRegisters[ channel ];
-    HDMAChannelState *hdmaChannelState = &hdmaChannelStates[ channel ];
-    bool indirectMode = ( channelRegisters->DMAP >> 6 ) & 0x01;
-    
-    if ( hdmaChannelState->doTransfer ) {
-        if ( channelSelect.DMAChannelSelect & ( 1 << channel ) ) {
-            channelSelect.DMAChannelSelect &= ~( 1 << channel );
-        }
-        uint8_t BBusAddress = channelRegisters->BBAD;
+// Read the next table entry header, returning the cycles it took
+static uint16_t HDMALoadEntry( DMARegisters *registers, HDMAChannelState *state, HDMAReadWatch *watch ) {
+    const bool indirectMode = ( registers->DMAP >> 6 ) & 0x01;
+    MemoryAddress entryAddress = {
+        .bank = registers->A1Tb,
+        .offset = TEMP_ADDR16_CONCAT( registers->A2Ah, registers->A2Al )
+    };
+    uint16_t cycles = HDMA_CYCLES_PER_ENTRY;
+
+    registers->NTRL = HDMARead( entryAddress, watch );
+    ++entryAddress.offset;
+    if ( indirectMode ) {
+        registers->DASl = HDMARead( entryAddress, watch );
+        ++entryAddress.offset;
+        registers->DASh = HDMARead( entryAddress, watch );
+        ++entryAddress.offset;
+        cycles += HDMA_CYCLES_PER_INDIRECT;
+    }
+    registers->A2Ah = (uint8_t)( ( entryAddress.offset >> 8 ) & 0x00FF );
+    registers->A2Al = (uint8_t)( entryAddress.offset & 0x00FF );
+
+    state->terminated = ( registers->NTRL == 0x00 );
+    state->doTransfer = !state->terminated;
+    return cycles;
+}
+
+// Process one line of one channel, collecting the B-bus writes it produces.
+// Returns the cycles it took.
+static uint16_t HDMAChannelStep( DMARegisters *registers, HDMAChannelState *state, HDMAChannelLine *line, HDMAReadWatch *watch ) {
+    const bool indirectMode = ( registers->DMAP >> 6 ) & 0x01;
+    uint16_t cycles = HDMA_CYCLES_PER_CHANNEL;
 
+    if ( state->doTransfer ) {
         MemoryAddress ABusAddress;
-        if ( indirectMode ) { 
+        if ( indirectMode ) {
             ABusAddress = (MemoryAddress) {
-                .bank = channelRegisters->A1Tb,
-                .offset = ( ( (uint16_t)channelRegisters->DASh ) << 8 ) | ( (uint16_t)channelRegisters->DASl )
+                .bank = registers->DASb,
+                .offset = TEMP_ADDR16_CONCAT( registers->DASh, registers->DASl )
             };
         }
         else {
             ABusAddress = (MemoryAddress) {
-                .bank = channelRegisters->A1Tb,
-                .offset = ( ( (uint16_t)channelRegisters->A2Ah ) << 8 ) | ( (uint16_t)channelRegisters->A2Al )
+                .bank = registers->A1Tb,
+                .offset = TEMP_ADDR16_CONCAT( registers->A2Ah, registers->A2Al )
             };
         }
 
-        const uint8_t transferUnitMode = channelRegisters->DMAP & 0x7;
+        const uint8_t transferUnitMode = registers->DMAP & 0x07;
         const uint8_t transferUnitSize = transferUnitSizes[ transferUnitMode ];
+        const uint8_t *pattern = transferUnitPatterns[ transferUnitMode ];
+        // Transfer direction (1 is B->A, 0 is A->B)
+        const bool BToA = registers->DMAP & 0x80;
         for ( uint8_t i = 0; i < transferUnitSize; ++i ) {
-            // Transfer direction (1 is B->A, 0 is A->B)
-            // TODO - A-bus access shoudn't be able to map to B-bus
-            if ( channelRegisters->DMAP & 0x80 ) {
-                uint8_t dataBus;
-                B_BusAccess( BBusAddress, &dataBus, false );
-                MemoryAccess( ABusAddress, &dataBus, true );
-            }
-            else {
-                uint8_t dataBus;
-                MemoryAccess( ABusAddress, &dataBus, false );
-                B_BusAccess( BBusAddress, &dataBus, true );
-            }
+            line->writes[ line->numWrites++ ] = (HDMAWrite) {
+                .BBusAddress = registers->BBAD + pattern[ i ],
+                .value = BToA ? 0x00 : HDMARead( ABusAddress, watch ),
+                .BToA = BToA,
+                .ABusAddress = ABusAddress
+            };
             ++ABusAddress.offset;
-
-            switch ( transferUnitMode ) {
-                case 0x00:
-                    // NOP
-                    break;
-
-                case 0x01:
-                    ++BBusAddress;
-                    break;
-
-                case 0x02:
-                case 0x06:
-                    // NOP
-                    break;
-
-                case 0x03:
-                case 0x07:
-                    if ( i == 1 ){ ++BBusAddress; }
-                    break;
-
-                case 0x04:
-                    ++BBusAddress;
-                    break;
-
-                case 0x05:
-                    if ( i == 0 || i == 2 ) { ++BBusAddress; }
-                    else if ( i == 1 ) { --BBusAddress; }
-                    break;
-                
-            }
         }
+        cycles += transferUnitSize * HDMA_CYCLES_PER_BYTE;
 
-        if ( indirectMode ) { 
-            channelRegisters->DASh = (uint8_t)( ( ABusAddress.offset >> 8 ) & 0x00FF );
-            channelRegisters->DASl = (uint8_t)( ABusAddress.offset & 0x00FF );
+        if ( indirectMode ) {
+            registers->DASh = (uint8_t)( ( ABusAddress.offset >> 8 ) & 0x00FF );
+            registers->DASl = (uint8_t)( ABusAddress.offset & 0x00FF );
         }
         else {
-            channelRegisters->A2Ah = (uint8_t)( ( ABusAddress.offset >> 8 ) & 0x00FF );
-            channelRegisters->A2Al = (uint8_t)( ABusAddress.offset & 0x00FF );
+            registers->A2Ah = (uint8_t)( ( ABusAddress.offset >> 8 ) & 0x00FF );
+            registers->A2Al = (uint8_t)( ABusAddress.offset & 0x00FF );
         }
     }
-    --channelRegisters->NTRL;
-    if ( ( channelRegisters->NTRL & ~0x80 ) == 0 ) {
-        uint16_t offset = TEMP_ADDR16_CONCAT( channelRegisters->A2Ah, channelRegisters->A2Al );
-        MemoryAddress entryAddress = {
-            .bank = channelRegisters->A1Tb,
-            .offset = offset
-        };
 
-        MemoryAccess( entryAddress, &channelRegisters->NTRL, false );
-        ++entryAddress.offset;
+    --registers->NTRL;
+    state->doTransfer = registers->NTRL & 0x80;
+    if ( ( registers->NTRL & 0x7F ) == 0 ) {
+        cycles += HDMALoadEntry( registers, state, watch );
+    }
+    return cycles;
+}
 
-        if ( indirectMode ) {
-            MemoryAccess( entryAddress, &channelRegisters->DASl, false );
-            ++entryAddress.offset;
-            MemoryAccess( entryAddress, &channelRegisters->DASh, false );
-            ++entryAddress.offset;
+// Compile one channel from firstLine to the end of the frame, or to the line it
+// has to run live from, starting from its live state. Nothing live is modified;
+// the WRAM it read is watched so table writes invalidate the result.
+static void HDMACompileChannel( uint8_t channel, uint16_t firstLine ) {
+    DMARegisters registers = dmaRegisters[ channel ];
+    HDMAChannelState state = hdmaChannelStates[ channel ];
+    HDMAReadWatch watch = { .low = UINT32_MAX, .high = 0, .live = false };
+
+    uint16_t line = firstLine;
+    for ( ; line < HDMA_MAX_LINES; ++line ) {
+        HDMAChannelLine *channelLine = &hdmaSchedule.lines[ line ][ channel ];
+        channelLine->numWrites = 0;
+        channelLine->cycles = 0;
+        channelLine->active = !state.terminated;
+        if ( channelLine->active ) {
+            channelLine->cycles = (uint8_t)HDMAChannelStep( &registers, &state, channelLine, &watch );
+            if ( watch.live ) {
+                break;
+            }
         }
-        channelRegisters->A2Ah = (uint8_t)( ( entryAddress.offset >> 8 ) & 0x00FF );
-        channelRegisters->A2Al = (uint8_t)( entryAddress.offset & 0x00FF );
+        channelLine->snapshot = (HDMAChannelSnapshot) {
+            .A2Al = registers.A2Al,
+            .A2Ah = registers.A2Ah,
+            .DASl = registers.DASl,
+            .DASh = registers.DASh,
+            .NTRL = registers.NTRL,
+            .state = state
+        };
+    }
+
+    hdmaSchedule.liveLines[ channel ] = line;
+    hdmaSchedule.validChannels |= 1 << channel;
+    wramWatchWrites( channel, watch.low, watch.high );
+}
 
-        hdmaChannelState->doTransfer = ( channelRegisters->NTRL > 0x00 );
+static void HDMAApplyWrites( const HDMAChannelLine *channelLine ) {
+    for ( uint8_t i = 0; i < channelLine->numWrites; ++i ) {
+        const HDMAWrite *write = &channelLine->writes[ i ];
+        uint8_t value = write->value;
+        if ( write->BToA ) {
+            // The B-bus value is only known now
+            B_BusAccess( write->BBusAddress, &value, false );
+            MemoryAccess( write->ABusAddress, &value, true );
+        }
+        else {
+            B_BusAccess( write->BBusAddress, &value, true );
+        }
     }
 }
 
-static inline void GPDMATick() {
+static void HDMAApplyLine( uint16_t line ) {
+    uint16_t cycles = 0;
+    bool active = false;
     for ( uint8_t i = 0; i < 8; ++i ) {
-        if ( channelSelect.DMAChannelSelect & ( 1 << i ) ) {
-            GPDMAChannelTick( i );
-            return;
+        if ( !( channelSelect.HDMAChannelSelect & ( 1 << i ) ) ) {
+            continue;
+        }
+        // An earlier channel's writes this line may have invalidated this one
+        if ( !( hdmaSchedule.validChannels & ( 1 << i ) ) ) {
+            HDMACompileChannel( i, line );
+        }
+
+        if ( line >= hdmaSchedule.liveLines[ i ] ) {
+            if ( hdmaChannelStates[ i ].terminated ) {
+                continue;
+            }
+            HDMAChannelLine channelLine = { .numWrites = 0 };
+            cycles += HDMAChannelStep( &dmaRegisters[ i ], &hdmaChannelStates[ i ], &channelLine, NULL );
+            HDMAApplyWrites( &channelLine );
+            active = true;
+            continue;
+        }
+
+        const HDMAChannelLine *channelLine = &hdmaSchedule.lines[ line ][ i ];
+        if ( !channelLine->active ) {
+            continue;
         }
+        HDMAApplyWrites( channelLine );
+        const HDMAChannelSnapshot *snapshot = &channelLine->snapshot;
+        dmaRegisters[ i ].A2Al = snapshot->A2Al;
+        dmaRegisters[ i ].A2Ah = snapshot->A2Ah;
+        dmaRegisters[ i ].DASl = snapshot->DASl;
+        dmaRegisters[ i ].DASh = snapshot->DASh;
+        dmaRegisters[ i ].NTRL = snapshot->NTRL;
+        hdmaChannelStates[ i ] = snapshot->state;
+        cycles += channelLine->cycles;
+        active = true;
     }
+    if ( active ) {
+        cycles += HDMA_CYCLES_OVERHEAD;
+    }
+    dmaState.stallCycles += cycles;
+}
+
+void dmaHDMAInvalidate( uint8_t channels ) {
+    hdmaSchedule.validChannels &= ~channels;
 }
 
-static inline void HDMATick() {
-    HDMAChannelTick( dmaState.currentHDMAChannel );
-    if ( dmaState.currentHDMAChannel == 7 ) {
-        dmaState.HDMAInProgress = false;
-        dmaState.currentHDMAChannel = 0;
+const HDMAWrite *dmaHDMALineWrites( uint16_t line, uint8_t *numWrites ) {
+    static HDMAWrite lineWrites[ HDMA_MAX_WRITES_PER_LINE ];
+    *numWrites = 0;
+    if ( !dmaState.HDMAFrameActive || line < dmaState.HDMALine || line >= HDMA_MAX_LINES ) {
+        return NULL;
+    }
+    for ( uint8_t i = 0; i < 8; ++i ) {
+        if ( !( channelSelect.HDMAChannelSelect & ( 1 << i ) ) ) {
+            continue;
+        }
+        if ( !( hdmaSchedule.validChannels & ( 1 << i ) ) ) {
+            HDMACompileChannel( i, dmaState.HDMALine );
+        }
+        const HDMAChannelLine *channelLine = &hdmaSchedule.lines[ line ][ i ];
+        if ( line < hdmaSchedule.liveLines[ i ] && channelLine->active ) {
+            memcpy( &lineWrites[ *numWrites ], channelLine->writes, channelLine->numWrites * sizeof( HDMAWrite ) );
+            *numWrites += channelLine->numWrites;
+        }
     }
+    return lineWrites;
 }
+#pragma endregion
 
 bool dmaTick() {
-    if ( dmaState.HDMAInProgress ) {
-        HDMATick();
-        return true;
-    }
-    else if ( channelSelect.DMAChannelSelect > 0 ) {
-        GPDMATick();
+    if ( dmaState.stallCycles > 0 ) {
+        --dmaState.stallCycles;
         return true;
     }
     return false;
 }
 
 void dmaHBlank() {
+    if ( !dmaState.HDMAFrameActive || dmaState.HDMALine >= HDMA_MAX_LINES ) {
+        return;
+    }
     if ( channelSelect.HDMAChannelSelect > 0 ) {
-        dmaState.HDMAInProgress = true;
-        dmaState.currentHDMAChannel = 0;
+        HDMAApplyLine( dmaState.HDMALine );
     }
+    ++dmaState.HDMALine;
 }
 
 void dmaVBlank( bool level ) {
-    if ( level == false ) {
-        // Falling-edge, VBlank ending. Reload HDMA Registers
+    if ( level == true ) {
+        dmaState.HDMAFrameActive = false;
         for ( uint8_t i = 0; i < 8; ++i ) {
-            DMARegisters *registers = &dmaRegisters[ i ];
-            HDMAChannelState *state = &hdmaChannelStates[ i ];
-            if ( ( channelSelect.HDMAChannelSelect & ( 1 << i ) ) == 0 ) {
-                state->doTransfer = false;
-                continue;
-            } 
-            state->doTransfer = true;
-            
-            registers->A2Al = registers->A1Tl;
-            registers->A2Ah = registers->A1Th;
-            bool indirectMode = ( registers->DMAP >> 6 ) & 0x01;
-            MemoryAddress address = {
-                .bank = registers->A1Tb,
-                .offset = TEMP_ADDR16_CONCAT( registers->A2Ah, registers->A2Al )
-            };
+            wramWatchWrites( i, UINT32_MAX, 0 );
+        }
+        return;
+    }
 
-            if ( indirectMode ) {
-                // Indirect mode, read table address from address
-                uint16_t offset;
-                uint8_t temp;
-                MemoryAccess( address, &temp, false );
-                offset = temp;
-                ++address.offset;
-                MemoryAccess( address, &temp, false );
-                offset |= ( (uint16_t)temp ) << 8;
-                address.offset = offset;
-            }
-            uint8_t nrtl;
-            MemoryAccess( address, &nrtl, false );
-            ++address.offset;
-            registers->NTRL = nrtl;
-            --nrtl;
-            hdmaChannelStates[ i ].currentMemoryAddress = address;
-            hdmaChannelStates[ i ].repeat = registers->NTRL & 0x80;
-            hdmaChannelStates[ i ].linesRemaining = registers->NTRL & ~0x80;
+    // Falling-edge, VBlank ending. Reload HDMA Registers, the channels are compiled on the first line
+    dmaState.HDMAFrameActive = true;
+    dmaState.HDMALine = 0;
+    hdmaSchedule.validChannels = 0x00;
+    uint32_t initCycles = 0;
+    for ( uint8_t i = 0; i < 8; ++i ) {
+        DMARegisters *registers = &dmaRegisters[ i ];
+        HDMAChannelState *state = &hdmaChannelStates[ i ];
+        if ( ( channelSelect.HDMAChannelSelect & ( 1 << i ) ) == 0 ) {
+            state->doTransfer = false;
+            state->terminated = true;
+            continue;
         }
+        registers->A2Al = registers->A1Tl;
+        registers->A2Ah = registers->A1Th;
+        initCycles += HDMALoadEntry( registers, state, NULL );
+    }
+    if ( initCycles ) {
+        dmaState.stallCycles += initCycles + HDMA_CYCLES_OVERHEAD;
     }
 }
 
@@ -356,6 +531,12 @@ void dmaPortAccess( uint16_t portBus, uint8_t *dataBus, bool writeLine ) {
             return;
         }
         *( ( (uint8_t*) &channelSelect) + portBus - 0x420B ) = *dataBus;
+        if ( portBus == 0x420B && channelSelect.DMAChannelSelect ) {
+            GPDMAExecute();
+        }
+        else if ( portBus == 0x420C ) {
+            dmaHDMAInvalidate( 0xFF );
+        }
         return;
     }
     else if( portBus < 0x4300 || portBus > 0x437F ) {
@@ -363,7 +544,7 @@ void dmaPortAccess( uint16_t portBus, uint8_t *dataBus, bool writeLine ) {
         return;
     }
     else {
-        uint8_t channel = (uint8_t)( ( portBus & 0x00F0 ) >> 8 );
+        uint8_t channel = (uint8_t)( ( portBus & 0x00F0 ) >> 4 );
         uint8_t offset = (uint8_t)( portBus & 0x000F );
         
         DMARegisters *channelRegisters = &dmaRegisters[ channel ];
@@ -422,6 +603,9 @@ void dmaPortAccess( uint16_t portBus, uint8_t *dataBus, bool writeLine ) {
 
         if ( writeLine ) {
             *hostAddress = *dataBus;
+            if ( channelSelect.HDMAChannelSelect & ( 1 << channel ) ) {
+                dmaHDMAInvalidate( 1 << channel );
+            }
         }
         else {
             *dataBus = *hostAddress;
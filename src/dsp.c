@@ -4,7 +4,11 @@
 #include <string.h>
 #include <stdlib.h>
 
+// Tools that only pull samples with dspNextSample build with DSP_NO_PORTAUDIO
+// so they don't need PortAudio installed
+#ifndef DSP_NO_PORTAUDIO
 #include <portaudio.h>
+#endif
 
 
 static const char* voiceNameLookup[ 0xA ] = {
@@ -216,11 +220,19 @@ void accessDspRegister( uint8_t *dataBus, bool writeLine ) {
 
     return;
 }
+static bool useAudioOutput = true;
+
+#ifndef DSP_NO_PORTAUDIO
 static PaStream *portAudioStream;
 
 int portAudioStreamCallback( const void *input, void *output, unsigned long frameCount,
                              const PaStreamCallbackTimeInfo* timeInfo,
                              PaStreamCallbackFlags statusFlags, void *userData );
+#endif
+
+void dspUseAudioOutput( bool enable ) {
+    useAudioOutput = enable;
+}
 
 void dspInitialise() {
     memset( &registers, 0x00, sizeof( Registers ) );
@@ -228,17 +240,21 @@ void dspInitialise() {
     registers.FLG = ( 1 << 7 ) | ( 1 << 6 ); // Reset, Mute
     dspAddressLatch = 0x00;
 
-    if ( Pa_Initialize() != paNoError ) {
-        printf( "Failed to initialise PortAudio\n" );
-    }
+#ifndef DSP_NO_PORTAUDIO
+    if ( useAudioOutput ) {
+        if ( Pa_Initialize() != paNoError ) {
+            printf( "Failed to initialise PortAudio\n" );
+        }
 
-    if ( Pa_OpenDefaultStream( &portAudioStream, 0, 2, paInt16, 32000, 1, portAudioStreamCallback, NULL ) != paNoError ) {
-        printf( "Failed to open PortAudio stream\n" );
-    }
+        if ( Pa_OpenDefaultStream( &portAudioStream, 0, 2, paInt16, 32000, 1, portAudioStreamCallback, NULL ) != paNoError ) {
+            printf( "Failed to open PortAudio stream\n" );
+        }
 
-    if ( Pa_StartStream( portAudioStream ) != paNoError ) {
-        printf( "Failed to start PortAudio stream\n" );
+        if ( Pa_StartStream( portAudioStream ) != paNoError ) {
+            printf( "Failed to start PortAudio stream\n" );
+        }
     }
+#endif
 
 
     for( uint8_t i = 0; i < 8; ++i ) {
@@ -257,6 +273,7 @@ void dspInitialise() {
 
 }
 
+
 static inline uint16_t getBRRBlockCount( uint16_t addr ) {
     static const uint16_t s_maxBlocks = 256; // TODO
         
@@ -383,6 +400,25 @@ static inline void loadVoiceBuffer( uint8_t voiceId ) {
     //uint32_t sampleRate = pitch * 7.8125;
 }
 
+void dspLoadRegisters( const uint8_t *values ) {
+    memcpy( &registers, values, sizeof( Registers ) );
+
+    // Voices sounding in the snapshot are started from the top of their sample,
+    // the BRR position and envelope aren't part of the registers
+    for ( uint8_t voiceId = 0; voiceId < 8; ++voiceId ) {
+        const uint8_t mask = 1 << voiceId;
+        const VoiceRegisters *voice = (const VoiceRegisters*)( ( (const uint8_t*) &registers ) + ( voiceId * 0x10 ) );
+        VoiceState *voiceState = &dspState.voiceStates[ voiceId ];
+        voiceState->currentState = ( ( registers.KON & mask ) ? KEY_STATE_KON : 0x00 ) | ( ( registers.KOF & mask ) ? KEY_STATE_KOF : 0x00 );
+        voiceState->currentBlock = 0;
+        voiceState->currentSample = 0;
+        voiceState->playing = voice->ENVX != 0 || voiceState->currentState == KEY_STATE_KON;
+        if ( voiceState->playing ) {
+            loadVoiceBuffer( voiceId );
+        }
+    }
+}
+
 typedef struct VoiceSample {
     int16_t sampleLeft;
     int16_t sampleRight;
@@ -406,10 +442,10 @@ static VoiceSample getNextVoiceSample( uint8_t voiceId ) {
     if ( inLoopBlock ) {
         uint16_t loopBlock = voiceState->currentBlock - voiceState->voiceData.numLeadinBlocks;
         uint16_t loopSample = ( loopBlock * 16 ) + voiceState->currentSample++;
-        if ( voiceState->currentSample > 16 ) {
+        if ( voiceState->currentSample == 16 ) {
             voiceState->currentSample = 0;
             voiceState->currentBlock++;
-            if ( loopBlock >= voiceState->voiceData.numLoopBlocks ) {
+            if ( loopBlock + 1 >= voiceState->voiceData.numLoopBlocks ) {
                 voiceState->currentBlock = voiceState->voiceData.numLeadinBlocks;
             }
         }
@@ -417,7 +453,7 @@ static VoiceSample getNextVoiceSample( uint8_t voiceId ) {
     }
     else {
         uint16_t leadinSample = ( voiceState->currentBlock * 16 ) + voiceState->currentSample++;
-        if ( voiceState->currentSample > 16 ) {
+        if ( voiceState->currentSample == 16 ) {
             voiceState->currentSample = 0;
             voiceState->currentBlock++;
             if ( voiceState->currentBlock >= voiceState->voiceData.numLeadinBlocks ) {
@@ -508,18 +544,9 @@ void dspTick() {
     }
 }
 
-int portAudioStreamCallback( const void *input, void *output, unsigned long frameCount,
-                             const PaStreamCallbackTimeInfo* timeInfo,
-                             PaStreamCallbackFlags statusFlags, void *userData ) {
-    (void)input;
-    (void)frameCount;
-    (void)timeInfo;
-    (void)statusFlags;
-    (void)userData;
-
+void dspNextSample( int16_t *left, int16_t *right ) {
     static uint64_t cnt = 0;
     VoiceSample frameSample = { 0x00, 0x00 };
-    int16_t *outBuffer = (int16_t*) output;
     for ( uint8_t voiceId = 0; voiceId < 8; ++voiceId ) {
         VoiceSample voiceSample = getNextVoiceSample( voiceId );
         frameSample.sampleLeft += voiceSample.sampleLeft;
@@ -529,7 +556,22 @@ int portAudioStreamCallback( const void *input, void *output, unsigned long fram
     //frameSample = ( ++cnt % 256 ) * 10;
     frameSample.sampleLeft = (int16_t)( ( (int32_t)frameSample.sampleLeft * (int32_t)registers.MVOL_L ) >> 7 );
     frameSample.sampleRight = (int16_t)( ( (int32_t)frameSample.sampleRight * (int32_t)registers.MVOL_R ) >> 7 );
-    *outBuffer++ = frameSample.sampleLeft;
-    *outBuffer = frameSample.sampleRight;
+    *left = frameSample.sampleLeft;
+    *right = frameSample.sampleRight;
+}
+
+#ifndef DSP_NO_PORTAUDIO
+int portAudioStreamCallback( const void *input, void *output, unsigned long frameCount,
+                             const PaStreamCallbackTimeInfo* timeInfo,
+                             PaStreamCallbackFlags statusFlags, void *userData ) {
+    (void)input;
+    (void)frameCount;
+    (void)timeInfo;
+    (void)statusFlags;
+    (void)userData;
+
+    int16_t *outBuffer = (int16_t*) output;
+    dspNextSample( &outBuffer[ 0 ], &outBuffer[ 1 ] );
     return paNoError;
-}
\ No newline at end of file
+}
+#endif
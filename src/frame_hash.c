@@ -0,0 +1,290 @@
+#include "frame_hash.h"
+
+#include "system.h"
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined( __AVX2__ )
+#include <immintrin.h>
+#endif
+
+// XXH3 style hash: eight 64-bit lanes accumulate 64 byte stripes with a
+// 32x32->64 multiply, and are scrambled every block of 16 stripes. Not
+// bit-compatible with XXH3, the secret is our own.
+
+#define STRIPE_SIZE 64
+#define STRIPE_LANES 8
+#define STRIPES_PER_BLOCK 16
+
+#define PRIME32_1 0x9E3779B1u
+#define PRIME32_2 0x85EBCA77u
+#define PRIME32_3 0xC2B2AE3Du
+#define PRIME64_1 0x9E3779B185EBCA87ull
+#define PRIME64_2 0xC2B2AE3D27D4EB4Full
+#define PRIME64_3 0x165667B19E3779F9ull
+#define PRIME64_4 0x85EBCA77C2B2AE63ull
+#define PRIME64_5 0x27D4EB2F165667C5ull
+
+// Stripe n of a block uses secret[ n ] to secret[ n + 7 ], the scramble the last 8
+static const uint64_t secret[ STRIPES_PER_BLOCK + STRIPE_LANES ] = {
+    0xB9EE2468C9A69AEBull, 0xDD6C5FDCAE23C0B9ull, 0x03A5981E911CB64Full, 0xF2A3FEB77FF85CB7ull,
+    0x083312C13114FD76ull, 0x4F7D7B5FDF72527Full, 0x0AB3C15F9D28C0BDull, 0x12A16BDF2E6061FDull,
+    0xE7B8F95C7CCAF07Eull, 0xD8C9DB41613DF5F3ull, 0x01BEEA6D96B210A8ull, 0x19569F742BFE8F18ull,
+    0xA0129C5B40AC87F4ull, 0x42EAA8772FFD3200ull, 0x7620CBFFD1524971ull, 0xC6704E880FEB53C0ull,
+    0xD90BA623BE5D66DFull, 0x2661F60DD33118A2ull, 0x4C02F0E3A9E91476ull, 0x0573845AB262425Full,
+    0xE549244AD69ACE11ull, 0x2C3A6E796072C005ull, 0x426D57467B506059ull, 0x42E5D241598CC5E8ull,
+};
+
+typedef struct HashState {
+#if defined( __AVX2__ )
+    __m256i acc[ 2 ];
+#else
+    uint64_t acc[ STRIPE_LANES ];
+#endif
+    uint8_t stripe; // Within the current block
+    uint64_t length;
+} HashState;
+
+static void hashInitialise( HashState *state ) {
+    static const uint64_t initial[ STRIPE_LANES ] = {
+        PRIME32_3, PRIME64_1, PRIME64_2, PRIME64_3, PRIME64_4, PRIME32_2, PRIME64_5, PRIME32_1
+    };
+#if defined( __AVX2__ )
+    state->acc[ 0 ] = _mm256_loadu_si256( (const __m256i*)&initial[ 0 ] );
+    state->acc[ 1 ] = _mm256_loadu_si256( (const __m256i*)&initial[ 4 ] );
+#else
+    memcpy( state->acc, initial, sizeof( initial ) );
+#endif
+    state->stripe = 0;
+    state->length = 0;
+}
+
+#if defined( __AVX2__ )
+static inline __m256i accumulate( __m256i acc, const uint8_t *data, const uint64_t *key ) {
+    const __m256i value = _mm256_loadu_si256( (const __m256i*)data );
+    const __m256i keyed = _mm256_xor_si256( value, _mm256_loadu_si256( (const __m256i*)key ) );
+    const __m256i product = _mm256_mul_epu32( keyed, _mm256_srli_epi64( keyed, 32 ) );
+    // Each lane also takes its neighbour's input, as in XXH3
+    const __m256i swapped = _mm256_shuffle_epi32( value, _MM_SHUFFLE( 1, 0, 3, 2 ) );
+    return _mm256_add_epi64( acc, _mm256_add_epi64( product, swapped ) );
+}
+
+static inline __m256i scramble( __m256i acc, const uint64_t *key ) {
+    const __m256i prime = _mm256_set1_epi32( (int)PRIME32_1 );
+    acc = _mm256_xor_si256( acc, _mm256_srli_epi64( acc, 47 ) );
+    acc = _mm256_xor_si256( acc, _mm256_loadu_si256( (const __m256i*)key ) );
+    const __m256i low = _mm256_mul_epu32( acc, prime );
+    const __m256i high = _mm256_mul_epu32( _mm256_srli_epi64( acc, 32 ), prime );
+    return _mm256_add_epi64( low, _mm256_slli_epi64( high, 32 ) );
+}
+#endif
+
+static void hashStripe( HashState *state, const uint8_t *data ) {
+    const uint64_t *key = &secret[ state->stripe ];
+#if defined( __AVX2__ )
+    state->acc[ 0 ] = accumulate( state->acc[ 0 ], data, key );
+    state->acc[ 1 ] = accumulate( state->acc[ 1 ], data + 32, key + 4 );
+#else
+    for ( uint8_t i = 0; i < STRIPE_LANES; ++i ) {
+        uint64_t value;
+        memcpy( &value, data + i * 8, sizeof( value ) );
+        const uint64_t keyed = value ^ key[ i ];
+        state->acc[ i ^ 1 ] += value;
+        state->acc[ i ] += ( keyed & 0xFFFFFFFF ) * ( keyed >> 32 );
+    }
+#endif
+    state->length += STRIPE_SIZE;
+
+    if ( ++state->stripe == STRIPES_PER_BLOCK ) {
+        const uint64_t *scrambleKey = &secret[ STRIPES_PER_BLOCK ];
+#if defined( __AVX2__ )
+        state->acc[ 0 ] = scramble( state->acc[ 0 ], scrambleKey );
+        state->acc[ 1 ] = scramble( state->acc[ 1 ], scrambleKey + 4 );
+#else
+        for ( uint8_t i = 0; i < STRIPE_LANES; ++i ) {
+            uint64_t acc = state->acc[ i ];
+            acc ^= acc >> 47;
+            acc ^= scrambleKey[ i ];
+            state->acc[ i ] = acc * PRIME32_1;
+        }
+#endif
+        state->stripe = 0;
+    }
+}
+
+// A trailing partial stripe is zero padded, the length keeps it distinct
+static void hashBytes( HashState *state, const uint8_t *data, size_t length ) {
+    size_t offset = 0;
+    for ( ; offset + STRIPE_SIZE <= length; offset += STRIPE_SIZE ) {
+        hashStripe( state, data + offset );
+    }
+    if ( offset < length ) {
+        uint8_t tail[ STRIPE_SIZE ] = { 0 };
+        memcpy( tail, data + offset, length - offset );
+        hashStripe( state, tail );
+        state->length -= STRIPE_SIZE - ( length - offset );
+    }
+}
+
+static uint64_t multiplyFold( uint64_t a, uint64_t b ) {
+    __extension__ typedef unsigned __int128 uint128_t;
+    const uint128_t product = (uint128_t)a * b;
+    return (uint64_t)product ^ (uint64_t)( product >> 64 );
+}
+
+static uint64_t hashFinish( const HashState *state, uint64_t seed ) {
+    uint64_t acc[ STRIPE_LANES ];
+#if defined( __AVX2__ )
+    _mm256_storeu_si256( (__m256i*)&acc[ 0 ], state->acc[ 0 ] );
+    _mm256_storeu_si256( (__m256i*)&acc[ 4 ], state->acc[ 1 ] );
+#else
+    memcpy( acc, state->acc, sizeof( acc ) );
+#endif
+    uint64_t hash = state->length * PRIME64_1 ^ seed;
+    for ( uint8_t i = 0; i < STRIPE_LANES; i += 2 ) {
+        hash += multiplyFold( acc[ i ] ^ secret[ 3 + i ], acc[ i + 1 ] ^ secret[ 4 + i ] );
+    }
+    hash ^= hash >> 37;
+    hash *= 0x165667919E3779F9ull;
+    return hash ^ ( hash >> 32 );
+}
+
+uint64_t frameHash( const Framebuffer *framebuffer ) {
+    const size_t lineBytes = (size_t)framebuffer->width * framebufferBytesPerPixel( framebuffer->format );
+    HashState state;
+    hashInitialise( &state );
+    for ( uint16_t y = 0; y < framebuffer->height; ++y ) {
+        hashBytes( &state, framebufferLine( framebuffer, y ), lineBytes );
+    }
+    const uint64_t seed = ( (uint64_t)framebuffer->width << 32 ) | ( (uint64_t)framebuffer->height << 16 ) | framebuffer->format;
+    return hashFinish( &state, seed );
+}
+
+#pragma region Log and golden compare
+
+typedef struct GoldenHash {
+    uint64_t frame;
+    uint64_t hash;
+} GoldenHash;
+
+static FILE *logFile;
+static GoldenHash *golden;
+static size_t numGolden;
+static size_t nextGolden;
+static bool comparing;
+static bool failed;
+static uint64_t framesMatched;
+
+static bool loadGolden( const char *path ) {
+    FILE *file = fopen( path, "r" );
+    if ( !file ) {
+        fprintf( stderr, "Unable to open %s\n", path );
+        return false;
+    }
+    size_t capacity = 0;
+    uint64_t frame;
+    uint64_t hash;
+    while ( fscanf( file, "%" SCNu64 " %" SCNx64, &frame, &hash ) == 2 ) {
+        if ( numGolden == capacity ) {
+            capacity = capacity ? capacity * 2 : 1024;
+            GoldenHash *grown = realloc( golden, capacity * sizeof( GoldenHash ) );
+            if ( !grown ) {
+                fclose( file );
+                return false;
+            }
+            golden = grown;
+        }
+        // Frames are presented in order, so the file must be too
+        if ( numGolden > 0 && frame <= golden[ numGolden - 1 ].frame ) {
+            fprintf( stderr, "%s: frame %" PRIu64 " is out of order\n", path, frame );
+            fclose( file );
+            return false;
+        }
+        golden[ numGolden++ ] = (GoldenHash){ frame, hash };
+    }
+    fclose( file );
+    return true;
+}
+
+bool frameHashOpen( const char *logPath, const char *goldenPath ) {
+    if ( logPath ) {
+        logFile = strcmp( logPath, "-" ) == 0 ? stdout : fopen( logPath, "w" );
+        if ( !logFile ) {
+            fprintf( stderr, "Unable to open %s\n", logPath );
+            return false;
+        }
+    }
+    if ( goldenPath ) {
+        if ( !loadGolden( goldenPath ) ) {
+            return false;
+        }
+        comparing = true;
+    }
+    // Registered before the display and renderers, so it closes after their last frame
+    atexit( frameHashClose );
+    return true;
+}
+
+bool frameHashEnabled() {
+    return logFile || comparing;
+}
+
+void frameHashPresent( const Framebuffer *framebuffer ) {
+    static uint64_t lastHash;
+    static bool hashed;
+    // An unchanged picture hashes the same as the last one
+    if ( !hashed || framebufferIsDirty( framebuffer ) ) {
+        lastHash = frameHash( framebuffer );
+        hashed = true;
+    }
+    const uint64_t frame = framebuffer->frameNumber;
+    const uint64_t hash = lastHash;
+    if ( logFile ) {
+        fprintf( logFile, "%" PRIu64 " %016" PRIx64 "\n", frame, hash );
+    }
+    if ( !comparing || failed ) {
+        return;
+    }
+
+    while ( nextGolden < numGolden && golden[ nextGolden ].frame < frame ) {
+        ++nextGolden;
+    }
+    if ( nextGolden == numGolden || golden[ nextGolden ].frame != frame ) {
+        fprintf( stderr, "Frame %" PRIu64 " has no golden hash\n", frame );
+        failed = true;
+    }
+    else if ( golden[ nextGolden ].hash != hash ) {
+        fprintf( stderr, "Frame %" PRIu64 " hash %016" PRIx64 " does not match golden %016" PRIx64 "\n",
+                 frame, hash, golden[ nextGolden ].hash );
+        failed = true;
+    }
+    else {
+        ++framesMatched;
+    }
+    if ( failed ) {
+        end_execution();
+    }
+}
+
+bool frameHashFailed() {
+    return failed;
+}
+
+void frameHashClose() {
+    if ( logFile && logFile != stdout ) {
+        fclose( logFile );
+    }
+    logFile = NULL;
+    if ( comparing && !failed ) {
+        fprintf( stderr, "%" PRIu64 " frames matched their golden hashes\n", framesMatched );
+    }
+    comparing = false;
+    free( golden );
+    golden = NULL;
+    numGolden = 0;
+}
+
+#pragma endregion
@@ -0,0 +1,63 @@
+#include "framebuffer.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+bool framebufferInitialise( Framebuffer *framebuffer, uint16_t width, uint16_t height, uint16_t maxWidth, uint16_t maxHeight,
+                            FramebufferFormat format ) {
+    memset( framebuffer, 0x00, sizeof( Framebuffer ) );
+    framebuffer->maxWidth = maxWidth;
+    framebuffer->maxHeight = maxHeight;
+    framebuffer->format = format;
+    framebuffer->dirtyLines = malloc( maxHeight * sizeof( bool ) );
+    framebuffer->pixels = calloc( maxHeight, (size_t)maxWidth * framebufferBytesPerPixel( format ) );
+    if ( !framebuffer->dirtyLines || !framebuffer->pixels ) {
+        framebufferFree( framebuffer );
+        return false;
+    }
+    // From 0x0, so every line starts dirty
+    framebufferResize( framebuffer, width, height );
+    return true;
+}
+
+void framebufferResize( Framebuffer *framebuffer, uint16_t width, uint16_t height ) {
+    if ( width != framebuffer->width || height != framebuffer->height ) {
+        memset( framebuffer->dirtyLines, true, framebuffer->maxHeight * sizeof( bool ) );
+    }
+    framebuffer->width = width;
+    framebuffer->height = height;
+    framebuffer->pitch = (uint32_t)width * framebufferBytesPerPixel( framebuffer->format );
+}
+
+void framebufferClearDirty( Framebuffer *framebuffer ) {
+    memset( framebuffer->dirtyLines, false, framebuffer->maxHeight * sizeof( bool ) );
+}
+
+bool framebufferIsDirty( const Framebuffer *framebuffer ) {
+    uint16_t first = 0;
+    uint16_t end;
+    return framebufferNextDirtyRange( framebuffer, &first, &end );
+}
+
+bool framebufferNextDirtyRange( const Framebuffer *framebuffer, uint16_t *first, uint16_t *end ) {
+    uint16_t line = *first;
+    while ( line < framebuffer->height && !framebuffer->dirtyLines[ line ] ) {
+        ++line;
+    }
+    if ( line == framebuffer->height ) {
+        return false;
+    }
+    *first = line;
+    while ( line < framebuffer->height && framebuffer->dirtyLines[ line ] ) {
+        ++line;
+    }
+    *end = line;
+    return true;
+}
+
+void framebufferFree( Framebuffer *framebuffer ) {
+    free( framebuffer->pixels );
+    free( framebuffer->dirtyLines );
+    framebuffer->pixels = NULL;
+    framebuffer->dirtyLines = NULL;
+}
@@ -1,18 +1,133 @@
 #include "cartridge.h"
+#include "display.h"
+#include "frame_hash.h"
+#include "ppu.h"
+#include "region.h"
 #include "system.h"
 
-int main() {
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+static void usage( const char *program ) {
+    fprintf( stderr, "Usage: %s [-d window|ppm|png|y4m|none] [-o output or window scale] [-t | -j workers]\n"
+                     "          [-s interval|auto|last] [-n frames] [-H hash log] [-g golden hashes]\n"
+                     "          [-r ntsc|pal] [rom]\n"
+                     "  -o  ppm and png write one file per frame given a pattern like frame%%05d.png,\n"
+                     "      otherwise ppm, png and y4m stream every frame to the path, - for stdout\n"
+                     "  -t  render on a separate thread\n"
+                     "  -j  render each frame in bands across this many threads\n"
+                     "  -s  only draw every interval-th frame, skip frames when behind real time,\n"
+                     "      or only draw the last frame of a run limited with -n\n"
+                     "  -n  stop after this many frames\n"
+                     "  -H  write a hash of every presented frame to a file, - for stdout\n"
+                     "  -g  compare frame hashes against a -H log, stopping at the first mismatch\n"
+                     "  -r  override the region given by the cartridge header\n", program );
+}
+
+int main( int argc, char **argv ) {
+
+    const char *displayName = "window";
+    const char *displayTarget = NULL;
+    const char *frameSkip = NULL;
+    uint64_t frameLimit = 0;
+    const char *hashLog = NULL;
+    const char *goldenHashes = NULL;
+    const char *regionName = NULL;
+
+    int option;
+    while ( ( option = getopt( argc, argv, "d:o:tj:s:n:H:g:r:" ) ) != -1 ) {
+        switch ( option ) {
+            case 'd':
+                displayName = optarg;
+                break;
+            case 'o':
+                displayTarget = optarg;
+                break;
+            case 't':
+                ppuUseRenderThread( true );
+                break;
+            case 'j': {
+                const int workers = atoi( optarg );
+                if ( workers < 1 || workers > 255 ) {
+                    usage( argv[ 0 ] );
+                    return 1;
+                }
+                ppuUseRenderWorkers( (uint8_t)workers );
+                break;
+            }
+            case 's':
+                frameSkip = optarg;
+                break;
+            case 'n':
+                frameLimit = strtoull( optarg, NULL, 10 );
+                break;
+            case 'H':
+                hashLog = optarg;
+                break;
+            case 'g':
+                goldenHashes = optarg;
+                break;
+            case 'r':
+                regionName = optarg;
+                break;
+            default:
+                usage( argv[ 0 ] );
+                return 1;
+        }
+    }
+
+    ppuSetFrameLimit( frameLimit );
+    if ( frameSkip == NULL ) {
+        ppuSetFrameSkip( PPU_FRAME_SKIP_NONE, 1 );
+    }
+    else if ( strcmp( frameSkip, "auto" ) == 0 ) {
+        ppuSetFrameSkip( PPU_FRAME_SKIP_ADAPTIVE, 1 );
+    }
+    else if ( strcmp( frameSkip, "last" ) == 0 && frameLimit > 0 ) {
+        ppuSetFrameSkip( PPU_FRAME_SKIP_ON_DEMAND, 1 );
+        ppuRequestFrame( frameLimit - 1 );
+    }
+    else if ( atoi( frameSkip ) > 0 ) {
+        ppuSetFrameSkip( PPU_FRAME_SKIP_INTERVAL, (uint32_t)atoi( frameSkip ) );
+    }
+    else {
+        usage( argv[ 0 ] );
+        return 1;
+    }
+
+    if ( regionName && strcmp( regionName, "ntsc" ) != 0 && strcmp( regionName, "pal" ) != 0 ) {
+        usage( argv[ 0 ] );
+        return 1;
+    }
+
+    const char* romPath = optind < argc ? argv[ optind ] : "smk.sfc";
+    if ( !displaySelect( displayName, displayTarget ) ) {
+        usage( argv[ 0 ] );
+        return 1;
+    }
+
+    if ( ( hashLog || goldenHashes ) && !frameHashOpen( hashLog, goldenHashes ) ) {
+        return 1;
+    }
 
-    const char* romPath = "smk.sfc";
     if ( cartridgeLoadRom( romPath ) ) {
         return 1;
     }
-    
+    if ( regionName ) {
+        regionSelect( strcmp( regionName, "pal" ) == 0 ? REGION_PAL : REGION_NTSC );
+    }
+    else {
+        regionSelect( cartridgeRegion() );
+    }
+
     if ( startup() ){
         return 1;
     }
 
     begin_execution();
+    ppuFinish();
 
-    return 0;
-}
\ No newline at end of file
+    return frameHashFailed() ? 1 : 0;
+}
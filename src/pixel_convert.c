@@ -0,0 +1,128 @@
+#include "pixel_convert.h"
+
+#include "framebuffer.h"
+
+#include <string.h>
+
+#if defined( __AVX2__ ) || defined( __SSE2__ )
+#include <immintrin.h>
+#endif
+
+#if defined( __AVX2__ )
+// 8 BGR555 pixels, zero extended to 32 bits, to XRGB8888
+static inline __m256i expandBGR555( __m256i colours ) {
+    const __m256i channelMask = _mm256_set1_epi32( 0x1F );
+    __m256i r = _mm256_and_si256( colours, channelMask );
+    __m256i g = _mm256_and_si256( _mm256_srli_epi32( colours, 5 ), channelMask );
+    __m256i b = _mm256_and_si256( _mm256_srli_epi32( colours, 10 ), channelMask );
+    r = _mm256_or_si256( _mm256_slli_epi32( r, 3 ), _mm256_srli_epi32( r, 2 ) );
+    g = _mm256_or_si256( _mm256_slli_epi32( g, 3 ), _mm256_srli_epi32( g, 2 ) );
+    b = _mm256_or_si256( _mm256_slli_epi32( b, 3 ), _mm256_srli_epi32( b, 2 ) );
+    return _mm256_or_si256( _mm256_or_si256( _mm256_slli_epi32( r, 16 ), _mm256_slli_epi32( g, 8 ) ), b );
+}
+#elif defined( __SSE2__ )
+// 4 BGR555 pixels, zero extended to 32 bits, to XRGB8888
+static inline __m128i expandBGR555( __m128i colours ) {
+    const __m128i channelMask = _mm_set1_epi32( 0x1F );
+    __m128i r = _mm_and_si128( colours, channelMask );
+    __m128i g = _mm_and_si128( _mm_srli_epi32( colours, 5 ), channelMask );
+    __m128i b = _mm_and_si128( _mm_srli_epi32( colours, 10 ), channelMask );
+    r = _mm_or_si128( _mm_slli_epi32( r, 3 ), _mm_srli_epi32( r, 2 ) );
+    g = _mm_or_si128( _mm_slli_epi32( g, 3 ), _mm_srli_epi32( g, 2 ) );
+    b = _mm_or_si128( _mm_slli_epi32( b, 3 ), _mm_srli_epi32( b, 2 ) );
+    return _mm_or_si128( _mm_or_si128( _mm_slli_epi32( r, 16 ), _mm_slli_epi32( g, 8 ) ), b );
+}
+#endif
+
+void convertBGR555ToXRGB8888( const uint16_t *source, uint32_t *destination, uint32_t width ) {
+    uint32_t x = 0;
+#if defined( __AVX2__ )
+    for ( ; x + 16 <= width; x += 16 ) {
+        const __m256i colours = _mm256_loadu_si256( (const __m256i*)&source[ x ] );
+        const __m256i low = _mm256_cvtepu16_epi32( _mm256_castsi256_si128( colours ) );
+        const __m256i high = _mm256_cvtepu16_epi32( _mm256_extracti128_si256( colours, 1 ) );
+        _mm256_storeu_si256( (__m256i*)&destination[ x ], expandBGR555( low ) );
+        _mm256_storeu_si256( (__m256i*)&destination[ x + 8 ], expandBGR555( high ) );
+    }
+#elif defined( __SSE2__ )
+    const __m128i zero = _mm_setzero_si128();
+    for ( ; x + 8 <= width; x += 8 ) {
+        const __m128i colours = _mm_loadu_si128( (const __m128i*)&source[ x ] );
+        _mm_storeu_si128( (__m128i*)&destination[ x ], expandBGR555( _mm_unpacklo_epi16( colours, zero ) ) );
+        _mm_storeu_si128( (__m128i*)&destination[ x + 4 ], expandBGR555( _mm_unpackhi_epi16( colours, zero ) ) );
+    }
+#endif
+    for ( ; x < width; ++x ) {
+        destination[ x ] = bgr555ToXRGB8888( source[ x ] );
+    }
+}
+
+void scaleLineXRGB8888( const uint32_t *source, uint32_t *destination, uint32_t width, uint8_t scale ) {
+    if ( scale == 1 ) {
+        memcpy( destination, source, width * sizeof( uint32_t ) );
+        return;
+    }
+
+    const uint32_t scaledWidth = width * scale;
+    uint32_t x = 0;
+#if defined( __AVX2__ )
+    // Each 8 pixel output block gathers from at most 8 consecutive source
+    // pixels, and the gather pattern only depends on where the block starts
+    // relative to a multiple of scale.
+    if ( scale <= PIXEL_SCALE_MAX ) {
+        __m256i patterns[ PIXEL_SCALE_MAX ];
+        for ( uint8_t start = 0; start < scale; ++start ) {
+            uint32_t indices[ 8 ];
+            for ( uint8_t i = 0; i < 8; ++i ) {
+                indices[ i ] = ( start + i ) / scale;
+            }
+            patterns[ start ] = _mm256_loadu_si256( (const __m256i*)indices );
+        }
+        for ( ; x + 8 <= scaledWidth; x += 8 ) {
+            const __m256i pixels = _mm256_loadu_si256( (const __m256i*)&source[ x / scale ] );
+            _mm256_storeu_si256( (__m256i*)&destination[ x ], _mm256_permutevar8x32_epi32( pixels, patterns[ x % scale ] ) );
+        }
+    }
+#elif defined( __SSE2__ )
+    if ( scale == 2 ) {
+        for ( ; x + 8 <= scaledWidth; x += 8 ) {
+            const __m128i pixels = _mm_loadu_si128( (const __m128i*)&source[ x / 2 ] );
+            _mm_storeu_si128( (__m128i*)&destination[ x ], _mm_unpacklo_epi32( pixels, pixels ) );
+            _mm_storeu_si128( (__m128i*)&destination[ x + 4 ], _mm_unpackhi_epi32( pixels, pixels ) );
+        }
+    }
+#endif
+    for ( ; x < scaledWidth; ++x ) {
+        destination[ x ] = source[ x / scale ];
+    }
+}
+
+void doubleLineBGR555( const uint16_t *source, uint16_t *destination, uint32_t width ) {
+    interleaveLinesBGR555( source, source, destination, width );
+}
+
+void interleaveLinesBGR555( const uint16_t *even, const uint16_t *odd, uint16_t *destination, uint32_t width ) {
+    uint32_t x = 0;
+#if defined( __AVX2__ )
+    for ( ; x + 16 <= width; x += 16 ) {
+        // Unpacking works within 128-bit lanes, so put the halves back in order afterwards
+        const __m256i evenPixels = _mm256_loadu_si256( (const __m256i*)&even[ x ] );
+        const __m256i oddPixels = _mm256_loadu_si256( (const __m256i*)&odd[ x ] );
+        const __m256i low = _mm256_unpacklo_epi16( evenPixels, oddPixels );
+        const __m256i high = _mm256_unpackhi_epi16( evenPixels, oddPixels );
+        _mm256_storeu_si256( (__m256i*)&destination[ x * 2 ], _mm256_permute2x128_si256( low, high, 0x20 ) );
+        _mm256_storeu_si256( (__m256i*)&destination[ x * 2 + 16 ], _mm256_permute2x128_si256( low, high, 0x31 ) );
+    }
+#elif defined( __SSE2__ )
+    for ( ; x + 8 <= width; x += 8 ) {
+        const __m128i evenPixels = _mm_loadu_si128( (const __m128i*)&even[ x ] );
+        const __m128i oddPixels = _mm_loadu_si128( (const __m128i*)&odd[ x ] );
+        _mm_storeu_si128( (__m128i*)&destination[ x * 2 ], _mm_unpacklo_epi16( evenPixels, oddPixels ) );
+        _mm_storeu_si128( (__m128i*)&destination[ x * 2 + 8 ], _mm_unpackhi_epi16( evenPixels, oddPixels ) );
+    }
+#endif
+    for ( ; x < width; ++x ) {
+        destination[ x * 2 ] = even[ x ];
+        destination[ x * 2 + 1 ] = odd[ x ];
+    }
+}
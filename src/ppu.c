@@ -1,97 +1,30 @@
 #include "ppu.h"
 
 #include "cpu.h"
-#include "gfx.h" // Temp library while testing
+#include "display.h"
+#include "framebuffer.h"
+#include "ppu_internal.h"
+#include "region.h"
+#include "system.h"
 
 #include <assert.h>
 #include <memory.h>
 #include <stdio.h>
+#include <time.h>
 
-// Just PAL for now, NTSC later
-
-typedef struct Ports {
-    // Write-only region
-    uint8_t INIDISP; // 2100h - Display Control 1                                  8xh
-    uint8_t OBSEL; // 2101h   - Object Size and Object Base                        (?)
-    uint8_t OAMADDL; // 2102h - OAM Address (lower 8bit)                           (?)
-    uint8_t OAMADDH; // 2103h - OAM Address (upper 1bit) and Priority Rotation     (?)
-    uint8_t OAMDATA; // 2104h - OAM Data Write (write-twice)                       (?)
-    uint8_t BGMODE; // 2105h  - BG Mode and BG Character Size                      (xFh)
-    uint8_t MOSAIC; // 2106h  - Mosaic Size and Mosaic Enable                      (?)
-    uint8_t BG1SC; // 2107h   - BG1 Screen Base and Screen Size                    (?)
-    uint8_t BG2SC; // 2108h   - BG2 Screen Base and Screen Size                    (?)
-    uint8_t BG3SC; // 2109h   - BG3 Screen Base and Screen Size                    (?)
-    uint8_t BG4SC; // 210Ah   - BG4 Screen Base and Screen Size                    (?)
-    uint8_t BG12NBA; // 210Bh - BG Character Data Area Designation                 (?)
-    uint8_t BG34NBA; // 210Ch - BG Character Data Area Designation                 (?)
-    uint8_t BG1HOFS; // 210Dh - BG1 Horizontal Scroll (X) (write-twice) / M7HOFS   (?,?)
-    uint8_t BG1VOFS; // 210Eh - BG1 Vertical Scroll (Y)   (write-twice) / M7VOFS   (?,?)
-    uint8_t BG2HOFS; // 210Fh - BG2 Horizontal Scroll (X) (write-twice)            (?,?)
-    uint8_t BG2VOFS; // 2110h - BG2 Vertical Scroll (Y)   (write-twice)            (?,?)
-    uint8_t BG3HOFS; // 2111h - BG3 Horizontal Scroll (X) (write-twice)            (?,?)
-    uint8_t BG3VOFS; // 2112h - BG3 Vertical Scroll (Y)   (write-twice)            (?,?)
-    uint8_t BG4HOFS; // 2113h - BG4 Horizontal Scroll (X) (write-twice)            (?,?)
-    uint8_t BG4VOFS; // 2114h - BG4 Vertical Scroll (Y)   (write-twice)            (?,?)
-    uint8_t VMAIN; // 2115h   - VRAM Address Increment Mode                        (?Fh)
-    uint8_t VMADDL; // 2116h  - VRAM Address (lower 8bit)                          (?)
-    uint8_t VMADDH; // 2117h  - VRAM Address (upper 8bit)                          (?)
-    uint8_t VMDATAL; // 2118h - VRAM Data Write (lower 8bit)                       (?)
-    uint8_t VMDATAH; // 2119h - VRAM Data Write (upper 8bit)                       (?)
-    uint8_t M7SEL; // 211Ah   - Rotation/Scaling Mode Settings                     (?)
-    uint8_t M7A; // 211Bh     - Rotation/Scaling Parameter A & Maths 16bit operand(FFh)(w2)
-    uint8_t M7B; // 211Ch     - Rotation/Scaling Parameter B & Maths 8bit operand (FFh)(w2)
-    uint8_t M7C; // 211Dh     - Rotation/Scaling Parameter C         (write-twice) (?)
-    uint8_t M7D; // 211Eh     - Rotation/Scaling Parameter D         (write-twice) (?)
-    uint8_t M7X; // 211Fh     - Rotation/Scaling Center Coordinate X (write-twice) (?)
-    uint8_t M7Y; // 2120h     - Rotation/Scaling Center Coordinate Y (write-twice) (?)
-    uint8_t CGADD; // 2121h   - Palette CGRAM Address                              (?)
-    uint8_t CGDATA; // 2122h  - Palette CGRAM Data Write             (write-twice) (?)
-    uint8_t W12SEL; // 2123h  - Window BG1/BG2 Mask Settings                       (?)
-    uint8_t W34SEL; // 2124h  - Window BG3/BG4 Mask Settings                       (?)
-    uint8_t WOBJSEL; // 2125h - Window OBJ/MATH Mask Settings                      (?)
-    uint8_t WH0; // 2126h     - Window 1 Left Position (X1)                        (?)
-    uint8_t WH1; // 2127h     - Window 1 Right Position (X2)                       (?)
-    uint8_t WH2; // 2128h     - Window 2 Left Position (X1)                        (?)
-    uint8_t WH3; // 2129h     - Window 2 Right Position (X2)                       (?)
-    uint8_t WBGLOG; // 212Ah  - Window 1/2 Mask Logic (BG1-BG4)                    (?)
-    uint8_t WOBJLOG; // 212Bh - Window 1/2 Mask Logic (OBJ/MATH)                   (?)
-    uint8_t TM; // 212Ch      - Main Screen Designation                            (?)
-    uint8_t TS; // 212Dh      - Sub Screen Designation                             (?)
-    uint8_t TMW; // 212Eh     - Window Area Main Screen Disable                    (?)
-    uint8_t TSW; // 212Fh     - Window Area Sub Screen Disable                     (?)
-    uint8_t CGWSEL; // 2130h  - Color Math Control Register A                      (?)
-    uint8_t CGADSUB; // 2131h - Color Math Control Register B                      (?)
-    uint8_t COLDATA; // 2132h - Color Math Sub Screen Backdrop Color               (?)
-    uint8_t SETINI; // 2133h  - Display Control 2                                  00h?
-
-    // Read-only region
-    uint8_t MPYL; // 2134h    - PPU1 Signed Multiply Result   (lower 8bit)         (01h)
-    uint8_t MPYM; // 2135h    - PPU1 Signed Multiply Result   (middle 8bit)        (00h)
-    uint8_t MPYH; // 2136h    - PPU1 Signed Multiply Result   (upper 8bit)         (00h)
-    uint8_t SLHV; // 2137h    - PPU1 Latch H/V-Counter by Software (Read=Strobe)
-    uint8_t RDOAM; // 2138h   - PPU1 OAM Data Read            (read-twice)
-    uint8_t RDVRAML; // 2139h - PPU1 VRAM Data Read           (lower 8bits)
-    uint8_t RDVRAMH; // 213Ah - PPU1 VRAM Data Read           (upper 8bits)
-    uint8_t RDCGRAM; // 213Bh - PPU2 CGRAM Data Read (Palette)(read-twice)
-    uint8_t OPHCT; // 213Ch   - PPU2 Horizontal Counter Latch (read-twice)         (01FFh)
-    uint8_t OPVCT; // 213Dh   - PPU2 Vertical Counter Latch   (read-twice)         (01FFh)
-    uint8_t STAT77; // 213Eh  - PPU1 Status and PPU1 Version Number
-    uint8_t STAT78; // 213Fh  - PPU2 Status and PPU2 Version Number                Bit7=0
-} Ports;
-
-static uint8_t VRAM[ 0x8000 ]; // 32KB
-static uint8_t CGRAM[ 0x200 ]; // 512B
-static uint8_t OAMRAM[ 0x200 + 0x20 ]; // 512B + 32B
+static uint8_t VRAM[ VRAM_SIZE ];
+static uint8_t CGRAM[ CGRAM_SIZE ];
+static uint8_t OAMRAM[ OAMRAM_SIZE ];
 
+// Line and frame boundaries come from region.h, see PPU_TICK
 #define H_BLANK_BOUNDARY 256
-#define H_MAX 340
-#define V_BLANK_BOUNDARY 240
-#define V_MAX 312
 
 typedef struct PPUState {
     uint16_t vCount;
     uint16_t hCount;
     uint8_t countDiv;
+    uint16_t lineCycles;
+    uint16_t vBlankLine; // Picked at V_BLANK_LINE from the SETINI overscan bit
     bool hBlank;
     bool vBlank;
     bool fBlank;
@@ -102,191 +35,461 @@ typedef struct PPUState {
     bool oamramSecondAccess;
     uint8_t oamramLsbLatch;
     uint16_t oamramAddress;
+
+    uint8_t bgScrollLatch;
+    uint8_t m7Latch;
 } PPUState;
 
 static Ports ports;
+static PPURenderRegisters renderRegisters;
+static PPUTileCache tileCache;
+static PPUPalette palette;
+static PPUSpriteTable spriteTable;
 static PPUState ppuState;
 
-void ppuInitialise() {
+static Framebuffer framebuffer;
+static PPUOutput frameOutput;
+static uint16_t lineBuffer[ HIRES_WIDTH ];
+
+// With a render thread, writes are logged for it instead of rendering inline
+static bool useRenderThread;
+static PPURenderRegisters loggedRegisters;
+
+void ppuUseRenderThread( bool enabled ) {
+    useRenderThread = enabled;
+}
+
+// With render workers, lines are snapshotted and rendered in bands when the
+// frame ends, or earlier if VRAM or other shared state is about to change
+static uint8_t renderWorkers = 1;
+static PPULineSnapshot lineSnapshots[ SCREEN_HEIGHT ];
+static uint16_t firstPendingLine;
+static uint16_t numPendingLines;
+
+void ppuUseRenderWorkers( uint8_t numWorkers ) {
+    renderWorkers = numWorkers;
+}
+
+// Adaptive skipping still draws one frame in this many, and forgets any
+// deficit larger than MAX_ADAPTIVE_LAG frames rather than trying to catch up
+#define MAX_ADAPTIVE_SKIP 4
+#define MAX_ADAPTIVE_LAG 10
+
+static PPUFrameSkip frameSkip = PPU_FRAME_SKIP_NONE;
+static uint32_t frameSkipInterval = 1;
+static uint64_t requestedFrame = UINT64_MAX;
+static uint64_t frameLimit;
+static uint64_t frameNumber;
+static bool drawFrame = true; // Whether the current frame's lines are drawn
+static int64_t adaptiveStart; // Host time emulated frame 0 is due
+static int64_t frameNanoseconds; // Of the selected region
+static uint8_t adaptiveSkips;
+
+void ppuSetFrameSkip( PPUFrameSkip mode, uint32_t interval ) {
+    frameSkip = mode;
+    frameSkipInterval = interval > 0 ? interval : 1;
+}
+
+void ppuRequestFrame( uint64_t frame ) {
+    requestedFrame = frame;
+}
+
+void ppuSetFrameLimit( uint64_t frames ) {
+    frameLimit = frames;
+}
+
+uint64_t ppuFrameNumber() {
+    return frameNumber;
+}
+
+static int64_t hostNanoseconds() {
+    struct timespec now;
+    clock_gettime( CLOCK_MONOTONIC, &now );
+    return (int64_t)now.tv_sec * 1000000000ll + now.tv_nsec;
+}
+
+static bool adaptiveDrawFrame() {
+    const int64_t lag = hostNanoseconds() - ( adaptiveStart + (int64_t)frameNumber * frameNanoseconds );
+    if ( lag > MAX_ADAPTIVE_LAG * frameNanoseconds ) {
+        adaptiveStart += lag - frameNanoseconds;
+    }
+    if ( lag > frameNanoseconds && adaptiveSkips < MAX_ADAPTIVE_SKIP ) {
+        ++adaptiveSkips;
+        return false;
+    }
+    adaptiveSkips = 0;
+    return true;
+}
+
+static bool shouldDrawFrame() {
+    switch ( frameSkip ) {
+        case PPU_FRAME_SKIP_NONE:
+            return true;
+        case PPU_FRAME_SKIP_INTERVAL:
+            return frameNumber % frameSkipInterval == 0;
+        case PPU_FRAME_SKIP_ON_DEMAND:
+            return frameNumber == requestedFrame;
+        case PPU_FRAME_SKIP_ADAPTIVE:
+            return adaptiveDrawFrame();
+    }
+    return true;
+}
+
+int ppuInitialise() {
     memset( &ports, 0x00, sizeof( Ports ) );
+    memset( &renderRegisters, 0x00, sizeof( PPURenderRegisters ) );
     memset( &ppuState, 0x00, sizeof( PPUState ) );
+    ppuState.vBlankLine = V_BLANK_LINE;
     ports.INIDISP = 0x80;
+    if ( regionCurrent() == REGION_PAL ) {
+        ports.STAT78 |= 0x10;
+    }
+
+    ppuKernelsInitialise();
+    ppuRenderInitialise();
+    ppuTileCacheInitialise( &tileCache );
+    ppuSpriteTableInitialise( &spriteTable, OAMRAM, ports.OBSEL );
+
+    if ( !framebufferInitialise( &framebuffer, SCREEN_WIDTH, SCREEN_HEIGHT, HIRES_WIDTH, INTERLACE_HEIGHT, displayPreferredFormat() ) ) {
+        printf( "Unable to allocate the framebuffer\n" );
+        return 1;
+    }
+    ppuPaletteInitialise( &palette, framebuffer.format, ports.INIDISP & 0x0F );
+    ppuOutputInitialise( &frameOutput, &framebuffer, &palette );
+    if ( !displayOpen( &framebuffer ) ) {
+        return 1;
+    }
+    frameNanoseconds = regionFrameNanoseconds( regionTiming() );
+    adaptiveStart = hostNanoseconds();
+    drawFrame = shouldDrawFrame();
+    if ( useRenderThread ) {
+        loggedRegisters = renderRegisters;
+        if ( !ppuRenderThreadStart( &framebuffer, &ports, &renderRegisters, VRAM, CGRAM, OAMRAM ) ) {
+            return 1;
+        }
+    }
+    else if ( renderWorkers > 1 && !ppuBandsStart( renderWorkers ) ) {
+        return 1;
+    }
+    return 0;
+}
+
+void ppuFinish() {
+    if ( useRenderThread ) {
+        ppuRenderThreadStop();
+    }
+}
+
+static void flushPendingLines() {
+    if ( numPendingLines > 0 ) {
+        ports.STAT77 |= ppuBandsRender( lineSnapshots, firstPendingLine, numPendingLines, frameNumber & 1, VRAM,
+                                        &spriteTable, &tileCache, &frameOutput );
+        firstPendingLine += numPendingLines;
+        numPendingLines = 0;
+    }
+}
+
+// Pending lines must be rendered before VRAM, OAM, OBSEL or brightness change under them
+static inline void beforeSharedWrite() {
+    if ( numPendingLines > 0 ) {
+        flushPendingLines();
+    }
+}
+
+static inline void logWrite( PPULogKind kind, uint16_t address, uint16_t value ) {
+    if ( useRenderThread ) {
+        ppuRenderThreadLog( kind, address, value, (uint32_t)ppuState.vCount * regionTiming()->dotsPerLine + ppuState.hCount );
+    }
+}
 
-    // Set up temp gfx lib
-    gfx_open( H_BLANK_BOUNDARY, V_BLANK_BOUNDARY, "SNESmulator" );
+// Render registers are all 16-bit, log whichever words a port write changed
+static void logRegisters() {
+    const uint16_t *current = (const uint16_t*)&renderRegisters;
+    uint16_t *logged = (uint16_t*)&loggedRegisters;
+    for ( uint16_t i = 0; i < sizeof( PPURenderRegisters ) / sizeof( uint16_t ); ++i ) {
+        if ( current[ i ] != logged[ i ] ) {
+            logged[ i ] = current[ i ];
+            logWrite( PPU_LOG_REGISTER, i, current[ i ] );
+        }
+    }
 }
 
-static inline void vInc() {
+static inline void vInc( const uint16_t linesPerFrame ) {
     ++ppuState.vCount;
-    if ( ppuState.vCount == V_BLANK_BOUNDARY ) {
+    if ( ppuState.vCount == V_BLANK_LINE ) {
+        ppuState.vBlankLine = ( ports.SETINI & 0x04 ) ? OVERSCAN_V_BLANK_LINE : V_BLANK_LINE;
+    }
+    if ( ppuState.vCount == ppuState.vBlankLine ) {
+        if ( useRenderThread ) {
+            logWrite( PPU_LOG_FRAME, 0, drawFrame );
+        }
+        else if ( drawFrame ) {
+            flushPendingLines();
+            firstPendingLine = 0;
+            framebuffer.frameNumber = frameNumber;
+            displayPresent( &framebuffer );
+            ++framebuffer.frameCount;
+            ppuOutputEndFrame( &frameOutput );
+        }
+        ++frameNumber;
+        if ( frameNumber == frameLimit ) {
+            end_execution();
+        }
+        drawFrame = shouldDrawFrame();
         vBlank( true );
     }
-    else if ( ppuState.vCount == V_MAX ) {
+    else if ( ppuState.vCount == linesPerFrame ) {
         ppuState.vCount = 0;
+        ppuState.vBlankLine = V_BLANK_LINE;
+        ports.STAT77 &= ~( STAT77_TIME_OVER | STAT77_RANGE_OVER );
+        logWrite( PPU_LOG_CLEAR_STAT77, 0, 0 );
         vBlank( false );
     }
 }
 
+static void renderLine() {
+    const uint8_t field = frameNumber & 1;
+    const PPURenderContext context = {
+        &ports, &renderRegisters, VRAM, CGRAM, palette.colours, OAMRAM, &spriteTable, &tileCache, field
+    };
+
+    const bool hiRes = ppuLineIsHiRes( &ports );
+    ppuOutputPrepareLine( &frameOutput, ppuState.vCount, hiRes, ppuLineIsInterlaced( &ports ) );
+    ports.STAT77 |= ppuRenderScanline( &context, ppuState.vCount, lineBuffer );
+    ppuOutputLine( &frameOutput, lineBuffer, hiRes, ppuState.vCount, field );
+}
+
+// Skipped frames only need the sprite overflow flags, and only until both are raised
+static void skipLine() {
+    if ( useRenderThread ) {
+        logWrite( PPU_LOG_SKIP_LINE, ppuState.vCount, 0 );
+    }
+    else if ( ( ports.STAT77 & ( STAT77_TIME_OVER | STAT77_RANGE_OVER ) ) != ( STAT77_TIME_OVER | STAT77_RANGE_OVER ) ) {
+        const PPURenderContext context = {
+            &ports, &renderRegisters, VRAM, CGRAM, palette.colours, OAMRAM, &spriteTable, &tileCache, frameNumber & 1
+        };
+        ports.STAT77 |= ppuEvaluateSpriteFlags( &context, ppuState.vCount );
+    }
+}
+
+static void snapshotLine() {
+    PPULineSnapshot *snapshot = &lineSnapshots[ ppuState.vCount ];
+    snapshot->ports = ports;
+    snapshot->registers = renderRegisters;
+    memcpy( snapshot->palette, palette.colours, sizeof( snapshot->palette ) );
+    ++numPendingLines;
+}
+
 static inline void hInc() {
     ++ppuState.hCount;
     if ( ppuState.hCount == H_BLANK_BOUNDARY ) {
+        if ( ppuState.vCount < ppuState.vBlankLine ) {
+            if ( !drawFrame ) {
+                skipLine();
+            }
+            else if ( useRenderThread ) {
+                logWrite( PPU_LOG_LINE, ppuState.vCount, 0 );
+            }
+            else if ( renderWorkers > 1 ) {
+                snapshotLine();
+            }
+            else {
+                renderLine();
+            }
+        }
         hBlank( true );
     }
-    else if ( ppuState.hCount == H_MAX ) {
-        ppuState.hCount = 0;
-        hBlank( false );
-        vInc();
-    }
-    else if ( ppuState.hCount < H_BLANK_BOUNDARY && ppuState.vCount < V_BLANK_BOUNDARY ) {
-        // Draw a pixel
-        uint16_t xPos = ppuState.hCount;
-        uint16_t yPos = ppuState.vCount;
-        gfx_color( 0, 0, 0 );
-        if ( ports.INIDISP & 0x80 ) {
-            // F-blank
-            gfx_point( xPos, yPos );
-            return;
-        }
-
-        uint8_t brightness = ports.INIDISP & 0x0F;
-
-        uint8_t bgScreenMode = ports.BGMODE & 0x7;
-        bool bgPriorityMode = ports.BGMODE & ( 1 << 3 );
-        bool bg1_16x16 = ports.BGMODE & ( 1 << 4 );
-        bool bg2_16x16 = ports.BGMODE & ( 1 << 5 );
-        bool bg3_16x16 = ports.BGMODE & ( 1 << 6 );
-        bool bg4_16x16 = ports.BGMODE & ( 1 << 7 );
-
-        // TODO - BG colour modes
-
-        uint8_t mosaicSize = ( ports.BGMODE >> 4 ) & 0x0F;
-        bool bg1_mosaic = ports.BGMODE & ( 1 < 0 );
-        bool bg2_mosaic = ports.BGMODE & ( 1 < 1 );
-        bool bg3_mosaic = ports.BGMODE & ( 1 < 2 );
-        bool bg4_mosaic = ports.BGMODE & ( 1 < 3 );
-
-        uint8_t bg1BaseAddr = ( ports.BG1SC >> 2 ) & 0x3F;
-        uint8_t bg1Size = ports.BG1SC & 0x3;
-        uint8_t bg2BaseAddr = ( ports.BG2SC >> 2 ) & 0x3F;
-        uint8_t bg2Size = ports.BG2SC & 0x3;
-        uint8_t bg3BaseAddr = ( ports.BG3SC >> 2 ) & 0x3F;
-        uint8_t bg3Size = ports.BG3SC & 0x3;
-
-        uint8_t bg1TileBaseAddr = ports.BG12NBA & 0x0F;
-        uint8_t bg2TileBaseAddr = ( ports.BG12NBA >> 4 ) & 0x0F;
-        uint8_t bg3TileBaseAddr = ports.BG34NBA & 0x0F;
-        uint8_t bg4TileBaseAddr = ( ports.BG34NBA >> 4 ) & 0x0F;
-
-        uint8_t objSizeSel = ( ports.OBSEL >> 5 ) & 0x07;
-        uint8_t objGap = ( ports.OBSEL >> 3 ) & 0x03;
-        uint16_t objBaseAddr = ( ( ports.OBSEL & 0x07 ) * 2 * 0x4000 ) & 0x7FFF;
-
-        for ( uint8_t objID = 0; objID < 128; ++objID ) {
-            uint16_t objRamIdx = objID * 4 * sizeof( uint8_t );
-            uint16_t objXCoord = (uint16_t) OAMRAM[ objRamIdx++ ];
-            uint8_t objYCoord = OAMRAM[ objRamIdx++ ];
-            uint16_t objTileNumber = OAMRAM[ objRamIdx++ ];
-            uint8_t objAttrs = OAMRAM[ objRamIdx ];
-
-            objTileNumber |= ( (uint16_t)objAttrs & 0x01 ) << 8;
-            uint8_t paletteId = 8 + ( ( objAttrs >> 1 ) & 0x07 );
-            uint8_t priority = ( objAttrs >> 4 ) & 0x03;
-            bool xFlip = objAttrs & ( 1 << 6 );
-            bool yFlip = objAttrs & ( 1 << 7 );
-
-            uint8_t objAdditionalByte = OAMRAM[ 512 + ( objID / 4 ) ];
-            uint8_t objAdditionalData = ( objAdditionalByte >> ( ( objID % 4 ) * 2 ) ) & 0x03 ;
-            bool largeObj = objAdditionalData & 0x02;
-            objXCoord |= ( (uint16_t)objAdditionalData & 0x01 ) << 8;
-
-            // TODO - just assume size 0-large for now
-            uint8_t objXDim = 16;
-            uint8_t objYDim = 16;
-
-            // TODO - sign conversion stuff
-            int16_t relXPos = (int16_t)xPos - (int16_t)objXCoord;
-            int16_t relYPos = (int16_t)yPos - (int16_t)objYCoord;
-
-            // TODO - temp objID limitation
-            if ( relXPos >= 0 && relXPos < objXDim 
-                && relYPos >= 0 && relYPos < objYDim
-                && objID < 4 ) {
-                
-                static const size_t objTileSize = 32; // 8x8 pixels, 4 bits per pixel
-                uint16_t tileRowOffset = ( relYPos / 8 ) * 0x0010;
-                uint16_t tileColOffset = ( relXPos / 8 ) * 0x0001;
-                objTileNumber += tileRowOffset;
-                objTileNumber += tileColOffset;
-                relYPos %= 8;
-                relXPos %= 8;
-                uint16_t baseTileOffset = objBaseAddr + ( objTileNumber * objTileSize );
-
-                uint8_t rowData[ 4 ];
-                uint16_t bitplane1_2Offset = relYPos * 2 * sizeof( uint8_t ); 
-                uint16_t bitplane3_4Offset = bitplane1_2Offset + ( 16 * sizeof( uint8_t ) );
-                
-                rowData[ 0 ] = VRAM[ baseTileOffset + bitplane1_2Offset ]; //lsb
-                rowData[ 1 ] = VRAM[ baseTileOffset + bitplane1_2Offset + 1 ]; //slsb
-                rowData[ 2 ] = VRAM[ baseTileOffset + bitplane3_4Offset ]; //smsb
-                rowData[ 3 ] = VRAM[ baseTileOffset + bitplane3_4Offset + 1 ]; //msb
-
-                uint8_t colour = 0x00;
-                for ( uint8_t shift = 0; shift < 4; ++shift ) {
-                    colour |= ( ( rowData[ shift ] >> ( 7 - relXPos ) ) & 0x01 ) << shift;
-                }
-
-                uint16_t paletteEntryOffset = ( paletteId * 16 * sizeof( uint16_t ) );
-                uint16_t paletteColourOffset = paletteEntryOffset + ( colour * sizeof( uint16_t ) );
-
-                uint16_t paletteColour = ( ( (uint16_t)CGRAM[ paletteColourOffset ] ) << 8 ) | (uint16_t)CGRAM[ paletteColourOffset ];
+}
 
-                uint8_t R = (uint8_t)paletteColour & 0x1F;
-                uint8_t G = (uint8_t)( paletteColour >> 5 ) & 0x1F;
-                uint8_t B = (uint8_t)( paletteColour >> 10 ) & 0x1F;
+static inline void endLine( const uint16_t linesPerFrame ) {
+    ppuState.hCount = 0;
+    hBlank( false );
+    vInc( linesPerFrame );
+}
 
-                gfx_color( R * 8, G * 8, B * 8 );
-            }
-        }
+// One tick function per region, so the line and frame ends compare against immediates.
+// Dots are counted out with their own lengths, the line ends on its master cycle count.
+#define PPU_TICK( REGION ) \
+    void ppuTick##REGION() { \
+        if ( ++ppuState.lineCycles == REGION##_MASTER_CYCLES_PER_LINE ) { \
+            ppuState.lineCycles = 0; \
+            ppuState.countDiv = 0; \
+            endLine( REGION##_LINES_PER_FRAME ); \
+        } \
+        else if ( ++ppuState.countDiv == regionDotCycles( ppuState.hCount ) ) { \
+            ppuState.countDiv = 0; \
+            hInc(); \
+        } \
+    }
 
-        gfx_point( xPos, yPos );
+PPU_TICK( NTSC )
+PPU_TICK( PAL )
+
+// VMADD is a word address; VMAIN bits 2-3 select the address translation used
+// for bitplane-friendly uploads.
+static inline uint32_t vramByteAddress( uint16_t wordAddress ) {
+    switch ( ( ports.VMAIN >> 2 ) & 0x03 ) {
+        case 0x01:
+            wordAddress = ( wordAddress & 0xFF00 ) | ( ( wordAddress & 0x001F ) << 3 ) | ( ( wordAddress >> 5 ) & 0x07 );
+            break;
+        case 0x02:
+            wordAddress = ( wordAddress & 0xFE00 ) | ( ( wordAddress & 0x003F ) << 3 ) | ( ( wordAddress >> 6 ) & 0x07 );
+            break;
+        case 0x03:
+            wordAddress = ( wordAddress & 0xFC00 ) | ( ( wordAddress & 0x007F ) << 3 ) | ( ( wordAddress >> 7 ) & 0x07 );
+            break;
     }
+    return ( (uint32_t)( wordAddress & 0x7FFF ) ) * 2;
 }
 
-void ppuTick() {
-    // TODO
-    if ( ++ppuState.countDiv == 4 ) {
-        ppuState.countDiv = 0;
-        hInc();
-    }
+static inline uint16_t getVMADDR() {
+    return ( (uint16_t)( ports.VMADDH << 8 ) ) | ( (uint16_t)ports.VMADDL );
+}
 
+static inline void setVMADDR( uint16_t addr ) {
+    ports.VMADDL = (uint8_t)( addr & 0x00FF );
+    ports.VMADDH = (uint8_t)( ( addr >> 8 ) & 0x00FF );
 }
 
 static inline void prefetchRead() {
-    uint16_t offset = ( ( (uint16_t)ports.VMADDH ) << 8 ) | ( (uint16_t)ports.VMADDL );
-    offset = ( offset * 2 ) & ~0x8000;
+    uint32_t offset = vramByteAddress( getVMADDR() );
     ports.RDVRAML = VRAM[ offset ];
     ports.RDVRAMH = VRAM[ offset + 1 ];
 }
 
+static inline void writeVRAM( uint32_t byteAddress, uint8_t value ) {
+    beforeSharedWrite();
+    VRAM[ byteAddress ] = value;
+    ppuTileCacheInvalidate( &tileCache, byteAddress, 1 );
+    logWrite( PPU_LOG_VRAM, (uint16_t)byteAddress, value );
+}
+
+static const uint16_t vmaddIncSteps[ 4 ] = { 1, 32, 128, 128 };
+
 static inline void incrementVMADDR( bool highByte ) {
-    static const uint16_t incSteps[ 4 ] = { 2, 64, 256, 256 };
     uint8_t incMode = ports.VMAIN;
-    uint16_t incStep = incSteps[ incMode & 0x03 ];
     bool incHighByte = ( incMode & 0x80 );
-    if ( incHighByte ==  highByte ) {
-        uint16_t addr = ( (uint16_t)( ports.VMADDH << 8 ) ) | ( (uint16_t)ports.VMADDL );
-        addr += incStep;
-        ports.VMADDH &= ~0x80;
-        ports.VMADDL = (uint8_t)( addr & 0x00FF );
-        ports.VMADDH = (uint8_t)( ( addr >> 8 ) & 0x00FF );
+    if ( incHighByte == highByte ) {
+        setVMADDR( getVMADDR() + vmaddIncSteps[ incMode & 0x03 ] );
+    }
+}
+
+// OAM addresses past the low table mirror the 32 byte high table
+static inline uint16_t oamByteAddress( uint16_t address ) {
+    return address < 0x200 ? address : ( 0x200 | ( address & 0x1F ) );
+}
+
+static inline void writeOAMData( uint8_t value ) {
+    const uint16_t byteAddress = oamByteAddress( ppuState.oamramAddress );
+    beforeSharedWrite();
+    OAMRAM[ byteAddress ] = value;
+    ppuSpriteTableUpdate( &spriteTable, OAMRAM, byteAddress );
+    logWrite( PPU_LOG_OAM, byteAddress, value );
+    ++ppuState.oamramAddress;
+    ppuState.oamramAddress &= 0x3FF;
+}
+
+static inline void writeCGData( uint8_t value ) {
+    if ( !ppuState.cgramSecondAccess ) {
+        // Even address
+        ppuState.CGRAM_lsb_latch = value;
+        ppuState.cgramSecondAccess = true;
+    }
+    else {
+        // TODO - open-bus upper-bit
+        uint16_t addr = ports.CGADD * 2;
+        CGRAM[ addr + 1 ] = value;
+        CGRAM[ addr ] = ppuState.CGRAM_lsb_latch;
+        ppuPaletteUpdate( &palette, CGRAM, ports.CGADD );
+        logWrite( PPU_LOG_CGRAM, ports.CGADD, ( (uint16_t)value << 8 ) | ppuState.CGRAM_lsb_latch );
+        ppuState.cgramSecondAccess = false;
+        ++ports.CGADD;
+    }
+}
+
+// DMA fast paths. Each is equivalent to length writes to the port, taking
+// successive bytes from source, or repeating *source when fixedSource is set.
+
+// Alternating 0x2118/0x2119 writes (DMA transfer mode 1)
+void ppuVRAMBulkWrite( const uint8_t *source, uint32_t length, bool fixedSource ) {
+    const bool incHighByte = ports.VMAIN & 0x80;
+    const bool translate = ports.VMAIN & 0x0C;
+    const uint16_t incStep = vmaddIncSteps[ ports.VMAIN & 0x03 ];
+    uint16_t addr = getVMADDR();
+    const uint8_t sourceStep = fixedSource ? 0 : 1;
+
+    if ( incHighByte && !translate && incStep == 1 ) {
+        // Straight word-sequential upload, copy in runs up to the end of VRAM
+        uint32_t numWords = length / 2;
+        while ( numWords > 0 ) {
+            uint32_t byteOffset = ( (uint32_t)( addr & 0x7FFF ) ) * 2;
+            uint32_t runWords = ( 0x10000 - byteOffset ) / 2;
+            runWords = runWords < numWords ? runWords : numWords;
+            beforeSharedWrite();
+            if ( fixedSource ) {
+                memset( &VRAM[ byteOffset ], *source, runWords * 2 );
+            }
+            else {
+                memcpy( &VRAM[ byteOffset ], source, runWords * 2 );
+                source += runWords * 2;
+            }
+            ppuTileCacheInvalidate( &tileCache, byteOffset, runWords * 2 );
+            if ( useRenderThread ) {
+                for ( uint32_t i = 0; i < runWords * 2; ++i ) {
+                    logWrite( PPU_LOG_VRAM, (uint16_t)( byteOffset + i ), VRAM[ byteOffset + i ] );
+                }
+            }
+            addr += (uint16_t)runWords;
+            numWords -= runWords;
+        }
+        setVMADDR( addr );
+        if ( length & 0x01 ) {
+            writeVRAM( vramByteAddress( addr ), *source );
+        }
+    }
+    else {
+        for ( uint32_t i = 0; i < length; ++i ) {
+            const bool highByte = i & 0x01;
+            writeVRAM( vramByteAddress( addr ) + highByte, *source );
+            source += sourceStep;
+            if ( highByte == incHighByte ) {
+                addr += incStep;
+            }
+        }
+        setVMADDR( addr );
     }
+    prefetchRead();
+}
 
-    if ( incMode & 0x0C ) {
-        // TODO - rotate
-        printf( "TODO - VMADDR translation\n" );
+// 0x2122 writes
+void ppuCGRAMBulkWrite( const uint8_t *source, uint32_t length, bool fixedSource ) {
+    const uint8_t sourceStep = fixedSource ? 0 : 1;
+    for ( uint32_t i = 0; i < length; ++i ) {
+        writeCGData( *source );
+        source += sourceStep;
     }
 }
 
+// 0x2104 writes
+void ppuOAMBulkWrite( const uint8_t *source, uint32_t length, bool fixedSource ) {
+    const uint8_t sourceStep = fixedSource ? 0 : 1;
+    for ( uint32_t i = 0; i < length; ++i ) {
+        writeOAMData( *source );
+        source += sourceStep;
+    }
+}
+
+// Mode 7 registers share one write-twice latch, low byte first.
+// Offsets and centre coordinates are 13-bit signed.
+static inline int16_t writeM7Register( uint8_t value, bool thirteenBit ) {
+    uint16_t result = ( ( (uint16_t)value ) << 8 ) | ppuState.m7Latch;
+    ppuState.m7Latch = value;
+    if ( thirteenBit ) {
+        result = ( result & 0x1000 ) ? ( result | 0xE000 ) : ( result & 0x1FFF );
+    }
+    return (int16_t)result;
+}
+
 void ppuPortAccess( uint8_t addressBus, uint8_t *dataBus, bool writeLine ) {
     
     assert( addressBus <= 0x3F );
@@ -299,9 +502,23 @@ void ppuPortAccess( uint8_t addressBus, uint8_t *dataBus, bool writeLine ) {
             return;
         }
         else {
-            // TODO - BG__OFS
-            // TODO - M7_
             switch( addressBus ) {
+                case 0x00:
+                    // INIDISP
+                    if ( ( ports.INIDISP ^ *dataBus ) & 0x0F ) {
+                        beforeSharedWrite();
+                    }
+                    ports.INIDISP = *dataBus;
+                    ppuPaletteSetBrightness( &palette, *dataBus & 0x0F );
+                    break;
+                case 0x01:
+                    // OBSEL
+                    if ( ( ports.OBSEL ^ *dataBus ) & 0xE0 ) {
+                        beforeSharedWrite();
+                    }
+                    ports.OBSEL = *dataBus;
+                    ppuSpriteTableSetSize( &spriteTable, OAMRAM, *dataBus );
+                    break;
                 case 0x02: {
                     // OAMADDL
                     ports.OAMADDL = *dataBus;
@@ -318,24 +535,75 @@ void ppuPortAccess( uint8_t addressBus, uint8_t *dataBus, bool writeLine ) {
                 }
                 case 0x04: {
                     // OAMDATA
-                    OAMRAM[ ppuState.oamramAddress ] = *dataBus;
-                    ++ppuState.oamramAddress;
-                    ppuState.oamramAddress &= 0x3FF;
+                    writeOAMData( *dataBus );
+                    break;
+                }
+                case 0x0D:
+                case 0x0F:
+                case 0x11:
+                case 0x13: {
+                    // BGnHOFS
+                    uint8_t bg = ( addressBus - 0x0D ) / 2;
+                    uint16_t *offset = &renderRegisters.bgHOffset[ bg ];
+                    *( ( (uint8_t*)&ports ) + addressBus ) = *dataBus;
+                    *offset = ( ( (uint16_t)*dataBus << 8 ) | ( ppuState.bgScrollLatch & ~0x07 ) | ( ( *offset >> 8 ) & 0x07 ) ) & 0x3FF;
+                    ppuState.bgScrollLatch = *dataBus;
+                    if ( bg == 0 ) {
+                        // Also M7HOFS
+                        renderRegisters.m7HOffset = writeM7Register( *dataBus, true );
+                    }
+                    break;
+                }
+                case 0x0E:
+                case 0x10:
+                case 0x12:
+                case 0x14: {
+                    // BGnVOFS
+                    uint8_t bg = ( addressBus - 0x0E ) / 2;
+                    *( ( (uint8_t*)&ports ) + addressBus ) = *dataBus;
+                    renderRegisters.bgVOffset[ bg ] = ( ( (uint16_t)*dataBus << 8 ) | ppuState.bgScrollLatch ) & 0x3FF;
+                    ppuState.bgScrollLatch = *dataBus;
+                    if ( bg == 0 ) {
+                        // Also M7VOFS
+                        renderRegisters.m7VOffset = writeM7Register( *dataBus, true );
+                    }
                     break;
                 }
+                case 0x1B:
+                case 0x1C:
+                case 0x1D:
+                case 0x1E:
+                    // M7A-M7D
+                    *( ( (uint8_t*)&ports ) + addressBus ) = *dataBus;
+                    renderRegisters.m7Matrix[ addressBus - 0x1B ] = writeM7Register( *dataBus, false );
+                    if ( addressBus <= 0x1C ) {
+                        // MPYL/MPYM/MPYH, M7A times the last byte written to M7B, both signed
+                        const int32_t product = (int32_t)renderRegisters.m7Matrix[ 0 ] * (int8_t)( renderRegisters.m7Matrix[ 1 ] >> 8 );
+                        ports.MPYL = (uint8_t)product;
+                        ports.MPYM = (uint8_t)( product >> 8 );
+                        ports.MPYH = (uint8_t)( product >> 16 );
+                    }
+                    break;
+                case 0x1F:
+                    // M7X
+                    ports.M7X = *dataBus;
+                    renderRegisters.m7CentreX = writeM7Register( *dataBus, true );
+                    break;
+                case 0x20:
+                    // M7Y
+                    ports.M7Y = *dataBus;
+                    renderRegisters.m7CentreY = writeM7Register( *dataBus, true );
+                    break;
                 case 0x16:
                 case 0x17:
                     // VMADDl/h
+                    *( ( (uint8_t*)&ports ) + addressBus ) = *dataBus;
                     prefetchRead();
                     break;
                 case 0x18:
                 case 0x19: {
                     uint8_t offset = addressBus - 0x18;
-                    // TODO - VRAM accesses
-                    uint16_t addr = ( (uint16_t)( ports.VMADDH << 8 ) ) | ( (uint16_t)ports.VMADDL );
-                    addr += offset;
-                    addr &= ~0x8000;
-                    VRAM[ addr ] =  *dataBus;
+                    writeVRAM( vramByteAddress( getVMADDR() ) + offset, *dataBus );
                     prefetchRead(); // TODO - prefetch before or after?
                     incrementVMADDR( (bool)offset );
                     break;
@@ -346,18 +614,18 @@ void ppuPortAccess( uint8_t addressBus, uint8_t *dataBus, bool writeLine ) {
                     break;
                 case 0x22: {
                     // CGDATA
-                    if ( !ppuState.cgramSecondAccess ) {
-                        // Even address
-                        ppuState.CGRAM_lsb_latch = *dataBus;
-                        ppuState.cgramSecondAccess = true;
-                    }
-                    else {
-                        // TODO - open-bus upper-bit
-                        uint16_t addr = ports.CGADD * 2;
-                        CGRAM[ addr + 1 ] = *dataBus;
-                        CGRAM[ addr ] = ppuState.CGRAM_lsb_latch;
-                        ppuState.cgramSecondAccess = false;
-                        ++ports.CGADD;
+                    writeCGData( *dataBus );
+                    break;
+                }
+                case 0x32: {
+                    // COLDATA, bits 5-7 pick which channels take the intensity
+                    ports.COLDATA = *dataBus;
+                    const uint16_t intensity = *dataBus & 0x1F;
+                    for ( uint8_t channel = 0; channel < 3; ++channel ) {
+                        if ( *dataBus & ( 0x20 << channel ) ) {
+                            renderRegisters.fixedColour &= ~( 0x1F << ( channel * 5 ) );
+                            renderRegisters.fixedColour |= intensity << ( channel * 5 );
+                        }
                     }
                     break;
                 }
@@ -367,6 +635,10 @@ void ppuPortAccess( uint8_t addressBus, uint8_t *dataBus, bool writeLine ) {
                     break;
                 }
             }
+            if ( useRenderThread ) {
+                logWrite( PPU_LOG_PORT, addressBus, ( (uint8_t*)&ports )[ addressBus ] );
+                logRegisters();
+            }
         }
     }
     else {
@@ -381,7 +653,7 @@ void ppuPortAccess( uint8_t addressBus, uint8_t *dataBus, bool writeLine ) {
             switch( addressBus ) {
                 case 0x38: {
                     // RDOAM
-                    *dataBus = OAMRAM[ ppuState.oamramAddress ];
+                    *dataBus = OAMRAM[ oamByteAddress( ppuState.oamramAddress ) ];
                     ++ppuState.oamramAddress;
                     ppuState.oamramAddress &= 0x1FF;
                     break;
@@ -408,14 +680,16 @@ void ppuPortAccess( uint8_t addressBus, uint8_t *dataBus, bool writeLine ) {
                     }
                     break;
                 }
-                case 0x34: {
-                    // TODO - temp standin for OAM init
-                    *dataBus = 0x80;
-                    break;
-                }
-                case 0x35: {
-                    // TODO - temp standin for OAM init
-                    *dataBus = 0xE0;
+                case 0x3E: {
+                    // STAT77, sprite overflow flags come from the renderer
+                    if ( useRenderThread ) {
+                        ppuRenderThreadSync();
+                        *dataBus = ( ports.STAT77 & ~( STAT77_TIME_OVER | STAT77_RANGE_OVER ) ) | ppuRenderThreadStat77();
+                    }
+                    else if ( numPendingLines > 0 ) {
+                        flushPendingLines();
+                        *dataBus = ports.STAT77;
+                    }
                     break;
                 }
             }
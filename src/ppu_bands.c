@@ -0,0 +1,152 @@
+#include "ppu_internal.h"
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+// Fewer lines than this are rendered by the caller alone
+#define MIN_PARALLEL_LINES 16
+
+typedef struct BandJob {
+    const PPULineSnapshot *snapshots;
+    uint16_t first;
+    uint16_t count;
+    uint8_t field;
+    const uint8_t *VRAM;
+    const PPUSpriteTable *spriteTable;
+    PPUTileCache *tileCache;
+    const PPUOutput *output;
+} BandJob;
+
+typedef struct BandPool {
+    pthread_t threads[ PPU_MAX_RENDER_WORKERS ];
+    uint8_t numWorkers; // Including the caller
+    pthread_mutex_t lock;
+    pthread_cond_t start;
+    pthread_cond_t done;
+    uint64_t generation; // Bumped for every job
+    uint8_t remaining; // Worker threads still rendering the current job
+    bool quit;
+    BandJob job;
+    uint8_t flags[ PPU_MAX_RENDER_WORKERS ];
+} BandPool;
+
+static BandPool pool;
+
+static uint8_t renderLines( const BandJob *job, uint16_t first, uint16_t count ) {
+    uint16_t lineBuffer[ HIRES_WIDTH ];
+    uint8_t flags = 0x00;
+    for ( uint16_t line = first; line < first + count; ++line ) {
+        const PPULineSnapshot *snapshot = &job->snapshots[ line ];
+        const PPURenderContext context = {
+            &snapshot->ports, &snapshot->registers, job->VRAM, NULL, snapshot->palette,
+            NULL, job->spriteTable, job->tileCache, job->field
+        };
+        flags |= ppuRenderScanline( &context, line, lineBuffer );
+        ppuOutputLine( job->output, lineBuffer, ppuLineIsHiRes( &snapshot->ports ), line, job->field );
+    }
+    return flags;
+}
+
+static uint8_t renderBand( const BandJob *job, uint8_t band ) {
+    const uint16_t first = job->first + (uint32_t)job->count * band / pool.numWorkers;
+    const uint16_t last = job->first + (uint32_t)job->count * ( band + 1 ) / pool.numWorkers;
+    return renderLines( job, first, last - first );
+}
+
+static void *bandWorker( void *argument ) {
+    const uint8_t band = (uint8_t)(uintptr_t)argument;
+    uint64_t seen = 0;
+
+    for ( ;; ) {
+        pthread_mutex_lock( &pool.lock );
+        while ( pool.generation == seen && !pool.quit ) {
+            pthread_cond_wait( &pool.start, &pool.lock );
+        }
+        if ( pool.quit ) {
+            pthread_mutex_unlock( &pool.lock );
+            break;
+        }
+        seen = pool.generation;
+        pthread_mutex_unlock( &pool.lock );
+
+        const uint8_t flags = renderBand( &pool.job, band );
+
+        pthread_mutex_lock( &pool.lock );
+        pool.flags[ band ] = flags;
+        if ( --pool.remaining == 0 ) {
+            pthread_cond_signal( &pool.done );
+        }
+        pthread_mutex_unlock( &pool.lock );
+    }
+    return NULL;
+}
+
+bool ppuBandsStart( uint8_t numWorkers ) {
+    if ( numWorkers > PPU_MAX_RENDER_WORKERS ) {
+        numWorkers = PPU_MAX_RENDER_WORKERS;
+    }
+    pool.numWorkers = 1;
+    pool.generation = 0;
+    pool.quit = false;
+    pthread_mutex_init( &pool.lock, NULL );
+    pthread_cond_init( &pool.start, NULL );
+    pthread_cond_init( &pool.done, NULL );
+
+    for ( uint8_t band = 1; band < numWorkers; ++band ) {
+        if ( pthread_create( &pool.threads[ band ], NULL, bandWorker, (void*)(uintptr_t)band ) ) {
+            printf( "Unable to start render worker %u\n", band );
+            ppuBandsStop();
+            return false;
+        }
+        ++pool.numWorkers;
+    }
+    atexit( ppuBandsStop );
+    return true;
+}
+
+void ppuBandsStop() {
+    pthread_mutex_lock( &pool.lock );
+    pool.quit = true;
+    pthread_cond_broadcast( &pool.start );
+    pthread_mutex_unlock( &pool.lock );
+    for ( uint8_t band = 1; band < pool.numWorkers; ++band ) {
+        pthread_join( pool.threads[ band ], NULL );
+    }
+    pool.numWorkers = 1;
+}
+
+uint8_t ppuBandsRender( const PPULineSnapshot *snapshots, uint16_t first, uint16_t count, uint8_t field, const uint8_t *VRAM,
+                        const PPUSpriteTable *spriteTable, PPUTileCache *tileCache, PPUOutput *output ) {
+    // Shared by every band, so nothing may be decoded lazily, and the frame
+    // must already be the size every line needs
+    ppuTileCacheRefresh( tileCache, VRAM );
+    for ( uint16_t line = first; line < first + count; ++line ) {
+        const Ports *ports = &snapshots[ line ].ports;
+        ppuOutputPrepareLine( output, line, ppuLineIsHiRes( ports ), ppuLineIsInterlaced( ports ) );
+    }
+
+    const BandJob job = { snapshots, first, count, field, VRAM, spriteTable, tileCache, output };
+    if ( pool.numWorkers == 1 || count < MIN_PARALLEL_LINES ) {
+        return renderLines( &job, first, count );
+    }
+
+    pthread_mutex_lock( &pool.lock );
+    pool.job = job;
+    pool.remaining = pool.numWorkers - 1;
+    ++pool.generation;
+    pthread_cond_broadcast( &pool.start );
+    pthread_mutex_unlock( &pool.lock );
+
+    uint8_t flags = renderBand( &job, 0 );
+
+    pthread_mutex_lock( &pool.lock );
+    while ( pool.remaining > 0 ) {
+        pthread_cond_wait( &pool.done, &pool.lock );
+    }
+    for ( uint8_t band = 1; band < pool.numWorkers; ++band ) {
+        flags |= pool.flags[ band ];
+    }
+    pthread_mutex_unlock( &pool.lock );
+    return flags;
+}
@@ -0,0 +1,93 @@
+#include "ppu_internal.h"
+
+#include <memory.h>
+
+// Window region selectors as used by CGWSEL: never, outside, inside, always
+static inline bool inRegion( uint8_t selector, bool insideWindow ) {
+    switch ( selector & 0x03 ) {
+        case 0: return false;
+        case 1: return !insideWindow;
+        case 2: return insideWindow;
+        default: return true;
+    }
+}
+
+// An 8bpp pixel as BGR233 plus the tile's palette bits as the low bit of each component
+static inline uint16_t directColourBGR555( uint8_t colour, uint8_t palette ) {
+    const uint16_t red = ( ( colour & 0x07 ) << 2 ) | ( ( palette & 0x01 ) << 1 );
+    const uint16_t green = ( ( ( colour >> 3 ) & 0x07 ) << 2 ) | ( palette & 0x02 );
+    const uint16_t blue = ( ( ( colour >> 6 ) & 0x03 ) << 3 ) | ( palette & 0x04 );
+    return red | ( green << 5 ) | ( blue << 10 );
+}
+
+static inline uint16_t pixelColour( const PPURenderContext *context, const LayerLine *layers, bool directColour, uint8_t colour,
+                                    uint8_t source, uint16_t x ) {
+    if ( directColour && source == LAYER_BG1 ) {
+        return directColourBGR555( colour, layers[ LAYER_BG1 ].directPalette[ x ] );
+    }
+    return context->palette[ colour ];
+}
+
+// Pick the closest opaque pixel of the given layers, the backdrop where every layer is transparent.
+// Layers whose bit is set in windowed are hidden inside their window.
+static void resolveScreen( const LayerLine *layers, uint8_t enabled, uint8_t windowed, const PPUWindowMask *windows,
+                           uint8_t *colour, uint8_t *source ) {
+    static const PPUWindowMask noWindow;
+    uint8_t bestDepth[ SCREEN_WIDTH ];
+    memset( bestDepth, 0, sizeof( bestDepth ) );
+    memset( colour, 0, SCREEN_WIDTH );
+    memset( source, LAYER_BACKDROP, SCREEN_WIDTH );
+
+    for ( uint8_t l = 0; l < NUM_LAYERS; ++l ) {
+        if ( enabled & ( 1 << l ) ) {
+            const PPUWindowMask *hidden = ( windowed & ( 1 << l ) ) ? &windows[ l ] : &noWindow;
+            ppuKernels->resolveLayer( &layers[ l ], l, hidden, bestDepth, colour, source );
+        }
+    }
+}
+
+void ppuComposeLine( const PPURenderContext *context, const LayerLine *layers, uint8_t mainLayers, uint8_t subLayers, uint16_t *output ) {
+    const Ports *ports = context->ports;
+
+    PPUWindowMask windows[ NUM_WINDOW_MASKS ];
+    ppuWindowEvaluate( ports, windows );
+
+    uint8_t mainColour[ SCREEN_WIDTH ];
+    uint8_t mainSource[ SCREEN_WIDTH ];
+    resolveScreen( layers, mainLayers, ports->TMW, windows, mainColour, mainSource );
+
+    const bool directColour = ppuDirectColour( ports );
+    const bool useSubscreen = ports->CGWSEL & 0x02;
+    uint8_t subColour[ SCREEN_WIDTH ];
+    uint8_t subSource[ SCREEN_WIDTH ];
+    if ( useSubscreen ) {
+        resolveScreen( layers, subLayers, ports->TSW, windows, subColour, subSource );
+    }
+
+    const uint8_t clipRegion = ports->CGWSEL >> 6;
+    const uint8_t mathRegion = 3 - ( ( ports->CGWSEL >> 4 ) & 0x03 );
+    const bool halveEnabled = ports->CGADSUB & 0x40;
+
+    uint16_t sub[ SCREEN_WIDTH ];
+    uint8_t math[ SCREEN_WIDTH ];
+    uint8_t halve[ SCREEN_WIDTH ];
+    for ( uint16_t x = 0; x < SCREEN_WIDTH; ++x ) {
+        const uint8_t source = mainSource[ x ];
+        const bool insideColourWindow = ppuWindowTest( &windows[ WINDOW_COLOUR ], x );
+        const bool clipToBlack = inRegion( clipRegion, insideColourWindow );
+        const bool mathAllowed = inRegion( mathRegion, insideColourWindow );
+        output[ x ] = clipToBlack ? 0 : pixelColour( context, layers, directColour, mainColour[ x ], source, x );
+
+        // Sprites only take part with palettes 4-7
+        math[ x ] = mathAllowed && ( ( ports->CGADSUB >> source ) & 0x01 ) &&
+            ( source != LAYER_OBJ || mainColour[ x ] >= 0xC0 );
+
+        // The sub screen backdrop is the fixed colour, and is never halved
+        const bool subOpaque = useSubscreen && subSource[ x ] != LAYER_BACKDROP;
+        sub[ x ] = subOpaque ? pixelColour( context, layers, directColour, subColour[ x ], subSource[ x ], x ) :
+            context->registers->fixedColour;
+        halve[ x ] = halveEnabled && !clipToBlack && ( subOpaque || !useSubscreen );
+    }
+
+    ppuKernels->colourMath( output, sub, math, halve, ports->CGADSUB & 0x80, SCREEN_WIDTH );
+}
@@ -0,0 +1,400 @@
+#include "ppu_internal.h"
+
+#include <memory.h>
+
+#if defined( __x86_64__ ) || defined( __i386__ )
+#include <immintrin.h>
+#define PPU_X86_KERNELS
+#endif
+
+// Inner loops of the BG renderer and tile cache, with AVX2 and SSE4.1
+// versions picked at runtime from what the host CPU supports.
+
+#pragma region Scalar
+
+static void decodeTileScalar( const uint8_t *tileData, uint8_t bitDepth, uint8_t *pixels ) {
+    memset( pixels, 0x00, 64 );
+    for ( uint8_t row = 0; row < 8; ++row ) {
+        for ( uint8_t planePair = 0; planePair < bitDepth / 2; ++planePair ) {
+            const uint8_t low = tileData[ planePair * 16 + row * 2 ];
+            const uint8_t high = tileData[ planePair * 16 + row * 2 + 1 ];
+            for ( uint8_t x = 0; x < 8; ++x ) {
+                const uint8_t shift = 7 - x;
+                pixels[ row * 8 + x ] |= ( ( ( low >> shift ) & 0x01 ) | ( ( ( high >> shift ) & 0x01 ) << 1 ) ) << ( planePair * 2 );
+            }
+        }
+    }
+}
+
+static void drawTileRowsScalar( const PPUTileRow *rows, uint16_t numRows, uint8_t *colour, uint8_t *depth ) {
+    for ( uint16_t r = 0; r < numRows; ++r ) {
+        const PPUTileRow *row = &rows[ r ];
+        for ( uint8_t i = 0; i < 8; ++i ) {
+            const uint8_t pixel = row->pixels[ row->hFlip ? 7 - i : i ];
+            colour[ r * 8 + i ] = row->colourBase + pixel;
+            depth[ r * 8 + i ] = pixel ? row->depth : 0;
+        }
+    }
+}
+
+// The playfield is 128x128 tiles. Tile numbers sit in the low bytes of the
+// first 16K words of VRAM, 8x8 8bpp chunky tiles in the high bytes.
+static void drawMode7LineScalar( const PPUMode7Line *walk, const uint8_t *VRAM, uint8_t *pixels ) {
+    int32_t fixedX = walk->startX;
+    int32_t fixedY = walk->startY;
+    for ( uint16_t i = 0; i < SCREEN_WIDTH; ++i ) {
+        int32_t x = fixedX >> 8;
+        int32_t y = fixedY >> 8;
+        fixedX += walk->stepX;
+        fixedY += walk->stepY;
+
+        const bool outside = ( x | y ) & ~0x3FF;
+        if ( outside && walk->screenOver == 2 ) {
+            pixels[ i ] = 0;
+            continue;
+        }
+        x &= 0x3FF;
+        y &= 0x3FF;
+        const uint8_t tile = ( outside && walk->screenOver == 3 ) ? 0 : VRAM[ ( ( y >> 3 ) * 128 + ( x >> 3 ) ) * 2 ];
+        pixels[ i ] = VRAM[ tile * 128 + ( y & 0x07 ) * 16 + ( x & 0x07 ) * 2 + 1 ];
+    }
+}
+
+static void resolveLayerScalar( const LayerLine *layer, uint8_t layerId, const PPUWindowMask *hidden, uint8_t *bestDepth, uint8_t *colour, uint8_t *source ) {
+    for ( uint16_t x = 0; x < SCREEN_WIDTH; ++x ) {
+        if ( layer->depth[ x ] > bestDepth[ x ] && !ppuWindowTest( hidden, x ) ) {
+            bestDepth[ x ] = layer->depth[ x ];
+            colour[ x ] = layer->colour[ x ];
+            source[ x ] = layerId;
+        }
+    }
+}
+
+// Each 5-bit channel is added or subtracted separately, clamped to 0-31
+static void colourMathScalar( uint16_t *main, const uint16_t *sub, const uint8_t *math, const uint8_t *halve, bool subtract, uint16_t count ) {
+    for ( uint16_t i = 0; i < count; ++i ) {
+        if ( !math[ i ] ) {
+            continue;
+        }
+        uint16_t result = 0;
+        for ( uint8_t shift = 0; shift < 15; shift += 5 ) {
+            const int16_t a = ( main[ i ] >> shift ) & 0x1F;
+            const int16_t b = ( sub[ i ] >> shift ) & 0x1F;
+            int16_t channel = subtract ? ( a > b ? a - b : 0 ) : a + b;
+            if ( halve[ i ] ) {
+                channel >>= 1;
+            }
+            result |= ( channel > 0x1F ? 0x1F : channel ) << shift;
+        }
+        main[ i ] = result;
+    }
+}
+
+static const PPUKernels scalarKernels = {
+    .name = "scalar",
+    .decodeTile = decodeTileScalar,
+    .drawTileRows = drawTileRowsScalar,
+    .drawMode7Line = drawMode7LineScalar,
+    .resolveLayer = resolveLayerScalar,
+    .colourMath = colourMathScalar,
+};
+
+#pragma endregion
+
+#ifdef PPU_X86_KERNELS
+
+// pshufb controls for one 8 byte row in the low or high half of a 128-bit lane
+#define ROW_IDENTITY_LOW    0x0706050403020100ull
+#define ROW_REVERSE_LOW     0x0001020304050607ull
+#define ROW_IDENTITY_HIGH   0x0F0E0D0C0B0A0908ull
+#define ROW_REVERSE_HIGH    0x08090A0B0C0D0E0Full
+#define BYTE_BROADCAST      0x0101010101010101ull
+
+static inline uint64_t loadRow( const uint8_t *pixels ) {
+    uint64_t row;
+    memcpy( &row, pixels, sizeof( row ) );
+    return row;
+}
+
+#pragma region SSE4.1
+
+// Two rows per vector. Each row's plane bytes are spread across its 8 pixels
+// with pshufb, then tested against the pixel's bit.
+__attribute__(( target( "sse4.1" ) ))
+static void decodeTileSSE4( const uint8_t *tileData, uint8_t bitDepth, uint8_t *pixels ) {
+    const __m128i bits = _mm_set1_epi64x( (int64_t)0x0102040810204080ull );
+    for ( uint8_t rowPair = 0; rowPair < 4; ++rowPair ) {
+        const __m128i lowIndices = _mm_set_epi64x(
+            (int64_t)( ( rowPair * 4 + 2 ) * BYTE_BROADCAST ), (int64_t)( ( rowPair * 4 ) * BYTE_BROADCAST ) );
+        const __m128i highIndices = _mm_add_epi8( lowIndices, _mm_set1_epi8( 1 ) );
+        __m128i result = _mm_setzero_si128();
+        for ( uint8_t planePair = 0; planePair < bitDepth / 2; ++planePair ) {
+            const __m128i planes = _mm_loadu_si128( (const __m128i*)&tileData[ planePair * 16 ] );
+            const __m128i low = _mm_cmpeq_epi8( _mm_and_si128( _mm_shuffle_epi8( planes, lowIndices ), bits ), bits );
+            const __m128i high = _mm_cmpeq_epi8( _mm_and_si128( _mm_shuffle_epi8( planes, highIndices ), bits ), bits );
+            result = _mm_or_si128( result, _mm_and_si128( low, _mm_set1_epi8( (char)( 1 << ( planePair * 2 ) ) ) ) );
+            result = _mm_or_si128( result, _mm_and_si128( high, _mm_set1_epi8( (char)( 2 << ( planePair * 2 ) ) ) ) );
+        }
+        _mm_storeu_si128( (__m128i*)&pixels[ rowPair * 16 ], result );
+    }
+}
+
+__attribute__(( target( "sse4.1" ) ))
+static void drawTileRowsSSE4( const PPUTileRow *rows, uint16_t numRows, uint8_t *colour, uint8_t *depth ) {
+    const __m128i zero = _mm_setzero_si128();
+    uint16_t r = 0;
+    for ( ; r + 2 <= numRows; r += 2 ) {
+        const PPUTileRow *row0 = &rows[ r ];
+        const PPUTileRow *row1 = &rows[ r + 1 ];
+        const __m128i flips = _mm_set_epi64x(
+            (int64_t)( row1->hFlip ? ROW_REVERSE_HIGH : ROW_IDENTITY_HIGH ),
+            (int64_t)( row0->hFlip ? ROW_REVERSE_LOW : ROW_IDENTITY_LOW ) );
+        const __m128i pixels = _mm_shuffle_epi8(
+            _mm_set_epi64x( (int64_t)loadRow( row1->pixels ), (int64_t)loadRow( row0->pixels ) ), flips );
+        const __m128i bases = _mm_set_epi64x( (int64_t)( row1->colourBase * BYTE_BROADCAST ), (int64_t)( row0->colourBase * BYTE_BROADCAST ) );
+        const __m128i depths = _mm_set_epi64x( (int64_t)( row1->depth * BYTE_BROADCAST ), (int64_t)( row0->depth * BYTE_BROADCAST ) );
+
+        _mm_storeu_si128( (__m128i*)&colour[ r * 8 ], _mm_add_epi8( pixels, bases ) );
+        _mm_storeu_si128( (__m128i*)&depth[ r * 8 ], _mm_andnot_si128( _mm_cmpeq_epi8( pixels, zero ), depths ) );
+    }
+    drawTileRowsScalar( &rows[ r ], numRows - r, &colour[ r * 8 ], &depth[ r * 8 ] );
+}
+
+// Depths are small, so signed byte compares are safe. Window bits are spread
+// to one byte per pixel with pshufb and tested like tile planes.
+__attribute__(( target( "sse4.1" ) ))
+static void resolveLayerSSE4( const LayerLine *layer, uint8_t layerId, const PPUWindowMask *hidden, uint8_t *bestDepth, uint8_t *colour, uint8_t *source ) {
+    const __m128i spread = _mm_setr_epi8( 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 1, 1, 1, 1 );
+    const __m128i bits = _mm_set1_epi64x( (int64_t)0x8040201008040201ull );
+    const __m128i id = _mm_set1_epi8( (char)layerId );
+    for ( uint16_t x = 0; x < SCREEN_WIDTH; x += 16 ) {
+        const uint16_t windowBits = (uint16_t)( hidden->bits[ x / 64 ] >> ( x % 64 ) );
+        const __m128i inside = _mm_cmpeq_epi8( _mm_and_si128( _mm_shuffle_epi8( _mm_set1_epi16( (short)windowBits ), spread ), bits ), bits );
+        const __m128i depth = _mm_andnot_si128( inside, _mm_loadu_si128( (const __m128i*)&layer->depth[ x ] ) );
+        const __m128i best = _mm_loadu_si128( (const __m128i*)&bestDepth[ x ] );
+        const __m128i closer = _mm_cmpgt_epi8( depth, best );
+
+        _mm_storeu_si128( (__m128i*)&bestDepth[ x ], _mm_blendv_epi8( best, depth, closer ) );
+        _mm_storeu_si128( (__m128i*)&colour[ x ], _mm_blendv_epi8(
+            _mm_loadu_si128( (const __m128i*)&colour[ x ] ), _mm_loadu_si128( (const __m128i*)&layer->colour[ x ] ), closer ) );
+        _mm_storeu_si128( (__m128i*)&source[ x ], _mm_blendv_epi8( _mm_loadu_si128( (const __m128i*)&source[ x ] ), id, closer ) );
+    }
+}
+
+__attribute__(( target( "sse4.1" ) ))
+static inline __m128i colourMathChannelSSE4( __m128i a, __m128i b, __m128i halve, bool subtract ) {
+    const __m128i result = subtract ? _mm_subs_epu16( a, b ) : _mm_add_epi16( a, b );
+    return _mm_min_epu16( _mm_blendv_epi8( result, _mm_srli_epi16( result, 1 ), halve ), _mm_set1_epi16( 0x1F ) );
+}
+
+// Eight pixels per vector, one channel at a time in 16-bit lanes
+__attribute__(( target( "sse4.1" ) ))
+static void colourMathSSE4( uint16_t *main, const uint16_t *sub, const uint8_t *math, const uint8_t *halve, bool subtract, uint16_t count ) {
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i channelMask = _mm_set1_epi16( 0x1F );
+    uint16_t i = 0;
+    for ( ; i + 8 <= count; i += 8 ) {
+        const __m128i mathMask = _mm_andnot_si128(
+            _mm_cmpeq_epi16( _mm_cvtepu8_epi16( _mm_loadl_epi64( (const __m128i*)&math[ i ] ) ), zero ), _mm_set1_epi16( -1 ) );
+        const __m128i halveMask = _mm_andnot_si128(
+            _mm_cmpeq_epi16( _mm_cvtepu8_epi16( _mm_loadl_epi64( (const __m128i*)&halve[ i ] ) ), zero ), _mm_set1_epi16( -1 ) );
+        const __m128i a = _mm_loadu_si128( (const __m128i*)&main[ i ] );
+        const __m128i b = _mm_loadu_si128( (const __m128i*)&sub[ i ] );
+
+        __m128i result = colourMathChannelSSE4( _mm_and_si128( a, channelMask ), _mm_and_si128( b, channelMask ), halveMask, subtract );
+        result = _mm_or_si128( result, _mm_slli_epi16( colourMathChannelSSE4(
+            _mm_and_si128( _mm_srli_epi16( a, 5 ), channelMask ), _mm_and_si128( _mm_srli_epi16( b, 5 ), channelMask ), halveMask, subtract ), 5 ) );
+        result = _mm_or_si128( result, _mm_slli_epi16( colourMathChannelSSE4(
+            _mm_and_si128( _mm_srli_epi16( a, 10 ), channelMask ), _mm_and_si128( _mm_srli_epi16( b, 10 ), channelMask ), halveMask, subtract ), 10 ) );
+        _mm_storeu_si128( (__m128i*)&main[ i ], _mm_blendv_epi8( a, result, mathMask ) );
+    }
+    colourMathScalar( &main[ i ], &sub[ i ], &math[ i ], &halve[ i ], subtract, count - i );
+}
+
+static const PPUKernels sse4Kernels = {
+    .name = "SSE4.1",
+    .decodeTile = decodeTileSSE4,
+    .drawTileRows = drawTileRowsSSE4,
+    .drawMode7Line = drawMode7LineScalar, // Needs gathers
+    .resolveLayer = resolveLayerSSE4,
+    .colourMath = colourMathSSE4,
+};
+
+#pragma endregion
+
+#pragma region AVX2
+
+// Four rows per vector, two per 128-bit lane
+__attribute__(( target( "avx2" ) ))
+static void decodeTileAVX2( const uint8_t *tileData, uint8_t bitDepth, uint8_t *pixels ) {
+    const __m256i bits = _mm256_set1_epi64x( (int64_t)0x0102040810204080ull );
+    for ( uint8_t rowQuad = 0; rowQuad < 2; ++rowQuad ) {
+        const uint8_t firstByte = rowQuad * 8;
+        const __m256i lowIndices = _mm256_set_epi64x(
+            (int64_t)( ( firstByte + 6 ) * BYTE_BROADCAST ), (int64_t)( ( firstByte + 4 ) * BYTE_BROADCAST ),
+            (int64_t)( ( firstByte + 2 ) * BYTE_BROADCAST ), (int64_t)( firstByte * BYTE_BROADCAST ) );
+        const __m256i highIndices = _mm256_add_epi8( lowIndices, _mm256_set1_epi8( 1 ) );
+        __m256i result = _mm256_setzero_si256();
+        for ( uint8_t planePair = 0; planePair < bitDepth / 2; ++planePair ) {
+            const __m256i planes = _mm256_broadcastsi128_si256( _mm_loadu_si128( (const __m128i*)&tileData[ planePair * 16 ] ) );
+            const __m256i low = _mm256_cmpeq_epi8( _mm256_and_si256( _mm256_shuffle_epi8( planes, lowIndices ), bits ), bits );
+            const __m256i high = _mm256_cmpeq_epi8( _mm256_and_si256( _mm256_shuffle_epi8( planes, highIndices ), bits ), bits );
+            result = _mm256_or_si256( result, _mm256_and_si256( low, _mm256_set1_epi8( (char)( 1 << ( planePair * 2 ) ) ) ) );
+            result = _mm256_or_si256( result, _mm256_and_si256( high, _mm256_set1_epi8( (char)( 2 << ( planePair * 2 ) ) ) ) );
+        }
+        _mm256_storeu_si256( (__m256i*)&pixels[ rowQuad * 32 ], result );
+    }
+}
+
+__attribute__(( target( "avx2" ) ))
+static void drawTileRowsAVX2( const PPUTileRow *rows, uint16_t numRows, uint8_t *colour, uint8_t *depth ) {
+    const __m256i zero = _mm256_setzero_si256();
+    uint16_t r = 0;
+    for ( ; r + 4 <= numRows; r += 4 ) {
+        const PPUTileRow *row = &rows[ r ];
+        const __m256i flips = _mm256_set_epi64x(
+            (int64_t)( row[ 3 ].hFlip ? ROW_REVERSE_HIGH : ROW_IDENTITY_HIGH ),
+            (int64_t)( row[ 2 ].hFlip ? ROW_REVERSE_LOW : ROW_IDENTITY_LOW ),
+            (int64_t)( row[ 1 ].hFlip ? ROW_REVERSE_HIGH : ROW_IDENTITY_HIGH ),
+            (int64_t)( row[ 0 ].hFlip ? ROW_REVERSE_LOW : ROW_IDENTITY_LOW ) );
+        const __m256i pixels = _mm256_shuffle_epi8( _mm256_set_epi64x(
+            (int64_t)loadRow( row[ 3 ].pixels ), (int64_t)loadRow( row[ 2 ].pixels ),
+            (int64_t)loadRow( row[ 1 ].pixels ), (int64_t)loadRow( row[ 0 ].pixels ) ), flips );
+        const __m256i bases = _mm256_set_epi64x(
+            (int64_t)( row[ 3 ].colourBase * BYTE_BROADCAST ), (int64_t)( row[ 2 ].colourBase * BYTE_BROADCAST ),
+            (int64_t)( row[ 1 ].colourBase * BYTE_BROADCAST ), (int64_t)( row[ 0 ].colourBase * BYTE_BROADCAST ) );
+        const __m256i depths = _mm256_set_epi64x(
+            (int64_t)( row[ 3 ].depth * BYTE_BROADCAST ), (int64_t)( row[ 2 ].depth * BYTE_BROADCAST ),
+            (int64_t)( row[ 1 ].depth * BYTE_BROADCAST ), (int64_t)( row[ 0 ].depth * BYTE_BROADCAST ) );
+
+        _mm256_storeu_si256( (__m256i*)&colour[ r * 8 ], _mm256_add_epi8( pixels, bases ) );
+        _mm256_storeu_si256( (__m256i*)&depth[ r * 8 ], _mm256_andnot_si256( _mm256_cmpeq_epi8( pixels, zero ), depths ) );
+    }
+    drawTileRowsSSE4( &rows[ r ], numRows - r, &colour[ r * 8 ], &depth[ r * 8 ] );
+}
+
+// 8 pixels per iteration, both VRAM lookups done with gathers
+__attribute__(( target( "avx2" ) ))
+static void drawMode7LineAVX2( const PPUMode7Line *walk, const uint8_t *VRAM, uint8_t *pixels ) {
+    const __m256i lanes = _mm256_setr_epi32( 0, 1, 2, 3, 4, 5, 6, 7 );
+    __m256i fixedX = _mm256_add_epi32( _mm256_set1_epi32( walk->startX ), _mm256_mullo_epi32( lanes, _mm256_set1_epi32( walk->stepX ) ) );
+    __m256i fixedY = _mm256_add_epi32( _mm256_set1_epi32( walk->startY ), _mm256_mullo_epi32( lanes, _mm256_set1_epi32( walk->stepY ) ) );
+    const __m256i blockStepX = _mm256_set1_epi32( walk->stepX * 8 );
+    const __m256i blockStepY = _mm256_set1_epi32( walk->stepY * 8 );
+
+    const __m256i coordinateMask = _mm256_set1_epi32( 0x3FF );
+    const __m256i outsideBits = _mm256_set1_epi32( ~0x3FF );
+    const __m256i fineMask = _mm256_set1_epi32( 0x07 );
+    const __m256i byteMask = _mm256_set1_epi32( 0xFF );
+    const __m256i one = _mm256_set1_epi32( 1 );
+    const __m256i zero = _mm256_setzero_si256();
+
+    for ( uint16_t i = 0; i < SCREEN_WIDTH; i += 8 ) {
+        __m256i x = _mm256_srai_epi32( fixedX, 8 );
+        __m256i y = _mm256_srai_epi32( fixedY, 8 );
+        fixedX = _mm256_add_epi32( fixedX, blockStepX );
+        fixedY = _mm256_add_epi32( fixedY, blockStepY );
+
+        const __m256i inside = _mm256_cmpeq_epi32( _mm256_and_si256( _mm256_or_si256( x, y ), outsideBits ), zero );
+        x = _mm256_and_si256( x, coordinateMask );
+        y = _mm256_and_si256( y, coordinateMask );
+
+        const __m256i tileAddress = _mm256_slli_epi32(
+            _mm256_or_si256( _mm256_slli_epi32( _mm256_srli_epi32( y, 3 ), 7 ), _mm256_srli_epi32( x, 3 ) ), 1 );
+        __m256i tile = _mm256_and_si256( _mm256_i32gather_epi32( (const int*)VRAM, tileAddress, 1 ), byteMask );
+        if ( walk->screenOver == 3 ) {
+            tile = _mm256_and_si256( tile, inside );
+        }
+
+        const __m256i pixelAddress = _mm256_or_si256(
+            _mm256_or_si256( _mm256_slli_epi32( tile, 7 ), _mm256_slli_epi32( _mm256_and_si256( y, fineMask ), 4 ) ),
+            _mm256_or_si256( _mm256_slli_epi32( _mm256_and_si256( x, fineMask ), 1 ), one ) );
+        __m256i pixel = _mm256_and_si256( _mm256_i32gather_epi32( (const int*)VRAM, pixelAddress, 1 ), byteMask );
+        if ( walk->screenOver == 2 ) {
+            pixel = _mm256_and_si256( pixel, inside );
+        }
+
+        const __m128i words = _mm_packus_epi32( _mm256_castsi256_si128( pixel ), _mm256_extracti128_si256( pixel, 1 ) );
+        _mm_storel_epi64( (__m128i*)&pixels[ i ], _mm_packus_epi16( words, words ) );
+    }
+}
+
+__attribute__(( target( "avx2" ) ))
+static void resolveLayerAVX2( const LayerLine *layer, uint8_t layerId, const PPUWindowMask *hidden, uint8_t *bestDepth, uint8_t *colour, uint8_t *source ) {
+    const __m256i spread = _mm256_setr_epi8(
+        0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 1, 1, 1, 1,
+        2, 2, 2, 2, 2, 2, 2, 2, 3, 3, 3, 3, 3, 3, 3, 3 );
+    const __m256i bits = _mm256_set1_epi64x( (int64_t)0x8040201008040201ull );
+    const __m256i id = _mm256_set1_epi8( (char)layerId );
+    for ( uint16_t x = 0; x < SCREEN_WIDTH; x += 32 ) {
+        const uint32_t windowBits = (uint32_t)( hidden->bits[ x / 64 ] >> ( x % 64 ) );
+        const __m256i inside = _mm256_cmpeq_epi8(
+            _mm256_and_si256( _mm256_shuffle_epi8( _mm256_set1_epi32( (int)windowBits ), spread ), bits ), bits );
+        const __m256i depth = _mm256_andnot_si256( inside, _mm256_loadu_si256( (const __m256i*)&layer->depth[ x ] ) );
+        const __m256i best = _mm256_loadu_si256( (const __m256i*)&bestDepth[ x ] );
+        const __m256i closer = _mm256_cmpgt_epi8( depth, best );
+
+        _mm256_storeu_si256( (__m256i*)&bestDepth[ x ], _mm256_blendv_epi8( best, depth, closer ) );
+        _mm256_storeu_si256( (__m256i*)&colour[ x ], _mm256_blendv_epi8(
+            _mm256_loadu_si256( (const __m256i*)&colour[ x ] ), _mm256_loadu_si256( (const __m256i*)&layer->colour[ x ] ), closer ) );
+        _mm256_storeu_si256( (__m256i*)&source[ x ], _mm256_blendv_epi8( _mm256_loadu_si256( (const __m256i*)&source[ x ] ), id, closer ) );
+    }
+}
+
+__attribute__(( target( "avx2" ) ))
+static inline __m256i colourMathChannelAVX2( __m256i a, __m256i b, __m256i halve, bool subtract ) {
+    const __m256i result = subtract ? _mm256_subs_epu16( a, b ) : _mm256_add_epi16( a, b );
+    return _mm256_min_epu16( _mm256_blendv_epi8( result, _mm256_srli_epi16( result, 1 ), halve ), _mm256_set1_epi16( 0x1F ) );
+}
+
+// Sixteen pixels per vector
+__attribute__(( target( "avx2" ) ))
+static void colourMathAVX2( uint16_t *main, const uint16_t *sub, const uint8_t *math, const uint8_t *halve, bool subtract, uint16_t count ) {
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i channelMask = _mm256_set1_epi16( 0x1F );
+    uint16_t i = 0;
+    for ( ; i + 16 <= count; i += 16 ) {
+        const __m256i mathMask = _mm256_andnot_si256(
+            _mm256_cmpeq_epi16( _mm256_cvtepu8_epi16( _mm_loadu_si128( (const __m128i*)&math[ i ] ) ), zero ), _mm256_set1_epi16( -1 ) );
+        const __m256i halveMask = _mm256_andnot_si256(
+            _mm256_cmpeq_epi16( _mm256_cvtepu8_epi16( _mm_loadu_si128( (const __m128i*)&halve[ i ] ) ), zero ), _mm256_set1_epi16( -1 ) );
+        const __m256i a = _mm256_loadu_si256( (const __m256i*)&main[ i ] );
+        const __m256i b = _mm256_loadu_si256( (const __m256i*)&sub[ i ] );
+
+        __m256i result = colourMathChannelAVX2( _mm256_and_si256( a, channelMask ), _mm256_and_si256( b, channelMask ), halveMask, subtract );
+        result = _mm256_or_si256( result, _mm256_slli_epi16( colourMathChannelAVX2(
+            _mm256_and_si256( _mm256_srli_epi16( a, 5 ), channelMask ), _mm256_and_si256( _mm256_srli_epi16( b, 5 ), channelMask ), halveMask, subtract ), 5 ) );
+        result = _mm256_or_si256( result, _mm256_slli_epi16( colourMathChannelAVX2(
+            _mm256_and_si256( _mm256_srli_epi16( a, 10 ), channelMask ), _mm256_and_si256( _mm256_srli_epi16( b, 10 ), channelMask ), halveMask, subtract ), 10 ) );
+        _mm256_storeu_si256( (__m256i*)&main[ i ], _mm256_blendv_epi8( a, result, mathMask ) );
+    }
+    colourMathScalar( &main[ i ], &sub[ i ], &math[ i ], &halve[ i ], subtract, count - i );
+}
+
+static const PPUKernels avx2Kernels = {
+    .name = "AVX2",
+    .decodeTile = decodeTileAVX2,
+    .drawTileRows = drawTileRowsAVX2,
+    .drawMode7Line = drawMode7LineAVX2,
+    .resolveLayer = resolveLayerAVX2,
+    .colourMath = colourMathAVX2,
+};
+
+#pragma endregion
+
+#endif // PPU_X86_KERNELS
+
+const PPUKernels *ppuKernels = &scalarKernels;
+
+void ppuKernelsInitialise() {
+    ppuKernels = &scalarKernels;
+#ifdef PPU_X86_KERNELS
+    __builtin_cpu_init();
+    if ( __builtin_cpu_supports( "avx2" ) ) {
+        ppuKernels = &avx2Kernels;
+    }
+    else if ( __builtin_cpu_supports( "sse4.1" ) ) {
+        ppuKernels = &sse4Kernels;
+    }
+#endif
+}
@@ -0,0 +1,86 @@
+#include "ppu_internal.h"
+
+#include "pixel_convert.h"
+
+#include <memory.h>
+
+void ppuOutputInitialise( PPUOutput *output, Framebuffer *framebuffer, const PPUPalette *palette ) {
+    output->framebuffer = framebuffer;
+    output->palette = palette;
+    output->interlaced = false;
+    framebufferResize( framebuffer, SCREEN_WIDTH, SCREEN_HEIGHT );
+}
+
+// Double the first numRows rows to 512 wide, working backwards so no row is overwritten before it moves
+static void widenRows( Framebuffer *framebuffer, uint16_t numRows ) {
+    const uint32_t oldPitch = framebuffer->pitch;
+    framebufferResize( framebuffer, HIRES_WIDTH, framebuffer->height );
+
+    // Padded for scaleLineXRGB8888
+    uint32_t row[ SCREEN_WIDTH + 8 ];
+    for ( uint16_t y = numRows; y-- > 0; ) {
+        memcpy( row, framebuffer->pixels + (uint32_t)y * oldPitch, oldPitch );
+        uint8_t *destination = framebufferLine( framebuffer, y );
+        if ( framebuffer->format == FRAMEBUFFER_BGR555 ) {
+            doubleLineBGR555( (const uint16_t*)row, (uint16_t*)destination, SCREEN_WIDTH );
+        }
+        else {
+            scaleLineXRGB8888( row, (uint32_t*)destination, SCREEN_WIDTH, 2 );
+        }
+    }
+}
+
+// Repeat every row of a progressive frame for both fields
+static void deepenRows( Framebuffer *framebuffer ) {
+    const uint16_t numRows = framebuffer->height;
+    framebufferResize( framebuffer, framebuffer->width, INTERLACE_HEIGHT );
+    for ( uint16_t y = numRows; y-- > 0; ) {
+        const uint8_t *source = framebufferLine( framebuffer, y );
+        memmove( framebufferLine( framebuffer, y * 2 + 1 ), source, framebuffer->pitch );
+        memmove( framebufferLine( framebuffer, y * 2 ), source, framebuffer->pitch );
+    }
+}
+
+void ppuOutputPrepareLine( PPUOutput *output, uint16_t line, bool hiRes, bool interlaced ) {
+    Framebuffer *framebuffer = output->framebuffer;
+    if ( hiRes && framebuffer->width < HIRES_WIDTH ) {
+        // Rows of an interlaced frame past this line still show the other field
+        widenRows( framebuffer, framebuffer->height > SCREEN_HEIGHT ? framebuffer->height : line );
+    }
+    if ( interlaced ) {
+        if ( framebuffer->height < INTERLACE_HEIGHT ) {
+            deepenRows( framebuffer );
+        }
+        output->interlaced = true;
+    }
+}
+
+void ppuOutputLine( const PPUOutput *output, const uint16_t *colours, bool hiRes, uint16_t line, uint8_t field ) {
+    Framebuffer *framebuffer = output->framebuffer;
+    const uint16_t row = framebuffer->height > SCREEN_HEIGHT ? line * 2 + field : line;
+
+    // Converted aside, so a line that comes out the same as last frame's leaves the row clean
+    uint32_t converted[ HIRES_WIDTH ];
+    if ( framebuffer->width > SCREEN_WIDTH && !hiRes ) {
+        uint16_t doubled[ HIRES_WIDTH ];
+        doubleLineBGR555( colours, doubled, SCREEN_WIDTH );
+        ppuPaletteOutputLine( output->palette, doubled, HIRES_WIDTH, (uint8_t*)converted );
+    }
+    else {
+        ppuPaletteOutputLine( output->palette, colours, hiRes ? HIRES_WIDTH : SCREEN_WIDTH, (uint8_t*)converted );
+    }
+
+    uint8_t *destination = framebufferLine( framebuffer, row );
+    if ( memcmp( destination, converted, framebuffer->pitch ) != 0 ) {
+        memcpy( destination, converted, framebuffer->pitch );
+        framebufferMarkDirty( framebuffer, row );
+    }
+}
+
+void ppuOutputEndFrame( PPUOutput *output ) {
+    framebufferClearDirty( output->framebuffer );
+    if ( !output->interlaced ) {
+        framebufferResize( output->framebuffer, SCREEN_WIDTH, SCREEN_HEIGHT );
+    }
+    output->interlaced = false;
+}
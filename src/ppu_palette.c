@@ -0,0 +1,67 @@
+#include "ppu_internal.h"
+
+#include <memory.h>
+
+// Master brightness scales each channel by ( brightness + 1 ) / 16, with 0 being black
+static inline uint32_t applyBrightness( uint32_t channel, uint8_t brightness ) {
+    return brightness == 0 ? 0 : channel * ( brightness + 1u ) / 16u;
+}
+
+static void buildOutputTable( PPUPalette *palette ) {
+    const uint8_t brightness = palette->brightness;
+    for ( uint32_t colour = 0; colour < 0x8000; ++colour ) {
+        if ( palette->format == FRAMEBUFFER_BGR555 ) {
+            const uint32_t r = applyBrightness( colour & 0x1F, brightness );
+            const uint32_t g = applyBrightness( ( colour >> 5 ) & 0x1F, brightness );
+            const uint32_t b = applyBrightness( ( colour >> 10 ) & 0x1F, brightness );
+            palette->output[ colour ] = r | ( g << 5 ) | ( b << 10 );
+        }
+        else {
+            // Scale after widening to keep the extra precision
+            const uint32_t rgb = bgr555ToXRGB8888( (uint16_t)colour );
+            const uint32_t r = applyBrightness( ( rgb >> 16 ) & 0xFF, brightness );
+            const uint32_t g = applyBrightness( ( rgb >> 8 ) & 0xFF, brightness );
+            const uint32_t b = applyBrightness( rgb & 0xFF, brightness );
+            palette->output[ colour ] = ( r << 16 ) | ( g << 8 ) | b;
+        }
+    }
+}
+
+void ppuPaletteInitialise( PPUPalette *palette, FramebufferFormat format, uint8_t brightness ) {
+    memset( palette->colours, 0x00, sizeof( palette->colours ) );
+    palette->format = format;
+    palette->brightness = brightness & 0x0F;
+    buildOutputTable( palette );
+}
+
+void ppuPaletteUpdate( PPUPalette *palette, const uint8_t *CGRAM, uint8_t index ) {
+    const uint8_t *entry = &CGRAM[ index * 2 ];
+    palette->colours[ index ] = ( ( (uint16_t)entry[ 0 ] ) | ( ( (uint16_t)entry[ 1 ] ) << 8 ) ) & 0x7FFF;
+}
+
+void ppuPaletteSetBrightness( PPUPalette *palette, uint8_t brightness ) {
+    brightness &= 0x0F;
+    if ( brightness != palette->brightness ) {
+        palette->brightness = brightness;
+        buildOutputTable( palette );
+    }
+}
+
+void ppuPaletteOutputLine( const PPUPalette *palette, const uint16_t *colours, uint16_t count, uint8_t *destination ) {
+    switch ( palette->format ) {
+        case FRAMEBUFFER_BGR555: {
+            uint16_t *pixels = (uint16_t*)destination;
+            for ( uint16_t x = 0; x < count; ++x ) {
+                pixels[ x ] = (uint16_t)palette->output[ colours[ x ] & 0x7FFF ];
+            }
+            break;
+        }
+        case FRAMEBUFFER_XRGB8888: {
+            uint32_t *pixels = (uint32_t*)destination;
+            for ( uint16_t x = 0; x < count; ++x ) {
+                pixels[ x ] = palette->output[ colours[ x ] & 0x7FFF ];
+            }
+            break;
+        }
+    }
+}
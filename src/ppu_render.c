@@ -0,0 +1,503 @@
+#include "ppu_internal.h"
+
+#include "pixel_convert.h"
+
+#include <memory.h>
+#include <stdio.h>
+
+// Scanline renderer. Called once per visible line at the start of H-blank:
+// sprites are evaluated for the line, each enabled layer is drawn into its own
+// line buffer, then the layers are composited into the output line.
+
+#define MAX_SPRITES_PER_LINE 32
+#define MAX_SPRITE_SLIVERS_PER_LINE 34
+
+// A 512 pixel hi-res line plus the partial tile fine scroll exposes
+#define MAX_BG_TILE_ROWS ( SCREEN_WIDTH * 2 / 8 + 1 )
+
+#pragma region Layer ordering
+
+#define SLOT( layer, priority ) ( ( ( layer ) << 2 ) | ( priority ) )
+#define END_OF_ORDER 0xFF
+#define MODE_1_BG3_PRIORITY 8
+
+// Front to back layer order for each BG mode, plus mode 1 with the BG3 priority bit set
+static const uint8_t layerOrders[ 9 ][ 13 ] = {
+    { SLOT( LAYER_OBJ, 3 ), SLOT( LAYER_BG1, 1 ), SLOT( LAYER_BG2, 1 ), SLOT( LAYER_OBJ, 2 ), SLOT( LAYER_BG1, 0 ), SLOT( LAYER_BG2, 0 ),
+      SLOT( LAYER_OBJ, 1 ), SLOT( LAYER_BG3, 1 ), SLOT( LAYER_BG4, 1 ), SLOT( LAYER_OBJ, 0 ), SLOT( LAYER_BG3, 0 ), SLOT( LAYER_BG4, 0 ), END_OF_ORDER },
+    { SLOT( LAYER_OBJ, 3 ), SLOT( LAYER_BG1, 1 ), SLOT( LAYER_BG2, 1 ), SLOT( LAYER_OBJ, 2 ), SLOT( LAYER_BG1, 0 ), SLOT( LAYER_BG2, 0 ),
+      SLOT( LAYER_OBJ, 1 ), SLOT( LAYER_BG3, 1 ), SLOT( LAYER_OBJ, 0 ), SLOT( LAYER_BG3, 0 ), END_OF_ORDER },
+    { SLOT( LAYER_OBJ, 3 ), SLOT( LAYER_BG1, 1 ), SLOT( LAYER_OBJ, 2 ), SLOT( LAYER_BG2, 1 ), SLOT( LAYER_OBJ, 1 ), SLOT( LAYER_BG1, 0 ),
+      SLOT( LAYER_OBJ, 0 ), SLOT( LAYER_BG2, 0 ), END_OF_ORDER },
+    { SLOT( LAYER_OBJ, 3 ), SLOT( LAYER_BG1, 1 ), SLOT( LAYER_OBJ, 2 ), SLOT( LAYER_BG2, 1 ), SLOT( LAYER_OBJ, 1 ), SLOT( LAYER_BG1, 0 ),
+      SLOT( LAYER_OBJ, 0 ), SLOT( LAYER_BG2, 0 ), END_OF_ORDER },
+    { SLOT( LAYER_OBJ, 3 ), SLOT( LAYER_BG1, 1 ), SLOT( LAYER_OBJ, 2 ), SLOT( LAYER_BG2, 1 ), SLOT( LAYER_OBJ, 1 ), SLOT( LAYER_BG1, 0 ),
+      SLOT( LAYER_OBJ, 0 ), SLOT( LAYER_BG2, 0 ), END_OF_ORDER },
+    { SLOT( LAYER_OBJ, 3 ), SLOT( LAYER_BG1, 1 ), SLOT( LAYER_OBJ, 2 ), SLOT( LAYER_BG2, 1 ), SLOT( LAYER_OBJ, 1 ), SLOT( LAYER_BG1, 0 ),
+      SLOT( LAYER_OBJ, 0 ), SLOT( LAYER_BG2, 0 ), END_OF_ORDER },
+    { SLOT( LAYER_OBJ, 3 ), SLOT( LAYER_BG1, 1 ), SLOT( LAYER_OBJ, 2 ), SLOT( LAYER_OBJ, 1 ), SLOT( LAYER_BG1, 0 ), SLOT( LAYER_OBJ, 0 ),
+      END_OF_ORDER },
+    { SLOT( LAYER_OBJ, 3 ), SLOT( LAYER_OBJ, 2 ), SLOT( LAYER_BG2, 1 ), SLOT( LAYER_OBJ, 1 ), SLOT( LAYER_BG1, 0 ), SLOT( LAYER_OBJ, 0 ),
+      SLOT( LAYER_BG2, 0 ), END_OF_ORDER },
+    { SLOT( LAYER_BG3, 1 ), SLOT( LAYER_OBJ, 3 ), SLOT( LAYER_BG1, 1 ), SLOT( LAYER_BG2, 1 ), SLOT( LAYER_OBJ, 2 ), SLOT( LAYER_BG1, 0 ),
+      SLOT( LAYER_BG2, 0 ), SLOT( LAYER_OBJ, 1 ), SLOT( LAYER_OBJ, 0 ), SLOT( LAYER_BG3, 0 ), END_OF_ORDER },
+};
+
+// Depth of each layer/priority pair, built from layerOrders
+static uint8_t layerDepths[ 9 ][ NUM_LAYERS ][ 4 ];
+
+// Bits per pixel of BG1-BG4 in each mode, 0 where the layer doesn't exist
+static const uint8_t bgBitDepths[ 8 ][ 4 ] = {
+    { 2, 2, 2, 2 },
+    { 4, 4, 2, 0 },
+    { 4, 4, 0, 0 },
+    { 8, 4, 0, 0 },
+    { 8, 2, 0, 0 },
+    { 4, 2, 0, 0 },
+    { 4, 0, 0, 0 },
+    { 8, 0, 0, 0 },
+};
+
+void ppuRenderInitialise() {
+    memset( layerDepths, 0x00, sizeof( layerDepths ) );
+    for ( uint8_t order = 0; order < 9; ++order ) {
+        uint8_t numSlots = 0;
+        while ( layerOrders[ order ][ numSlots ] != END_OF_ORDER ) {
+            ++numSlots;
+        }
+        for ( uint8_t slot = 0; slot < numSlots; ++slot ) {
+            const uint8_t entry = layerOrders[ order ][ slot ];
+            layerDepths[ order ][ entry >> 2 ][ entry & 0x03 ] = numSlots - slot;
+        }
+    }
+}
+
+#pragma endregion
+
+#pragma region Tiles
+
+// One 8 pixel row of the tile at VRAM byte address, from the tile cache
+static inline void fetchSliver( const PPURenderContext *context, uint32_t address, uint8_t bitDepth, uint8_t row, bool hFlip, uint8_t *pixels ) {
+    const uint8_t *source = ppuTileCacheGet( context->tileCache, context->VRAM, bitDepth, address ) + row * 8;
+    if ( hFlip ) {
+        for ( uint8_t i = 0; i < 8; ++i ) {
+            pixels[ i ] = source[ 7 - i ];
+        }
+    }
+    else {
+        memcpy( pixels, source, 8 );
+    }
+}
+
+#pragma endregion
+
+#pragma region Backgrounds
+
+static inline uint32_t tilemapEntryAddress( uint32_t screenBase, bool wide, bool tall, uint16_t tileX, uint16_t tileY ) {
+    uint32_t address = screenBase + ( ( tileY & 0x1F ) << 6 ) + ( ( tileX & 0x1F ) << 1 );
+    if ( ( tileX & 0x20 ) && wide ) {
+        address += 0x800;
+    }
+    if ( ( tileY & 0x20 ) && tall ) {
+        address += wide ? 0x1000 : 0x800;
+    }
+    return address & 0xFFFF;
+}
+
+// The tilemap entry of the tile under pixel x, y of a BG's tilemap
+static uint16_t bgTilemapEntry( const PPURenderContext *context, uint8_t bg, uint16_t x, uint16_t y ) {
+    const Ports *ports = context->ports;
+    const uint8_t screenSelect = ( &ports->BG1SC )[ bg ];
+    const uint32_t screenBase = ( ( (uint32_t)screenSelect >> 2 ) & 0x3F ) << 11;
+    const uint8_t mode = ports->BGMODE & 0x07;
+    const bool largeTiles = ports->BGMODE & ( 0x10 << bg );
+    const uint16_t tileWidth = ( largeTiles || mode == 5 || mode == 6 ) ? 16 : 8;
+    const uint16_t tileHeight = largeTiles ? 16 : 8;
+
+    const uint32_t address = tilemapEntryAddress( screenBase, screenSelect & 0x01, screenSelect & 0x02, ( x & 0x3FF ) / tileWidth,
+                                                  ( y & 0x3FF ) / tileHeight );
+    return ( (uint16_t)context->VRAM[ address ] ) | ( ( (uint16_t)context->VRAM[ ( address + 1 ) & 0xFFFF ] ) << 8 );
+}
+
+// In modes 5 and 6 the layer is 512 wide: the odd pixels go to layer, for the
+// main screen, and the even ones to hiResLayer, for the sub screen.
+static void renderBGLine( const PPURenderContext *context, uint8_t bg, uint8_t bitDepth, uint16_t line, const uint8_t *depths,
+                          LayerLine *layer, LayerLine *hiResLayer ) {
+    const Ports *ports = context->ports;
+    const uint8_t *VRAM = context->VRAM;
+
+    const uint8_t screenSelect = ( &ports->BG1SC )[ bg ];
+    const uint32_t screenBase = ( ( (uint32_t)screenSelect >> 2 ) & 0x3F ) << 11;
+    const bool wide = screenSelect & 0x01;
+    const bool tall = screenSelect & 0x02;
+
+    const uint8_t nameSelect = bg < 2 ? ports->BG12NBA : ports->BG34NBA;
+    const uint32_t charBase = ( (uint32_t)( nameSelect >> ( ( bg & 0x01 ) * 4 ) ) & 0x0F ) << 13;
+    const uint8_t tileBytes = bitDepth * 8;
+
+    const uint8_t mode = ports->BGMODE & 0x07;
+    const bool hiRes = mode == 5 || mode == 6;
+    const bool largeTiles = ports->BGMODE & ( 0x10 << bg );
+    const uint16_t tileWidth = ( largeTiles || hiRes ) ? 16 : 8;
+    const uint16_t tileHeight = largeTiles ? 16 : 8;
+
+    const uint8_t paletteBase = mode == 0 ? bg * 32 : 0;
+    const uint8_t paletteShift = bitDepth == 2 ? 2 : 4;
+
+    // TODO - Mosaic
+    // Interlaced hi-res fields each show every other line of a 448 line picture
+    const uint16_t fieldLine = ( hiRes && ppuLineIsInterlaced( ports ) ) ? line * 2 + context->field : line;
+    const uint16_t lineY = ( fieldLine + context->registers->bgVOffset[ bg ] ) & 0x3FF;
+    const uint16_t hOffset = context->registers->bgHOffset[ bg ];
+    const uint8_t fineScroll = hOffset & 0x07;
+    const uint16_t lineWidth = hiRes ? SCREEN_WIDTH * 2 : SCREEN_WIDTH;
+
+    // In modes 2, 4 and 6 the first two rows of BG3's tilemap replace BG1 and BG2's
+    // scroll for each column after the first. Mode 4 has only the first row, where
+    // bit 15 of an entry picks vertical or horizontal.
+    const bool offsetPerTile = bg < 2 && ( mode == 2 || mode == 4 || mode == 6 );
+    const uint16_t offsetValid = 0x2000 << bg;
+    const uint16_t offsetHOffset = context->registers->bgHOffset[ 2 ] & ~0x07;
+    const uint16_t offsetVOffset = context->registers->bgVOffset[ 2 ];
+
+    const bool directColour = bg == 0 && ppuDirectColour( ports );
+    uint8_t directPalettes[ MAX_BG_TILE_ROWS ];
+
+    // Gather every tile row the line touches, then expand them all at once
+    PPUTileRow rows[ MAX_BG_TILE_ROWS ];
+    const uint16_t numRows = lineWidth / 8 + 1;
+    for ( uint16_t r = 0; r < numRows; ++r ) {
+        uint16_t screenX = ( ( hOffset & ~0x07 ) + r * 8 ) & 0x3FF;
+        uint16_t y = lineY;
+
+        if ( offsetPerTile && r > 0 ) {
+            const uint16_t lookupX = offsetHOffset + ( r - 1 ) * 8;
+            uint16_t hLookup = bgTilemapEntry( context, 2, lookupX, offsetVOffset );
+            uint16_t vLookup = mode == 4 ? 0 : bgTilemapEntry( context, 2, lookupX, offsetVOffset + 8 );
+            if ( mode == 4 && ( hLookup & 0x8000 ) ) {
+                vLookup = hLookup;
+                hLookup = 0;
+            }
+            if ( hLookup & offsetValid ) {
+                screenX = ( ( hLookup & 0x3F8 ) + r * 8 ) & 0x3FF;
+            }
+            if ( vLookup & offsetValid ) {
+                y = ( fieldLine + vLookup ) & 0x3FF;
+            }
+        }
+
+        const uint32_t entryAddress = tilemapEntryAddress( screenBase, wide, tall, screenX / tileWidth, y / tileHeight );
+        const uint16_t entry = ( (uint16_t)VRAM[ entryAddress ] ) | ( ( (uint16_t)VRAM[ ( entryAddress + 1 ) & 0xFFFF ] ) << 8 );
+        uint16_t tile = entry & 0x3FF;
+        const uint8_t palette = ( entry >> 10 ) & 0x07;
+        const uint8_t priority = ( entry >> 13 ) & 0x01;
+        const bool hFlip = entry & 0x4000;
+        const bool vFlip = entry & 0x8000;
+
+        uint16_t fineX = screenX % tileWidth;
+        uint16_t fineY = y % tileHeight;
+        if ( hFlip ) {
+            fineX = tileWidth - 1 - fineX;
+        }
+        if ( vFlip ) {
+            fineY = tileHeight - 1 - fineY;
+        }
+        tile += ( fineX >> 3 ) + ( ( fineY >> 3 ) << 4 );
+
+        const uint32_t address = charBase + ( tile & 0x3FF ) * tileBytes;
+        rows[ r ].pixels = ppuTileCacheGet( context->tileCache, VRAM, bitDepth, address ) + ( fineY & 0x07 ) * 8;
+        rows[ r ].colourBase = bitDepth == 8 ? 0 : paletteBase + ( palette << paletteShift );
+        directPalettes[ r ] = palette;
+        rows[ r ].depth = depths[ priority ];
+        rows[ r ].hFlip = hFlip;
+    }
+
+    uint8_t colour[ MAX_BG_TILE_ROWS * 8 ];
+    uint8_t depth[ MAX_BG_TILE_ROWS * 8 ];
+    ppuKernels->drawTileRows( rows, numRows, colour, depth );
+
+    if ( hiRes ) {
+        for ( uint16_t x = 0; x < SCREEN_WIDTH; ++x ) {
+            hiResLayer->colour[ x ] = colour[ fineScroll + x * 2 ];
+            hiResLayer->depth[ x ] = depth[ fineScroll + x * 2 ];
+            layer->colour[ x ] = colour[ fineScroll + x * 2 + 1 ];
+            layer->depth[ x ] = depth[ fineScroll + x * 2 + 1 ];
+        }
+    }
+    else {
+        memcpy( layer->colour, &colour[ fineScroll ], SCREEN_WIDTH );
+        memcpy( layer->depth, &depth[ fineScroll ], SCREEN_WIDTH );
+    }
+
+    if ( directColour ) {
+        for ( uint16_t x = 0; x < SCREEN_WIDTH; ++x ) {
+            layer->directPalette[ x ] = directPalettes[ ( fineScroll + x ) >> 3 ];
+        }
+    }
+}
+
+#pragma endregion
+
+#pragma region Mode 7
+
+// Offsets from the centre wrap into -1024..1023
+static inline int32_t mode7Clip( int32_t value ) {
+    return ( value & 0x2000 ) ? ( value | ~0x3FF ) : ( value & 0x3FF );
+}
+
+// The affine start point is worked out once per line, then the kernel walks
+// across the line with fixed point adds. Matrix changes from HDMA land
+// between lines, so each line picks them up here.
+static void renderMode7Line( const PPURenderContext *context, uint16_t line, uint8_t *pixels ) {
+    const PPURenderRegisters *registers = context->registers;
+    const uint8_t select = context->ports->M7SEL;
+    const bool hFlip = select & 0x01;
+    const bool vFlip = select & 0x02;
+
+    const int32_t a = registers->m7Matrix[ 0 ];
+    const int32_t b = registers->m7Matrix[ 1 ];
+    const int32_t c = registers->m7Matrix[ 2 ];
+    const int32_t d = registers->m7Matrix[ 3 ];
+    const int32_t centreX = registers->m7CentreX;
+    const int32_t centreY = registers->m7CentreY;
+    const int32_t offsetX = mode7Clip( registers->m7HOffset - centreX );
+    const int32_t offsetY = mode7Clip( registers->m7VOffset - centreY );
+    const int32_t screenY = vFlip ? 255 - line : line;
+
+    // Products are truncated to 1/4 pixel like the hardware's multiplier
+    PPUMode7Line walk;
+    walk.startX = ( ( a * offsetX ) & ~63 ) + ( ( b * offsetY ) & ~63 ) + ( ( b * screenY ) & ~63 ) + centreX * 256;
+    walk.startY = ( ( c * offsetX ) & ~63 ) + ( ( d * offsetY ) & ~63 ) + ( ( d * screenY ) & ~63 ) + centreY * 256;
+    walk.stepX = a;
+    walk.stepY = c;
+    if ( hFlip ) {
+        walk.startX += a * 255;
+        walk.startY += c * 255;
+        walk.stepX = -a;
+        walk.stepY = -c;
+    }
+    walk.screenOver = ( select >> 6 ) & 0x03;
+
+    // TODO - Mosaic
+    ppuKernels->drawMode7Line( &walk, context->VRAM, pixels );
+}
+
+#pragma endregion
+
+#pragma region Sprites
+
+// Range evaluation: the first 32 sprites on the line, in priority order
+static uint8_t evaluateSpriteRange( const PPURenderContext *context, uint16_t line, const PPUSprite **inRange, uint8_t *numInRange ) {
+    const Ports *ports = context->ports;
+
+    // Priority rotation picks which sprite is evaluated first
+    const uint8_t firstSprite = ( ports->OAMADDH & 0x80 ) ? ( ports->OAMADDL >> 1 ) & 0x7F : 0;
+
+    uint8_t onLine[ NUM_SPRITES ];
+    const uint8_t numOnLine = ppuSpritesOnLine( context->sprites, (uint8_t)line, firstSprite, onLine );
+    *numInRange = 0;
+    for ( uint8_t i = 0; i < numOnLine; ++i ) {
+        const PPUSprite *sprite = &context->sprites->sprites[ onLine[ i ] ];
+        if ( sprite->x <= -sprite->width ) {
+            continue;
+        }
+        if ( *numInRange == MAX_SPRITES_PER_LINE ) {
+            return STAT77_RANGE_OVER;
+        }
+        inRange[ ( *numInRange )++ ] = sprite;
+    }
+    return 0x00;
+}
+
+static uint8_t renderSpriteLine( const PPURenderContext *context, uint16_t line, const uint8_t *depths, LayerLine *layer ) {
+    const Ports *ports = context->ports;
+    const uint32_t nameBase = ( (uint32_t)ports->OBSEL & 0x07 ) << 14;
+    const uint32_t nameGap = ( ( ( (uint32_t)ports->OBSEL >> 3 ) & 0x03 ) + 1 ) << 13;
+
+    const PPUSprite *inRange[ MAX_SPRITES_PER_LINE ];
+    uint8_t numInRange;
+    uint8_t flags = evaluateSpriteRange( context, line, inRange, &numInRange );
+
+    // Time evaluation: tiles are fetched from the last sprite in range to the
+    // first, 34 slivers at most. Earlier sprites are drawn later so they win
+    // wherever sprites overlap.
+    uint8_t numSlivers = 0;
+    for ( int8_t i = numInRange - 1; i >= 0 && !( flags & STAT77_TIME_OVER ); --i ) {
+        const PPUSprite *sprite = inRange[ i ];
+        const uint8_t columns = sprite->width / 8;
+
+        uint8_t row = (uint8_t)( line - sprite->y );
+        if ( sprite->vFlip ) {
+            row = sprite->height - 1 - row;
+        }
+
+        const uint16_t colour = 128 + sprite->palette * 16;
+        const uint8_t depth = depths[ sprite->priority ];
+
+        for ( uint8_t column = 0; column < columns; ++column ) {
+            const int16_t sliverX = sprite->x + column * 8;
+            if ( sliverX <= -8 || sliverX >= SCREEN_WIDTH ) {
+                continue;
+            }
+            if ( ++numSlivers > MAX_SPRITE_SLIVERS_PER_LINE ) {
+                flags |= STAT77_TIME_OVER;
+                break;
+            }
+
+            // Sprite tiles are laid out in a 16x16 grid that wraps within its page
+            const uint8_t tileColumn = sprite->hFlip ? columns - 1 - column : column;
+            const uint16_t tile = ( sprite->tile & 0x100 )
+                | ( ( sprite->tile + ( row >> 3 ) * 16 ) & 0xF0 )
+                | ( ( sprite->tile + tileColumn ) & 0x0F );
+            const uint32_t address = nameBase + ( tile & 0xFF ) * 32 + ( ( tile & 0x100 ) ? nameGap : 0 );
+
+            uint8_t pixels[ 8 ];
+            fetchSliver( context, address, 4, row & 0x07, sprite->hFlip, pixels );
+
+            for ( uint8_t p = 0; p < 8; ++p ) {
+                const int16_t x = sliverX + p;
+                if ( x < 0 || x >= SCREEN_WIDTH || !pixels[ p ] ) {
+                    continue;
+                }
+                layer->colour[ x ] = (uint8_t)( colour + pixels[ p ] );
+                layer->depth[ x ] = depth;
+            }
+        }
+    }
+
+    return flags;
+}
+
+uint8_t ppuEvaluateSpriteFlags( const PPURenderContext *context, uint16_t line ) {
+    const Ports *ports = context->ports;
+    if ( ( ports->INIDISP & 0x80 ) || !( ( ports->TM | ports->TS ) & ( 1 << LAYER_OBJ ) ) ) {
+        return 0x00;
+    }
+
+    const PPUSprite *inRange[ MAX_SPRITES_PER_LINE ];
+    uint8_t numInRange;
+    uint8_t flags = evaluateSpriteRange( context, line, inRange, &numInRange );
+
+    // Same sliver count as renderSpriteLine, without the fetches
+    uint16_t numSlivers = 0;
+    for ( uint8_t i = 0; i < numInRange; ++i ) {
+        for ( uint8_t column = 0; column < inRange[ i ]->width / 8; ++column ) {
+            const int16_t sliverX = inRange[ i ]->x + column * 8;
+            if ( sliverX > -8 && sliverX < SCREEN_WIDTH ) {
+                ++numSlivers;
+            }
+        }
+    }
+    if ( numSlivers > MAX_SPRITE_SLIVERS_PER_LINE ) {
+        flags |= STAT77_TIME_OVER;
+    }
+    return flags;
+}
+
+#pragma endregion
+
+static inline bool layerExists( const Ports *ports, uint8_t layer ) {
+    const uint8_t mode = ports->BGMODE & 0x07;
+    if ( layer == LAYER_OBJ ) {
+        return true;
+    }
+    if ( mode == 7 && layer == LAYER_BG2 ) {
+        return ports->SETINI & 0x40;
+    }
+    return bgBitDepths[ mode ][ layer ] != 0;
+}
+
+uint8_t ppuRenderScanline( const PPURenderContext *context, uint16_t line, uint16_t *output ) {
+    const Ports *ports = context->ports;
+
+    if ( ports->INIDISP & 0x80 ) {
+        // F-blank
+        memset( output, 0x00, SCREEN_WIDTH * sizeof( uint16_t ) );
+        return 0x00;
+    }
+
+    const uint8_t mode = ports->BGMODE & 0x07;
+    const uint8_t order = ( mode == 1 && ( ports->BGMODE & 0x08 ) ) ? MODE_1_BG3_PRIORITY : mode;
+    const uint8_t enabled = ports->TM | ports->TS;
+
+    // With hi-res, each output pixel pair is a sub screen pixel then a main screen
+    // pixel. Only modes 5 and 6 draw different BG pixels for the two.
+    const bool hiRes = ppuLineIsHiRes( ports );
+    const bool hiResBGs = mode == 5 || mode == 6;
+    LayerLine layers[ NUM_LAYERS ];
+    LayerLine hiResLayers[ NUM_LAYERS ];
+    uint8_t flags = 0x00;
+
+    if ( mode == 7 ) {
+        // BG1 is the playfield, EXTBG adds BG2 with bit 7 of each pixel as its priority
+        if ( enabled & ( ( 1 << LAYER_BG1 ) | ( 1 << LAYER_BG2 ) ) ) {
+            uint8_t pixels[ SCREEN_WIDTH ];
+            renderMode7Line( context, line, pixels );
+
+            if ( enabled & ( 1 << LAYER_BG1 ) ) {
+                const uint8_t depth = layerDepths[ order ][ LAYER_BG1 ][ 0 ];
+                for ( uint16_t x = 0; x < SCREEN_WIDTH; ++x ) {
+                    layers[ LAYER_BG1 ].colour[ x ] = pixels[ x ];
+                    layers[ LAYER_BG1 ].depth[ x ] = pixels[ x ] ? depth : 0;
+                }
+                // Mode 7 tiles have no palette bits
+                if ( ppuDirectColour( ports ) ) {
+                    memset( layers[ LAYER_BG1 ].directPalette, 0x00, SCREEN_WIDTH );
+                }
+            }
+            if ( ( enabled & ( 1 << LAYER_BG2 ) ) && layerExists( ports, LAYER_BG2 ) ) {
+                const uint8_t *depths = layerDepths[ order ][ LAYER_BG2 ];
+                for ( uint16_t x = 0; x < SCREEN_WIDTH; ++x ) {
+                    const uint8_t colour = pixels[ x ] & 0x7F;
+                    layers[ LAYER_BG2 ].colour[ x ] = colour;
+                    layers[ LAYER_BG2 ].depth[ x ] = colour ? depths[ pixels[ x ] >> 7 ] : 0;
+                }
+            }
+        }
+    }
+    else {
+        for ( uint8_t bg = 0; bg < 4; ++bg ) {
+            if ( ( enabled & ( 1 << bg ) ) && layerExists( ports, bg ) ) {
+                renderBGLine( context, bg, bgBitDepths[ mode ][ bg ], line, layerDepths[ order ][ bg ], &layers[ bg ], &hiResLayers[ bg ] );
+            }
+        }
+    }
+
+    if ( enabled & ( 1 << LAYER_OBJ ) ) {
+        memset( layers[ LAYER_OBJ ].depth, 0x00, SCREEN_WIDTH );
+        flags |= renderSpriteLine( context, line, layerDepths[ order ][ LAYER_OBJ ], &layers[ LAYER_OBJ ] );
+    }
+
+    uint8_t rendered = 0x00;
+    for ( uint8_t l = 0; l < NUM_LAYERS; ++l ) {
+        if ( ( enabled & ( 1 << l ) ) && layerExists( ports, l ) ) {
+            rendered |= 1 << l;
+        }
+    }
+    if ( !hiRes ) {
+        ppuComposeLine( context, layers, ports->TM & rendered, ports->TS & rendered, output );
+        return flags;
+    }
+
+    for ( uint8_t l = 0; l < NUM_LAYERS; ++l ) {
+        if ( ( rendered & ( 1 << l ) ) && !( hiResBGs && l < LAYER_OBJ ) ) {
+            hiResLayers[ l ] = layers[ l ];
+        }
+    }
+
+    uint16_t mainLine[ SCREEN_WIDTH ];
+    ppuComposeLine( context, layers, ports->TM & rendered, ports->TS & rendered, mainLine );
+
+    // The sub screen pixels are composed as a main screen of their own, with its
+    // windows, and without colour math or clipping
+    Ports subPorts = *ports;
+    subPorts.TMW = ports->TSW;
+    subPorts.CGWSEL = ( ports->CGWSEL & 0x0F ) | 0x30;
+    PPURenderContext subContext = *context;
+    subContext.ports = &subPorts;
+    uint16_t subLine[ SCREEN_WIDTH ];
+    ppuComposeLine( &subContext, hiResLayers, ports->TS & rendered, 0x00, subLine );
+
+    interleaveLinesBGR555( subLine, mainLine, output, SCREEN_WIDTH );
+    return flags;
+}
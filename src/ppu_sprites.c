@@ -0,0 +1,99 @@
+#include "ppu_internal.h"
+
+#include <memory.h>
+
+// OBSEL size select -> { small, large } x { width, height }
+static const uint8_t spriteSizes[ 8 ][ 2 ][ 2 ] = {
+    { { 8, 8 }, { 16, 16 } },
+    { { 8, 8 }, { 32, 32 } },
+    { { 8, 8 }, { 64, 64 } },
+    { { 16, 16 }, { 32, 32 } },
+    { { 16, 16 }, { 64, 64 } },
+    { { 32, 32 }, { 64, 64 } },
+    { { 16, 32 }, { 32, 64 } },
+    { { 16, 32 }, { 32, 32 } },
+};
+
+// Add or remove a sprite from the bins of every Y position it covers, wrapping at 256
+static void binSprite( PPUSpriteTable *table, uint8_t index, bool set ) {
+    const PPUSprite *sprite = &table->sprites[ index ];
+    const uint64_t bit = 1ull << ( index % 64 );
+    for ( uint8_t row = 0; row < sprite->height; ++row ) {
+        uint64_t *bin = &table->lines[ (uint8_t)( sprite->y + row ) ][ index / 64 ];
+        *bin = set ? ( *bin | bit ) : ( *bin & ~bit );
+    }
+}
+
+static void decodeSprite( PPUSpriteTable *table, const uint8_t *OAMRAM, uint8_t index ) {
+    PPUSprite *sprite = &table->sprites[ index ];
+    const uint8_t *entry = &OAMRAM[ index * 4 ];
+    const uint8_t extra = ( OAMRAM[ 0x200 + ( index / 4 ) ] >> ( ( index % 4 ) * 2 ) ) & 0x03;
+    const uint16_t x = ( (uint16_t)entry[ 0 ] ) | ( ( (uint16_t)extra & 0x01 ) << 8 );
+
+    sprite->x = x >= 256 ? (int16_t)x - 512 : (int16_t)x;
+    sprite->y = entry[ 1 ];
+    sprite->tile = ( (uint16_t)entry[ 2 ] ) | ( ( (uint16_t)entry[ 3 ] & 0x01 ) << 8 );
+    sprite->palette = ( entry[ 3 ] >> 1 ) & 0x07;
+    sprite->priority = ( entry[ 3 ] >> 4 ) & 0x03;
+    sprite->hFlip = entry[ 3 ] & 0x40;
+    sprite->vFlip = entry[ 3 ] & 0x80;
+    sprite->large = extra & 0x02;
+    sprite->width = spriteSizes[ table->sizeSelect ][ sprite->large ][ 0 ];
+    sprite->height = spriteSizes[ table->sizeSelect ][ sprite->large ][ 1 ];
+}
+
+static void rebuild( PPUSpriteTable *table, const uint8_t *OAMRAM ) {
+    memset( table->lines, 0x00, sizeof( table->lines ) );
+    for ( uint8_t i = 0; i < NUM_SPRITES; ++i ) {
+        decodeSprite( table, OAMRAM, i );
+        binSprite( table, i, true );
+    }
+}
+
+void ppuSpriteTableInitialise( PPUSpriteTable *table, const uint8_t *OAMRAM, uint8_t OBSEL ) {
+    table->sizeSelect = ( OBSEL >> 5 ) & 0x07;
+    rebuild( table, OAMRAM );
+}
+
+void ppuSpriteTableUpdate( PPUSpriteTable *table, const uint8_t *OAMRAM, uint16_t byteAddress ) {
+    // A low table byte belongs to one sprite, a high table byte to four
+    const uint8_t first = byteAddress < 0x200 ? byteAddress / 4 : ( byteAddress & 0x1F ) * 4;
+    const uint8_t count = byteAddress < 0x200 ? 1 : 4;
+    for ( uint8_t i = first; i < first + count; ++i ) {
+        binSprite( table, i, false );
+        decodeSprite( table, OAMRAM, i );
+        binSprite( table, i, true );
+    }
+}
+
+void ppuSpriteTableSetSize( PPUSpriteTable *table, const uint8_t *OAMRAM, uint8_t OBSEL ) {
+    const uint8_t sizeSelect = ( OBSEL >> 5 ) & 0x07;
+    if ( sizeSelect != table->sizeSelect ) {
+        table->sizeSelect = sizeSelect;
+        rebuild( table, OAMRAM );
+    }
+}
+
+uint8_t ppuSpritesOnLine( const PPUSpriteTable *table, uint8_t line, uint8_t first, uint8_t *indices ) {
+    const uint64_t *bin = table->lines[ line ];
+    uint8_t count = 0;
+    // first to the end of OAM, then wrap around to first
+    for ( uint8_t pass = 0; pass < 2; ++pass ) {
+        const uint16_t begin = pass == 0 ? first : 0;
+        const uint16_t end = pass == 0 ? NUM_SPRITES : first;
+        for ( uint16_t word = begin / 64; word < NUM_SPRITES / 64 && word * 64 < end; ++word ) {
+            uint64_t bits = bin[ word ];
+            if ( begin > word * 64 ) {
+                bits &= ~0ull << ( begin - word * 64 );
+            }
+            if ( end < word * 64 + 64 ) {
+                bits &= ( 1ull << ( end - word * 64 ) ) - 1;
+            }
+            while ( bits ) {
+                indices[ count++ ] = (uint8_t)( word * 64 + __builtin_ctzll( bits ) );
+                bits &= bits - 1;
+            }
+        }
+    }
+    return count;
+}
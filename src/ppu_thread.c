@@ -0,0 +1,203 @@
+#include "display.h"
+#include "ppu_internal.h"
+
+#include <memory.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+// Single producer, single consumer ring. The emulation thread only moves head,
+// the render thread only moves tail.
+#define LOG_SIZE ( 1 << 16 )
+#define LOG_MASK ( LOG_SIZE - 1 )
+
+// How many frames the emulation may run ahead of the renderer
+#define MAX_FRAMES_AHEAD 1
+
+typedef struct RenderThreadState {
+    Ports ports;
+    PPURenderRegisters registers;
+    uint8_t VRAM[ VRAM_SIZE ];
+    uint8_t CGRAM[ CGRAM_SIZE ];
+    uint8_t OAMRAM[ OAMRAM_SIZE ];
+    PPUPalette palette;
+    PPUSpriteTable spriteTable;
+    PPUTileCache tileCache;
+    uint16_t lineBuffer[ HIRES_WIDTH ];
+    Framebuffer *framebuffer;
+    PPUOutput output;
+    uint64_t frameNumber;
+    uint8_t stat77;
+} RenderThreadState;
+
+static RenderThreadState renderState;
+
+static PPULogEntry logEntries[ LOG_SIZE ];
+static _Atomic uint32_t logHead;
+static _Atomic uint32_t logTail;
+static _Atomic uint64_t framesReplayed;
+static uint64_t framesLogged;
+static _Atomic bool running;
+static pthread_t thread;
+
+static void renderLine( uint16_t line, bool draw ) {
+    RenderThreadState *state = &renderState;
+    const uint8_t field = state->frameNumber & 1;
+    const PPURenderContext context = {
+        &state->ports, &state->registers, state->VRAM, state->CGRAM, state->palette.colours,
+        state->OAMRAM, &state->spriteTable, &state->tileCache, field
+    };
+    if ( !draw ) {
+        state->stat77 |= ppuEvaluateSpriteFlags( &context, line );
+        return;
+    }
+    const bool hiRes = ppuLineIsHiRes( &state->ports );
+    ppuOutputPrepareLine( &state->output, line, hiRes, ppuLineIsInterlaced( &state->ports ) );
+    state->stat77 |= ppuRenderScanline( &context, line, state->lineBuffer );
+    ppuOutputLine( &state->output, state->lineBuffer, hiRes, line, field );
+}
+
+// Mirrors the derived state updates ppu.c makes for the same writes
+static void replay( const PPULogEntry *entry ) {
+    RenderThreadState *state = &renderState;
+    switch ( (PPULogKind)entry->kind ) {
+        case PPU_LOG_PORT:
+            ( (uint8_t*)&state->ports )[ entry->address ] = (uint8_t)entry->value;
+            if ( entry->address == 0x00 ) {
+                ppuPaletteSetBrightness( &state->palette, entry->value & 0x0F );
+            }
+            else if ( entry->address == 0x01 ) {
+                ppuSpriteTableSetSize( &state->spriteTable, state->OAMRAM, (uint8_t)entry->value );
+            }
+            break;
+        case PPU_LOG_REGISTER:
+            ( (uint16_t*)&state->registers )[ entry->address ] = entry->value;
+            break;
+        case PPU_LOG_VRAM:
+            state->VRAM[ entry->address ] = (uint8_t)entry->value;
+            ppuTileCacheInvalidate( &state->tileCache, entry->address, 1 );
+            break;
+        case PPU_LOG_CGRAM:
+            state->CGRAM[ entry->address * 2 ] = (uint8_t)entry->value;
+            state->CGRAM[ entry->address * 2 + 1 ] = (uint8_t)( entry->value >> 8 );
+            ppuPaletteUpdate( &state->palette, state->CGRAM, (uint8_t)entry->address );
+            break;
+        case PPU_LOG_OAM:
+            state->OAMRAM[ entry->address ] = (uint8_t)entry->value;
+            ppuSpriteTableUpdate( &state->spriteTable, state->OAMRAM, entry->address );
+            break;
+        case PPU_LOG_LINE:
+            renderLine( entry->address, true );
+            break;
+        case PPU_LOG_SKIP_LINE:
+            renderLine( entry->address, false );
+            break;
+        case PPU_LOG_FRAME:
+            // value is set when the frame was drawn
+            if ( entry->value ) {
+                state->framebuffer->frameNumber = state->frameNumber;
+                displayPresent( state->framebuffer );
+                ++state->framebuffer->frameCount;
+                ppuOutputEndFrame( &state->output );
+            }
+            ++state->frameNumber;
+            atomic_fetch_add_explicit( &framesReplayed, 1, memory_order_release );
+            break;
+        case PPU_LOG_CLEAR_STAT77:
+            state->stat77 = 0x00;
+            break;
+    }
+}
+
+static void *renderThread( void *argument ) {
+    (void)argument;
+
+    while ( atomic_load_explicit( &running, memory_order_relaxed ) ) {
+        const uint32_t tail = atomic_load_explicit( &logTail, memory_order_relaxed );
+        if ( atomic_load_explicit( &logHead, memory_order_acquire ) == tail ) {
+            sched_yield();
+            continue;
+        }
+        replay( &logEntries[ tail & LOG_MASK ] );
+        atomic_store_explicit( &logTail, tail + 1, memory_order_release );
+    }
+    return NULL;
+}
+
+bool ppuRenderThreadStart( Framebuffer *framebuffer, const Ports *ports, const PPURenderRegisters *registers,
+                           const uint8_t *VRAM, const uint8_t *CGRAM, const uint8_t *OAMRAM ) {
+    RenderThreadState *state = &renderState;
+    state->ports = *ports;
+    state->registers = *registers;
+    memcpy( state->VRAM, VRAM, VRAM_SIZE );
+    memcpy( state->CGRAM, CGRAM, CGRAM_SIZE );
+    memcpy( state->OAMRAM, OAMRAM, OAMRAM_SIZE );
+    state->framebuffer = framebuffer;
+    state->frameNumber = 0;
+    state->stat77 = 0x00;
+
+    ppuTileCacheInitialise( &state->tileCache );
+    ppuSpriteTableInitialise( &state->spriteTable, state->OAMRAM, state->ports.OBSEL );
+    ppuPaletteInitialise( &state->palette, framebuffer->format, state->ports.INIDISP & 0x0F );
+    ppuOutputInitialise( &state->output, framebuffer, &state->palette );
+    for ( uint16_t i = 0; i < CGRAM_SIZE / 2; ++i ) {
+        ppuPaletteUpdate( &state->palette, state->CGRAM, (uint8_t)i );
+    }
+
+    atomic_store( &logHead, 0 );
+    atomic_store( &logTail, 0 );
+    atomic_store( &framesReplayed, 0 );
+    framesLogged = 0;
+    atomic_store( &running, true );
+    if ( pthread_create( &thread, NULL, renderThread, NULL ) ) {
+        printf( "Unable to start the render thread\n" );
+        atomic_store( &running, false );
+        return false;
+    }
+    // Registered after the display, so the thread is stopped before the display closes
+    atexit( ppuRenderThreadStop );
+    return true;
+}
+
+void ppuRenderThreadStop() {
+    if ( atomic_load( &running ) ) {
+        // Finish whatever was logged, so the last frame is presented
+        ppuRenderThreadSync();
+    }
+    if ( atomic_exchange( &running, false ) ) {
+        pthread_join( thread, NULL );
+    }
+}
+
+void ppuRenderThreadLog( PPULogKind kind, uint16_t address, uint16_t value, uint32_t dot ) {
+    const uint32_t head = atomic_load_explicit( &logHead, memory_order_relaxed );
+    while ( head - atomic_load_explicit( &logTail, memory_order_acquire ) == LOG_SIZE ) {
+        sched_yield();
+    }
+    PPULogEntry *entry = &logEntries[ head & LOG_MASK ];
+    entry->dot = dot;
+    entry->address = address;
+    entry->value = value;
+    entry->kind = (uint8_t)kind;
+    atomic_store_explicit( &logHead, head + 1, memory_order_release );
+
+    if ( kind == PPU_LOG_FRAME ) {
+        ++framesLogged;
+        while ( framesLogged - atomic_load_explicit( &framesReplayed, memory_order_acquire ) > MAX_FRAMES_AHEAD ) {
+            sched_yield();
+        }
+    }
+}
+
+void ppuRenderThreadSync() {
+    const uint32_t head = atomic_load_explicit( &logHead, memory_order_relaxed );
+    while ( atomic_load_explicit( &logTail, memory_order_acquire ) != head ) {
+        sched_yield();
+    }
+}
+
+uint8_t ppuRenderThreadStat77() {
+    return renderState.stat77;
+}
@@ -0,0 +1,70 @@
+#include "ppu_internal.h"
+
+#include <memory.h>
+
+// Cache slots are laid out 2bpp, then 4bpp, then 8bpp
+static const uint32_t firstSlot[ 3 ] = { 0, TILE_CACHE_2BPP_TILES, TILE_CACHE_2BPP_TILES + TILE_CACHE_4BPP_TILES };
+static const uint8_t tileShift[ 3 ] = { 4, 5, 6 }; // log2 of the tile size in bytes
+
+static inline uint8_t depthIndex( uint8_t bitDepth ) {
+    return bitDepth >> 2;
+}
+
+void ppuTileCacheInitialise( PPUTileCache *cache ) {
+    memset( cache->dirty, 0xFF, sizeof( cache->dirty ) );
+}
+
+void ppuTileCacheInvalidate( PPUTileCache *cache, uint32_t address, uint32_t length ) {
+    if ( length == 0 ) {
+        return;
+    }
+    if ( length > VRAM_SIZE ) {
+        length = VRAM_SIZE;
+    }
+    for ( uint8_t depth = 0; depth < 3; ++depth ) {
+        const uint32_t numTiles = VRAM_SIZE >> tileShift[ depth ];
+        const uint32_t first = ( address & 0xFFFF ) >> tileShift[ depth ];
+        const uint32_t last = ( ( address + length - 1 ) & 0xFFFF ) >> tileShift[ depth ];
+        // Ranges may wrap around the end of VRAM
+        uint32_t tile = first;
+        for ( ;; ) {
+            const uint32_t slot = firstSlot[ depth ] + tile;
+            cache->dirty[ slot / 64 ] |= 1ull << ( slot % 64 );
+            if ( tile == last ) {
+                break;
+            }
+            tile = ( tile + 1 ) % numTiles;
+        }
+    }
+}
+
+void ppuTileCacheRefresh( PPUTileCache *cache, const uint8_t *VRAM ) {
+    for ( uint8_t depth = 0; depth < 3; ++depth ) {
+        const uint32_t numTiles = VRAM_SIZE >> tileShift[ depth ];
+        for ( uint32_t tile = 0; tile < numTiles; tile += 64 ) {
+            // Every depth's slots start on a word boundary
+            const uint32_t word = ( firstSlot[ depth ] + tile ) / 64;
+            uint64_t dirty = cache->dirty[ word ];
+            while ( dirty ) {
+                const uint32_t slot = word * 64 + __builtin_ctzll( dirty );
+                const uint32_t dirtyTile = slot - firstSlot[ depth ];
+                ppuKernels->decodeTile( &VRAM[ dirtyTile << tileShift[ depth ] ], 2 << depth, cache->pixels[ slot ] );
+                dirty &= dirty - 1;
+            }
+            cache->dirty[ word ] = 0;
+        }
+    }
+}
+
+const uint8_t *ppuTileCacheGet( PPUTileCache *cache, const uint8_t *VRAM, uint8_t bitDepth, uint32_t address ) {
+    const uint8_t depth = depthIndex( bitDepth );
+    const uint32_t tile = ( address & 0xFFFF ) >> tileShift[ depth ];
+    const uint32_t slot = firstSlot[ depth ] + tile;
+    const uint64_t bit = 1ull << ( slot % 64 );
+
+    if ( cache->dirty[ slot / 64 ] & bit ) {
+        ppuKernels->decodeTile( &VRAM[ tile << tileShift[ depth ] ], bitDepth, cache->pixels[ slot ] );
+        cache->dirty[ slot / 64 ] &= ~bit;
+    }
+    return cache->pixels[ slot ];
+}
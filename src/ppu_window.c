@@ -0,0 +1,69 @@
+#include "ppu_internal.h"
+
+#include <memory.h>
+
+#define WINDOW_LOGIC_OR 0
+#define WINDOW_LOGIC_AND 1
+#define WINDOW_LOGIC_XOR 2
+#define WINDOW_LOGIC_XNOR 3
+
+// Pixels left to right inclusive, empty when left > right
+static void rangeMask( uint8_t left, uint8_t right, PPUWindowMask *mask ) {
+    for ( uint8_t w = 0; w < SCREEN_WIDTH / 64; ++w ) {
+        const int16_t first = w * 64;
+        const int16_t low = left > first ? left : first;
+        const int16_t high = right < first + 63 ? right : first + 63;
+        mask->bits[ w ] = low <= high ? ( ~0ull >> ( 63 - ( high - low ) ) ) << ( low - first ) : 0;
+    }
+}
+
+// settings is a W12SEL-style nibble: bit 0 invert W1, bit 1 enable W1, bit 2 invert W2, bit 3 enable W2
+static void combineWindows( const PPUWindowMask *windows, uint8_t settings, uint8_t logic, PPUWindowMask *mask ) {
+    const bool enable1 = settings & 0x02;
+    const bool enable2 = settings & 0x08;
+    const uint64_t invert1 = ( settings & 0x01 ) ? ~0ull : 0;
+    const uint64_t invert2 = ( settings & 0x04 ) ? ~0ull : 0;
+
+    for ( uint8_t w = 0; w < SCREEN_WIDTH / 64; ++w ) {
+        const uint64_t a = windows[ 0 ].bits[ w ] ^ invert1;
+        const uint64_t b = windows[ 1 ].bits[ w ] ^ invert2;
+        uint64_t bits = 0;
+        if ( enable1 && enable2 ) {
+            switch ( logic & 0x03 ) {
+                case WINDOW_LOGIC_OR: bits = a | b; break;
+                case WINDOW_LOGIC_AND: bits = a & b; break;
+                case WINDOW_LOGIC_XOR: bits = a ^ b; break;
+                case WINDOW_LOGIC_XNOR: bits = ~( a ^ b ); break;
+            }
+        }
+        else if ( enable1 ) {
+            bits = a;
+        }
+        else if ( enable2 ) {
+            bits = b;
+        }
+        mask->bits[ w ] = bits;
+    }
+}
+
+void ppuWindowEvaluate( const Ports *ports, PPUWindowMask masks[ NUM_WINDOW_MASKS ] ) {
+    // Most lines have no windows at all
+    if ( !( ports->W12SEL | ports->W34SEL | ports->WOBJSEL ) ) {
+        memset( masks, 0, sizeof( PPUWindowMask ) * NUM_WINDOW_MASKS );
+        return;
+    }
+
+    PPUWindowMask windows[ 2 ];
+    rangeMask( ports->WH0, ports->WH1, &windows[ 0 ] );
+    rangeMask( ports->WH2, ports->WH3, &windows[ 1 ] );
+
+    const uint8_t settings[ NUM_WINDOW_MASKS ] = {
+        ports->W12SEL, ports->W12SEL >> 4, ports->W34SEL, ports->W34SEL >> 4, ports->WOBJSEL, ports->WOBJSEL >> 4
+    };
+    const uint8_t logic[ NUM_WINDOW_MASKS ] = {
+        ports->WBGLOG, ports->WBGLOG >> 2, ports->WBGLOG >> 4, ports->WBGLOG >> 6, ports->WOBJLOG, ports->WOBJLOG >> 2
+    };
+    for ( uint8_t l = 0; l < NUM_WINDOW_MASKS; ++l ) {
+        combineWindows( windows, settings[ l ] & 0x0F, logic[ l ], &masks[ l ] );
+    }
+}
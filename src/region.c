@@ -0,0 +1,20 @@
+#include "region.h"
+
+static const RegionTiming regionTimings[] = {
+    [ REGION_NTSC ] = { "NTSC", NTSC_MASTER_CLOCK, NTSC_DOTS_PER_LINE, NTSC_MASTER_CYCLES_PER_LINE, NTSC_LINES_PER_FRAME },
+    [ REGION_PAL ] = { "PAL", PAL_MASTER_CLOCK, PAL_DOTS_PER_LINE, PAL_MASTER_CYCLES_PER_LINE, PAL_LINES_PER_FRAME },
+};
+
+static Region selectedRegion = REGION_NTSC;
+
+void regionSelect( Region region ) {
+    selectedRegion = region;
+}
+
+Region regionCurrent() {
+    return selectedRegion;
+}
+
+const RegionTiming *regionTiming() {
+    return &regionTimings[ selectedRegion ];
+}
@@ -28,11 +28,9 @@
 // - JMP (1F) addressing confirmation
 // - Register (mem) access
 // - Clear-on-read addresses
-// - Timers
 // - Read-back on some ops
 // - General formatting tidying
 // - Optimisations
-// - IPL rom
 // - Other TODO notes
 
 
@@ -89,79 +87,71 @@ typedef struct ATTR_PACKED Registers {
     uint8_t timer2counter;
 } Registers;
 
-/*
-static inline uint8_t spcMemoryMapRead( uint16_t addr );
-static inline uint16_t spcMemoryMapReadU16( uint16_t addr ); // TODO - readU16 may need to know if page can increment, or just offset
-static inline void spcMemoryMapWrite( uint16_t addr, uint8_t value );
-static inline void spcMemoryMapWriteU16( uint16_t addr, uint16_t value ); // TODO - writeU16 may need to know if page can increment, or just offset
-*/
+// The instructions' view of memory. spcMemoryMap* wrap these for the rest of the APU.
+static inline uint8_t spcRead( uint16_t addr );
+static inline uint16_t spcReadU16( uint16_t addr ); // TODO - readU16 may need to know if page can increment, or just offset
+static inline void spcWrite( uint16_t addr, uint8_t value );
+static inline void spcWriteU16( uint16_t addr, uint16_t value ); // TODO - writeU16 may need to know if page can increment, or just offset
+
+#define REGISTER_PAGE 0x00F0
+#define IPL_ROM_ADDRESS 0xFFC0
 
 /* Memory and registers */
-static uint8_t APUMemory[ 0xFFFF + 0x01 ];
+static uint8_t APUMemory[ SPC700_RAM_SIZE ];
 static uint16_t PC, next_program_counter, curr_program_counter;
 static uint8_t A, X, Y, SP, PSW;
 static Registers* registers = (Registers*)( APUMemory + 0X00F0 );
 static uint8_t opCycles;
 static uint8_t CPUWriteComPorts[ 4 ];
 
-static uint8_t IPL_ROM[ 64 ] = {
+static const uint8_t IPL_ROM[ 64 ] = {
     0xCD, 0xEF, 0xBD, 0xE8, 0x00, 0xC6, 0x1D, 0xD0, 0xFC, 0x8F, 0xAA, 0xF4, 0x8F, 0xBB, 0xF5, 0x78,
     0xCC, 0xF4, 0xD0, 0xFB, 0x2F, 0x19, 0xEB, 0xF4, 0xD0, 0xFC, 0x7E, 0xF4, 0xD0, 0x0B, 0xE4, 0xF5,
     0xCB, 0xF4, 0xD7, 0x00, 0xFC, 0xD0, 0xF3, 0xAB, 0x01, 0x10, 0xEF, 0x7E, 0xF4, 0x10, 0xEB, 0xBA,
     0xF6, 0xDA, 0x00, 0xBA, 0xF4, 0xC4, 0xF4, 0xDD, 0x5D, 0xD0, 0xDB, 0x1F, 0x00, 0x00, 0xC0, 0xFF
 };
 
-static uint32_t timerClockCounter = 0;
-static uint8_t timersStage2[ 3 ];
-static bool t0Enabled = false;
-static bool t1Enabled = false;
-static bool t2Enabled = false;
-
-// TODO - overhaul with better handling
-static inline void updateTimers() {
-    // SPC @ 1000KHz
-    // T0 and T1 @ 8KHz = 125 CPU cycles per tick
-    // T2 @ 64KHz = ~16 CPU cycles per tick
-
-/*
-    if ( t0Enabled ) {
-        // Zero Timer 0
-        timersStage2[ 0 ] = 0;
-        registers->timer0counter = 0;
-    }
-    if ( t1Enabled ) {
-        // Zero Timer 1
-        timersStage2[ 1 ] = 0;
-        registers->timer1counter = 0;
-    }
-    if ( t2Enabled ) {
-        // Zero Timer 2
-        timersStage2[ 2 ] = 0;
-        registers->timer2counter = 0;
+// Reads from IPL_ROM_ADDRESS up come from here; CONTROL bit 7 swaps between the
+// ROM and the RAM underneath it. Writes always go to RAM.
+static const uint8_t *iplRegion = IPL_ROM;
+
+// SPC @ 1024KHz
+// T0 and T1 @ 8KHz = 128 CPU cycles per tick
+// T2 @ 64KHz = 16 CPU cycles per tick
+// Nothing is interrupted by a timer, so a timer only needs to be brought up to
+// date when its target changes, it is enabled or disabled, or its counter is read.
+typedef struct SPCTimer {
+    uint8_t cycleShift; // log2 of the CPU cycles per stage 1 tick
+    bool enabled;
+    uint64_t lastTick; // Stage 1 ticks up to the last sync
+    uint8_t stage2;
+    uint8_t counter; // Only the low 4 bits are visible
+} SPCTimer;
+
+static uint64_t spcCycles; // CPU cycles up to the current instruction
+static SPCTimer timers[ 3 ] = { { .cycleShift = 7 }, { .cycleShift = 7 }, { .cycleShift = 4 } };
+
+static void syncTimer( uint8_t index ) {
+    SPCTimer *timer = &timers[ index ];
+    const uint64_t tick = spcCycles >> timer->cycleShift;
+    uint64_t ticks = tick - timer->lastTick;
+    timer->lastTick = tick;
+    if ( !timer->enabled || ticks == 0 ) {
+        return;
     }
-*/
-    ++timerClockCounter;
 
-    if ( timerClockCounter == 128 ) {
-        // T0/T1/T3 tick
-        if ( t0Enabled && registers->timer0Target == ++timersStage2[ 0 ] ) {
-            ++registers->timer0counter;
-        }
-        if ( t1Enabled && registers->timer1Target == ++timersStage2[ 1 ] ) {
-            ++registers->timer1counter;
-        }
-        if ( t2Enabled && registers->timer2Target == ++timersStage2[ 2 ] ) {
-            ++registers->timer2counter;
-        }
-        
-        timerClockCounter = 0;
-    }
-    else if ( t2Enabled && timerClockCounter % 16 == 0 ) {
-        // T2 tick
-        if ( registers->timer2Target == ++timersStage2[ 2 ] ) {
-            ++registers->timer2counter;
-        }
+    // Stage 2 counts up to the target, a target of 0 meaning 256. If the target
+    // was lowered under stage 2, stage 2 has to wrap before it matches.
+    const uint8_t target = ( &registers->timer0Target )[ index ];
+    const uint32_t period = target ? target : 256;
+    const uint32_t toTarget = (uint8_t)( target - timer->stage2 ) ? (uint8_t)( target - timer->stage2 ) : 256;
+    if ( ticks < toTarget ) {
+        timer->stage2 += (uint8_t)ticks;
+        return;
     }
+    ticks -= toTarget;
+    timer->counter += (uint8_t)( 1 + ticks / period );
+    timer->stage2 = (uint8_t)( ticks % period );
 }
 
 /* Initialise (power on) */
@@ -171,25 +161,49 @@ void spc700Initialise() {
     CPUWriteComPorts[ 0 ] = 0xAA;
     CPUWriteComPorts[ 1 ] = 0xBB;
     SP = 0xEF;
-    PC = 0xFFC0;
-    memcpy( &APUMemory[ 0xFFC0 ], IPL_ROM, sizeof( IPL_ROM ) );
+    PC = IPL_ROM_ADDRESS;
+    iplRegion = IPL_ROM;
+}
+
+void spc700LoadSnapshot( const SPC700Snapshot *snapshot ) {
+    memcpy( APUMemory, snapshot->ram, sizeof( APUMemory ) );
+    PC = snapshot->PC;
+    A = snapshot->A;
+    X = snapshot->X;
+    Y = snapshot->Y;
+    PSW = snapshot->PSW;
+    SP = snapshot->SP;
+
+    // Registers that don't read back from memory
+    const uint8_t control = APUMemory[ 0xF1 ];
+    iplRegion = ( control & 0x80 ) ? IPL_ROM : &APUMemory[ IPL_ROM_ADDRESS ];
+    memcpy( CPUWriteComPorts, &APUMemory[ 0xF4 ], sizeof( CPUWriteComPorts ) );
+    accessDspAddressLatch( &APUMemory[ 0xF2 ], true );
+    for ( uint8_t i = 0; i < 3; ++i ) {
+        SPCTimer *timer = &timers[ i ];
+        timer->enabled = control & ( 0x01 << i );
+        timer->lastTick = spcCycles >> timer->cycleShift;
+        timer->stage2 = 0;
+        timer->counter = APUMemory[ 0xFD + i ] & 0x0F;
+    }
+}
+
+uint64_t spc700Cycles() {
+    return spcCycles;
 }
 
 /* Execute next instruction, update PC and cycle counter etc */
 void spc700Tick() {
     curr_program_counter = PC;
-    uint8_t opcode = spcMemoryMapRead( PC++ );
+    uint8_t opcode = spcRead( PC++ );
     SPC700InstructionEntry *entry = &instructions[ opcode ];
     opCycles = entry->opCycles;
     next_program_counter = curr_program_counter + entry->opLength;
-    if ( curr_program_counter == 0x086a ) {
-        printf( "Debug break!\n" );
-    }
     entry->instruction();
     // Operation may mutate next_program_counter if it branches/jumps
     PC = next_program_counter;
-
-    updateTimers();
+    // And opCycles if a branch is taken
+    spcCycles += opCycles;
 }
 
 /* Access the 4 visible bytes from the CPU */
@@ -237,14 +251,8 @@ static inline void spcRegisterAccess( uint16_t addressBus, uint8_t *dataBus, boo
         }
         // TODO - race conditions
         uint8_t val = *dataBus;
-        if ( val & 0x80 ) {
-            // READ IPL region goes to ROM
-            // TODO
-        }
-        else {
-            // READ IPL region goes to RAM
-            // TODO
-        }
+        // READ IPL region goes to ROM, or RAM when clear
+        iplRegion = ( val & 0x80 ) ? IPL_ROM : &APUMemory[ IPL_ROM_ADDRESS ];
         if ( val & 0x20 ) {
             // Clear PC32
             CPUWriteComPorts[ 3 ] = CPUWriteComPorts[ 2 ] = 0x00;
@@ -253,16 +261,16 @@ static inline void spcRegisterAccess( uint16_t addressBus, uint8_t *dataBus, boo
             // Clear PC10
             CPUWriteComPorts[ 1 ] = CPUWriteComPorts[ 0 ] = 0x00;
         }
-        // Reset all timers
-        timersStage2[ 0 ] = timersStage2[ 1 ] = timersStage2[ 2 ] = 0x00;
-        registers->timer0counter = 0;
-        registers->timer1counter = 0;
-        registers->timer2counter = 0;
-
-        t2Enabled = val & 0x04;
-        t1Enabled = val & 0x02;
-        t0Enabled = val & 0x01;
-        
+        // A timer restarts when it is enabled
+        for ( uint8_t i = 0; i < 3; ++i ) {
+            const bool enable = val & ( 0x01 << i );
+            syncTimer( i );
+            if ( enable && !timers[ i ].enabled ) {
+                timers[ i ].stage2 = 0;
+                timers[ i ].counter = 0;
+            }
+            timers[ i ].enabled = enable;
+        }
         return;
     }
     else if ( addressBus <= 0xF3 ) {
@@ -298,6 +306,8 @@ static inline void spcRegisterAccess( uint16_t addressBus, uint8_t *dataBus, boo
             *dataBus = 0x00;
         }
         else {
+            // Ticks so far count against the old target
+            syncTimer( addressBus - 0xFA );
             APUMemory[ addressBus ] = *dataBus;
         }
         return;
@@ -308,8 +318,10 @@ static inline void spcRegisterAccess( uint16_t addressBus, uint8_t *dataBus, boo
             printf( "Attempting to write to timer counter\n" );
         }
         else {
-            *dataBus = APUMemory[ addressBus ] & 0x0F;
-            APUMemory[ addressBus ] = 0x00;
+            SPCTimer *timer = &timers[ addressBus - 0xFD ];
+            syncTimer( addressBus - 0xFD );
+            *dataBus = timer->counter & 0x0F;
+            timer->counter = 0;
         }
         return;
     }
@@ -326,63 +338,66 @@ static inline void spcRegisterAccess( uint16_t addressBus, uint8_t *dataBus, boo
     }
 }
 
-// Might be better off breaking this into separate busRead and busWrite
-/* static inline */ void spcBusAccess( uint16_t addressBus, uint8_t* dataBus, bool writeLine ) {
-    // The if-block mapping can explicitly handle read-writes & return if required.
-    // Otherwise, we fall through and do a regular memory write
+// Everything outside the register page and the IPL region is plain RAM
+static inline bool isPlainMemory( uint16_t addr ) {
+    return (uint16_t)( addr - REGISTER_PAGE ) > 0x0F && addr < IPL_ROM_ADDRESS;
+}
 
-    uint8_t *hostAddress = NULL;
-    if ( addressBus <= 0x00EF ) {
-        hostAddress = &APUMemory[ addressBus ];
+static inline uint8_t spcRead( uint16_t addr ) {
+    if ( isPlainMemory( addr ) ) {
+        return APUMemory[ addr ];
     }
-    else if ( addressBus <= 0x00FF ) {
-        // Registers
-        spcRegisterAccess( addressBus, dataBus, writeLine );
-        return;
-    }
-    else if ( addressBus <= 0x01FF ) {
-        // Page 1 and Memory
-        hostAddress = &APUMemory[ addressBus ];
+    uint8_t dataValue;
+    if ( addr >= IPL_ROM_ADDRESS ) {
+        dataValue = iplRegion[ addr - IPL_ROM_ADDRESS ];
     }
-    else { // if ( addr <= 0xFFFF )
-        // Memory (Read/ReadWrite)/IPL Rom
-        // TODO - adjust based on X reg
-        hostAddress = &APUMemory[ addressBus ];
+    else {
+        spcRegisterAccess( addr, &dataValue, false );
     }
+    return dataValue;
+}
 
-    if ( writeLine ) {
-        *hostAddress = *dataBus;
+// TODO - readU16 may need to know if page can increment, or just offset
+static inline uint16_t spcReadU16( uint16_t addr ){
+    uint16_t dataValue = spcRead( addr );
+    return dataValue | ( ( (uint16_t) spcRead( addr + 1 ) ) << 8 );
+}
+
+// Writes to the IPL region land in the RAM underneath
+static inline void spcWrite( uint16_t addr, uint8_t value ) {
+    if ( (uint16_t)( addr - REGISTER_PAGE ) > 0x0F ) {
+        APUMemory[ addr ] = value;
     }
     else {
-        *dataBus = *hostAddress;
+        spcRegisterAccess( addr, &value, true );
     }
 }
 
-/*static inline*/ uint8_t spcMemoryMapRead( uint16_t addr ) {
-    uint8_t dataValue;
-    spcBusAccess( addr, &dataValue, false );
-    return dataValue;
+// TODO - writeU16 may need to know if page can increment, or just offset
+static inline void spcWriteU16( uint16_t addr, uint16_t value ) {
+    spcWrite( addr, (uint8_t)( value & 0x00FF ) );
+    spcWrite( addr + 1, (uint8_t) ( value >> 8 ) );
 }
 
-// TODO - readU16 may need to know if page can increment, or just offset
-/*static inline */uint16_t spcMemoryMapReadU16( uint16_t addr ){
-    uint16_t dataValue = spcMemoryMapRead( addr );
-    return dataValue | ( ( (uint16_t) spcMemoryMapRead( addr + 1 ) ) << 8 );
+uint8_t spcMemoryMapRead( uint16_t addr ) {
+    return spcRead( addr );
 }
 
-/*static inline */void spcMemoryMapWrite( uint16_t addr, uint8_t value ) {
-    spcBusAccess( addr, &value, true );
+uint16_t spcMemoryMapReadU16( uint16_t addr ) {
+    return spcReadU16( addr );
 }
 
-// TODO - writeU16 may need to know if page can increment, or just offset
-/*static inline */void spcMemoryMapWriteU16( uint16_t addr, uint16_t value ) {
-    spcMemoryMapWrite( addr, (uint8_t)( value & 0x00FF ) );
-    spcMemoryMapWrite( addr + 1, (uint8_t) ( value >> 8 ) );
-} 
+void spcMemoryMapWrite( uint16_t addr, uint8_t value ) {
+    spcWrite( addr, value );
+}
+
+void spcMemoryMapWriteU16( uint16_t addr, uint16_t value ) {
+    spcWriteU16( addr, value );
+}
 
 #pragma region SPC_ADDRESSING_MODES
 static inline uint8_t immediate_new() {
-    return spcMemoryMapRead( PC++ );
+    return spcRead( PC++ );
 }
 static inline uint16_t absolute_new() {
     uint16_t result = (uint16_t) immediate_new();
@@ -424,119 +439,119 @@ static inline uint8_t absoluteMembit( uint16_t *addr ) {
 // DIRECT OPS START
 #define DIRECT_D_WRITEOUT_OP( op ) \
     uint16_t addr = direct_new( 0 ); \
-    spcMemoryMapWrite( addr, op( spcMemoryMapRead( addr ) ) );
+    spcWrite( addr, op( spcRead( addr ) ) );
 
 #define DIRECT_A_D_OP( op ) \
-    op( A, spcMemoryMapRead( direct_new( 0 ) ) );
+    op( A, spcRead( direct_new( 0 ) ) );
 
 #define DIRECT_A_D_WRITEOUT_OP( op ) \
-    A = op( A, spcMemoryMapRead( direct_new( 0 ) ) );
+    A = op( A, spcRead( direct_new( 0 ) ) );
 
 #define DIRECT_D_A_WRITEOUT_OP( op ) \
     uint16_t addr = direct_new( 0 ); \
-    spcMemoryMapWrite( addr, op( spcMemoryMapRead( addr ), A ) );
+    spcWrite( addr, op( spcRead( addr ), A ) );
 
 #define DIRECT_X_D_WRITEOUT_OP( op ) \
-    X = op( X, spcMemoryMapRead( direct_new( 0 ) ) );
+    X = op( X, spcRead( direct_new( 0 ) ) );
 
 #define DIRECT_X_D_OP( op ) \
-    op( X, spcMemoryMapRead( direct_new( 0 ) ) );
+    op( X, spcRead( direct_new( 0 ) ) );
 
 #define DIRECT_D_X_WRITEOUT_OP( op ) \
     uint16_t addr = direct_new( 0 ); \
-    spcMemoryMapWrite( addr, op( spcMemoryMapRead( addr ), X ) );
+    spcWrite( addr, op( spcRead( addr ), X ) );
 
 #define DIRECT_Y_D_WRITEOUT_OP( op ) \
-    Y = op( Y, spcMemoryMapRead( direct_new( 0 ) ) );
+    Y = op( Y, spcRead( direct_new( 0 ) ) );
 
 #define DIRECT_Y_D_OP( op ) \
-    op( Y, spcMemoryMapRead( direct_new( 0 ) ) );
+    op( Y, spcRead( direct_new( 0 ) ) );
 
 #define DIRECT_D_Y_WRITEOUT_OP( op ) \
     uint16_t addr = direct_new( 0 ); \
-    spcMemoryMapWrite( addr, op( spcMemoryMapRead( addr ), Y ) );
+    spcWrite( addr, op( spcRead( addr ), Y ) );
 
 #define DIRECT_YA_D_WRITEOUT_OP( op ) \
     uint16_t YA = getYA(); \
-    YA = op( YA, spcMemoryMapRead( direct_new( 0 ) ) ); \
+    YA = op( YA, spcRead( direct_new( 0 ) ) ); \
     storeYA( YA );
 
 #define DIRECT_YA_D_OP( op ) \
-    op( getYA(), spcMemoryMapRead( direct_new( 0 ) ) ); \
+    op( getYA(), spcRead( direct_new( 0 ) ) ); \
 // DIRECT OPS END
 
 // X-INDEXED DIRECT PAGE OPS START
 #define X_INDEXED_DIRECT_PAGE_DX_WRITEOUT_OP( op ) \
     uint16_t addr = direct_new( X ); \
-    spcMemoryMapWrite( addr, op( spcMemoryMapRead( addr ) ) );
+    spcWrite( addr, op( spcRead( addr ) ) );
 
 #define X_INDEXED_DIRECT_PAGE_Y_DX_WRITEOUT_OP( op ) \
-    Y = op( Y, spcMemoryMapRead( direct_new( X ) ) );
+    Y = op( Y, spcRead( direct_new( X ) ) );
 
 #define X_INDEXED_DIRECT_PAGE_DX_Y_WRITEOUT_OP( op ) \
     uint16_t addr = direct_new( X ); \
-    spcMemoryMapWrite( addr, op( spcMemoryMapRead( addr ), Y ) );
+    spcWrite( addr, op( spcRead( addr ), Y ) );
 
 #define X_INDEXED_DIRECT_PAGE_A_DX_WRITEOUT_OP( op ) \
-    A = op( A, spcMemoryMapRead( direct_new( X ) ) );
+    A = op( A, spcRead( direct_new( X ) ) );
 
 #define X_INDEXED_DIRECT_PAGE_A_DX_OP( op ) \
-    op( A, spcMemoryMapRead( direct_new( X ) ) );
+    op( A, spcRead( direct_new( X ) ) );
 
 #define X_INDEXED_DIRECT_PAGE_DX_A_WRITEOUT_OP( op ) \
     uint16_t addr = direct_new( X ); \
-    spcMemoryMapWrite( addr, op( spcMemoryMapRead( addr ), A ) );
+    spcWrite( addr, op( spcRead( addr ), A ) );
 
 // Ordering here is the exception to the little-endian operands rule.
 // BBS $01.2, $05 is stored as <BBS.2> 01 02
 #define X_INDEXED_DIRECT_PAGE_DX_R_OP( op ) \
     uint8_t nearLabel = immediate_new(); \
-    uint8_t dpX = spcMemoryMapRead( direct_new( X ) ); \
-    op( spcMemoryMapRead( dpX ), nearLabel );
+    uint8_t dpX = spcRead( direct_new( X ) ); \
+    op( spcRead( dpX ), nearLabel );
 // X-INDEXED DIRECT PAGE OPS END
 
 // Y-INDEXED DIRECT PAGE OPS START
 #define Y_INDEXED_DIRECT_PAGE_X_DY_WRITEOUT_OP( op ) \
-    X = op( X, spcMemoryMapRead( direct_new( Y ) ) );
+    X = op( X, spcRead( direct_new( Y ) ) );
 
 #define Y_INDEXED_DIRECT_PAGE_DY_X_WRITEOUT_OP( op ) \
     uint16_t addr = direct_new( Y ); \
-    spcMemoryMapWrite( addr, op( spcMemoryMapRead( addr ), X ) );
+    spcWrite( addr, op( spcRead( addr ), X ) );
 // Y-INDEXED DIRECT PAGE OPS END
 
 // INDIRECT OPS START
 #define INDIRECT_A_X_WRITEOUT_OP( op ) \
-    A = op( A, spcMemoryMapRead( indirectX_new() ) );
+    A = op( A, spcRead( indirectX_new() ) );
 
 #define INDIRECT_A_X_OP( op ) \
-    op( A, spcMemoryMapRead( indirectX_new() ) );
+    op( A, spcRead( indirectX_new() ) );
 
 #define INDIRECT_X_A_WRITEOUT_OP( op ) \
     uint16_t addr = indirectX_new(); \
-    spcMemoryMapWrite( addr, op( spcMemoryMapRead( addr ), A ) );
+    spcWrite( addr, op( spcRead( addr ), A ) );
 // INDIRECT OPS END
 
 // INDIRECT AUTO INC OPS START
 #define INDIRECT_AUTO_INC_X_A_WRITEOUT_OP( op ) \
     uint16_t addr = indirectX_new(); \
     ++X; \
-    spcMemoryMapWrite( addr, op( spcMemoryMapRead( addr ), A ) ); \
+    spcWrite( addr, op( spcRead( addr ), A ) ); \
 
 #define INDIRECT_AUTO_INC_A_X_WRITEOUT_OP( op ) \
-    A = op( A, spcMemoryMapRead( indirectX_new() ) ); \
+    A = op( A, spcRead( indirectX_new() ) ); \
     ++X; \
 // INDIRECT AUTO INC OPS END
 
 // DIRECT PAGE TO DIRECT PAGE OPS START
 // TODO - param ordering verification - Should be correct if little-endian
 #define DIRECT_PAGE_DIRECT_PAGE_WRITEOUT_OP( op ) \
-    uint8_t ds = spcMemoryMapRead( direct_new( 0 ) ); \
+    uint8_t ds = spcRead( direct_new( 0 ) ); \
     uint16_t ddAddr = direct_new( 0 ); \
-    spcMemoryMapWrite( ddAddr, op( spcMemoryMapRead( ddAddr ), ds ) ); \
+    spcWrite( ddAddr, op( spcRead( ddAddr ), ds ) ); \
 
 #define DIRECT_PAGE_DIRECT_PAGE_OP( op ) \
-    uint8_t ds = spcMemoryMapRead( direct_new( 0 ) ); \
-    uint8_t dd = spcMemoryMapRead( direct_new( 0 ) ); \
+    uint8_t ds = spcRead( direct_new( 0 ) ); \
+    uint8_t dd = spcRead( direct_new( 0 ) ); \
     op( dd, ds ); \
 // DIRECT PAGE TO DIRECT PAGE OPS END
 
@@ -544,13 +559,13 @@ static inline uint8_t absoluteMembit( uint16_t *addr ) {
 // INDIRECT PAGE TO INDIRECT PAGE OPS START
 // TODO - param ordering verification - Should be correct if little-endian
 #define INDIRECT_PAGE_INDIRECT_PAGE_WRITEOUT_OP( op ) \
-    uint8_t iY = spcMemoryMapRead( indirectY_new() ); \
+    uint8_t iY = spcRead( indirectY_new() ); \
     uint16_t iXAddr = indirectX_new(); \
-    spcMemoryMapWrite( iXAddr, op( spcMemoryMapRead( iXAddr ), iY ) ); \
+    spcWrite( iXAddr, op( spcRead( iXAddr ), iY ) ); \
 
 #define INDIRECT_PAGE_INDIRECT_PAGE_OP( op ) \
-    uint8_t iY = spcMemoryMapRead( indirectY_new() ); \
-    uint8_t iX = spcMemoryMapRead( indirectX_new() ); \
+    uint8_t iY = spcRead( indirectY_new() ); \
+    uint8_t iX = spcRead( indirectX_new() ); \
     op( iX, iY ); \
 // INDIRECT PAGE TO INDIRECT PAGE OPS END
 
@@ -559,25 +574,25 @@ static inline uint8_t absoluteMembit( uint16_t *addr ) {
 #define IMMEDIATE_TO_DIRECT_PAGE_WRITEOUT_OP( op ) \
     uint8_t im = immediate_new(); \
     uint16_t addr = direct_new( 0 ); \
-    spcMemoryMapWrite( addr, op( spcMemoryMapRead( addr ), im ) );
+    spcWrite( addr, op( spcRead( addr ), im ) );
 
 #define IMMEDIATE_TO_DIRECT_PAGE_OP( op ) \
     uint8_t im = immediate_new(); \
-    uint8_t dpVal = spcMemoryMapRead( direct_new( 0 ) ); \
+    uint8_t dpVal = spcRead( direct_new( 0 ) ); \
     op( dpVal, im );
 // IMMEDIATE TO DIRECT PAGE OPS END
 
 // DIRECT PAGE BIT OPS START
 #define DIRECT_PAGE_BIT_WRITEOUT_OP( op, bit ) \
     uint16_t addr = direct_new( 0 ); \
-    spcMemoryMapWrite( addr, op( spcMemoryMapRead( addr ), 0x01 << bit ) );
+    spcWrite( addr, op( spcRead( addr ), 0x01 << bit ) );
 // DIRECT PAGE BIT OPS END
 
 // DIRECT PAGE BIT RELATIVE OPS START
 // Ordering here is the exception to the little-endian operands rule.
 // BBS $01.2, $05 is stored as <BBS.2> 01 02
 #define DIRECT_PAGE_BIT_RELATIVE_OP( op, bit ) \
-    uint8_t d = spcMemoryMapRead( direct_new( 0 ) ); \
+    uint8_t d = spcRead( direct_new( 0 ) ); \
     uint8_t r = immediate_new(); \
     op( d & ( 0x01 << bit ), r ); 
 // DIRECT PAGE BIT RELATIVE OPS END
@@ -588,20 +603,20 @@ static inline uint8_t absoluteMembit( uint16_t *addr ) {
 #define ABSOLUTE_BOOLEAN_BIT_MB_WRITEOUT_OP( op ) \
     uint16_t addr; \
     uint8_t mask = 1 << absoluteMembit( &addr ); \
-    uint8_t MB = spcMemoryMapRead( addr ); \
-    spcMemoryMapWrite( addr, op( MB & mask, MB, mask ) );
+    uint8_t MB = spcRead( addr ); \
+    spcWrite( addr, op( MB & mask, MB, mask ) );
     
 #define ABSOLUTE_BOOLEAN_BIT_C_MB_OP( op ) \
     uint16_t addr; \
     uint8_t mask = 1 << absoluteMembit( &addr ); \
     bool carrySet = PSW & SPC_CARRY_FLAG; \
-    PSW = ( PSW & ~SPC_CARRY_FLAG ) | ( op( carrySet, spcMemoryMapRead( addr ), mask ) ? SPC_CARRY_FLAG : 0x00 );
+    PSW = ( PSW & ~SPC_CARRY_FLAG ) | ( op( carrySet, spcRead( addr ), mask ) ? SPC_CARRY_FLAG : 0x00 );
 
 #define ABSOLUTE_BOOLEAN_BIT_C_iMB_OP( op ) \
     uint16_t addr; \
     uint8_t mask = 1 << absoluteMembit( &addr ); \
     bool carrySet = PSW & SPC_CARRY_FLAG; \
-    PSW = ( PSW & ~SPC_CARRY_FLAG ) | ( op( carrySet, ~spcMemoryMapRead( addr ), mask ) ? SPC_CARRY_FLAG : 0x00 );
+    PSW = ( PSW & ~SPC_CARRY_FLAG ) | ( op( carrySet, ~spcRead( addr ), mask ) ? SPC_CARRY_FLAG : 0x00 );
 
 // TODO - will only work if O1 and O2 are commutative
 #define ABSOLUTE_BOOLEAN_BIT_MB_C_WRITEOUT_OP( op ) \
@@ -609,7 +624,7 @@ static inline uint8_t absoluteMembit( uint16_t *addr ) {
     uint8_t bit = absoluteMembit( &addr ); \
     uint8_t mask = 1 << absoluteMembit( &addr ); \
     bool carrySet = PSW & SPC_CARRY_FLAG; \
-    spcMemoryMapWrite( addr, op( carrySet, spcMemoryMapRead( addr ), mask ) );
+    spcWrite( addr, op( carrySet, spcRead( addr ), mask ) );
 
 // ABSOLUTE BOOLEAN BIT OPS END
 
@@ -619,92 +634,92 @@ static inline uint8_t absoluteMembit( uint16_t *addr ) {
 
 #define ABSOLUTE_a_WRITEOUT_OP( op ) \
     uint16_t addr = absolute_new( 0 ); \
-    spcMemoryMapWrite( addr, op( spcMemoryMapRead( addr ) ) );
+    spcWrite( addr, op( spcRead( addr ) ) );
 
 #define ABSOLUTE_A_a_WRITEOUT_OP( op ) \
-    A = op( A, spcMemoryMapRead( absolute_new( 0 ) ) );
+    A = op( A, spcRead( absolute_new( 0 ) ) );
 
 #define ABSOLUTE_A_a_OP( op ) \
-    op( A, spcMemoryMapRead( absolute_new( 0 ) ) );
+    op( A, spcRead( absolute_new( 0 ) ) );
 
 #define ABSOLUTE_a_A_WRITEOUT_OP( op ) \
     uint16_t addr = absolute_new( 0 ); \
-    spcMemoryMapWrite( addr, op( spcMemoryMapRead( addr ), A ) );
+    spcWrite( addr, op( spcRead( addr ), A ) );
 
 #define ABSOLUTE_X_a_WRITEOUT_OP( op ) \
-    X = op( X, spcMemoryMapRead( absolute_new( 0 ) ) );
+    X = op( X, spcRead( absolute_new( 0 ) ) );
 
 #define ABSOLUTE_X_a_OP( op ) \
-    op( X, spcMemoryMapRead( absolute_new( 0 ) ) );
+    op( X, spcRead( absolute_new( 0 ) ) );
 
 #define ABSOLUTE_a_X_WRITEOUT_OP( op ) \
     uint16_t addr = absolute_new(); \
-    spcMemoryMapWrite( addr, op( spcMemoryMapRead( addr ), X ) );
+    spcWrite( addr, op( spcRead( addr ), X ) );
 
 #define ABSOLUTE_Y_a_WRITEOUT_OP( op ) \
-    Y = op( Y, spcMemoryMapRead( absolute_new() ) );
+    Y = op( Y, spcRead( absolute_new() ) );
 
 #define ABSOLUTE_Y_a_OP( op ) \
-    op( Y, spcMemoryMapRead( absolute_new() ) );
+    op( Y, spcRead( absolute_new() ) );
 
 #define ABSOLUTE_a_Y_WRITEOUT_OP( op ) \
     uint16_t addr = absolute_new(); \
-    spcMemoryMapWrite( addr, op( spcMemoryMapRead( addr ), Y ) );
+    spcWrite( addr, op( spcRead( addr ), Y ) );
 // ABSOLUTE OPS END
 
 /* ABSOLUTE X-INDEXED INDIRECT OPS START
 //#define ABSOLUTE_X_INDEXED_INDIRECT_ADDR_OP( op )\
 //    op( absolute_addr() + X ); */
 #define ABSOLUTE_X_INDEXED_INDIRECT_ADDR_OP( op )\
-    op( spcMemoryMapReadU16( absoluteX_new() ) );
+    op( spcReadU16( absoluteX_new() ) );
 // ABSOLUTE X-INDEXED INDIRECT OPS END
 
 // X-INDEXED ABSOLUTE OPS START
 #define X_INDEXED_ABSOLUTE_A_aX_WRITEOUT_OP( op )\
-    A = op( A, spcMemoryMapRead( absoluteX_new() ) );
+    A = op( A, spcRead( absoluteX_new() ) );
 
 #define X_INDEXED_ABSOLUTE_A_aX_OP( op )\
-    op( A, spcMemoryMapRead( absoluteX_new() ) );
+    op( A, spcRead( absoluteX_new() ) );
 
 #define X_INDEXED_ABSOLUTE_aX_A_WRITEOUT_OP( op )\
     uint16_t addr = absoluteX_new(); \
-    spcMemoryMapWrite( addr, op( spcMemoryMapRead( addr ), A ) );
+    spcWrite( addr, op( spcRead( addr ), A ) );
 // X-INDEXED ABSOLUTE OPS END
 
 // Y-INDEXED ABSOLUTE OPS START
 #define Y_INDEXED_ABSOLUTE_A_aY_WRITEOUT_OP( op )\
-    A = op( A, spcMemoryMapRead( absoluteY_new() ) );
+    A = op( A, spcRead( absoluteY_new() ) );
 
 #define Y_INDEXED_ABSOLUTE_A_aY_OP( op )\
-    op( A, spcMemoryMapRead( absoluteY_new() ) );
+    op( A, spcRead( absoluteY_new() ) );
 
 #define Y_INDEXED_ABSOLUTE_aY_A_WRITEOUT_OP( op )\
     uint16_t addr = absoluteY_new(); \
-    spcMemoryMapWrite( addr, op( spcMemoryMapRead( addr ), A ) );
+    spcWrite( addr, op( spcRead( addr ), A ) );
 // Y-INDEXED ABSOLUTE OPS END
 
 // X-INDEXED INDIRECT OPS START
 #define X_INDEXED_INDIRECT_A_dX_WRITEOUT_OP( op )\
-    A = op( A, spcMemoryMapRead( spcMemoryMapReadU16( direct_new( X ) ) ) );
+    A = op( A, spcRead( spcReadU16( direct_new( X ) ) ) );
 
 #define X_INDEXED_INDIRECT_A_dX_OP( op )\
-    op( A, spcMemoryMapRead( spcMemoryMapReadU16( direct_new( X ) ) ) );
+    op( A, spcRead( spcReadU16( direct_new( X ) ) ) );
 
 #define X_INDEXED_INDIRECT_dX_A_WRITEOUT_OP( op )\
-    uint16_t addr = spcMemoryMapReadU16( direct_new( X ) ); \
-    spcMemoryMapWrite( addr, op( spcMemoryMapRead( addr ), A ) );
+    uint16_t addr = spcReadU16( direct_new( X ) ); \
+    spcWrite( addr, op( spcRead( addr ), A ) );
 // X-INDEXED INDIRECT OPS END
 
 // INDIRECT Y-INDEXED OPS START
 #define INDIRECT_Y_INDEXED_A_dY_WRITEOUT_OP( op )\
-    A = op( A, spcMemoryMapRead( spcMemoryMapReadU16( direct_new( 0 ) ) + Y ) );
+    A = op( A, spcRead( spcReadU16( direct_new( 0 ) ) + Y ) );
 
 #define INDIRECT_Y_INDEXED_A_dY_OP( op )\
-    op( A, spcMemoryMapRead( spcMemoryMapReadU16( direct_new( 0 ) ) + Y ) );
+    op( A, spcRead( spcReadU16( direct_new( 0 ) ) + Y ) );
 
 #define INDIRECT_Y_INDEXED_dY_A_WRITEOUT_OP( op )\
-    uint16_t addr = spcMemoryMapReadU16( direct_new( 0 ) ) + Y; \
-    spcMemoryMapWrite( addr, op( spcMemoryMapRead( addr ), A ) );
+    uint16_t addr = spcReadU16( direct_new( 0 ) ) + Y; \
+    spcWrite( addr, op( spcRead( addr ), A ) );
 // INDIRECT Y-INDEXED OPS END
 
 // RELATIVE OPS START
@@ -714,12 +729,12 @@ static inline uint8_t absoluteMembit( uint16_t *addr ) {
 #define RELATIVE_D_R_WRITEOUT_OP( op ) \
     uint16_t addr = direct_new( 0 ); \
     uint8_t r = immediate_new(); \
-    spcMemoryMapWrite( addr, op( spcMemoryMapRead( addr ), r ) );
+    spcWrite( addr, op( spcRead( addr ), r ) );
 
 #define RELATIVE_OP_D_R( op ) \
     uint16_t addr = direct_new( 0 ); \
     uint8_t r = immediate_new(); \
-    op( spcMemoryMapRead( addr ), r );
+    op( spcRead( addr ), r );
 
 #define RELATIVE_Y_R_WRITEOUT_OP( op ) \
     Y = op( Y, immediate_new() );
@@ -808,11 +823,11 @@ static inline uint8_t absoluteMembit( uint16_t *addr ) {
 static inline uint8_t POP( uint8_t O1 ) {
     // TODO - remove O1
     UNUSED2( O1 );
-    return spcMemoryMapRead( ++SP );
+    return spcRead( ++SP );
 }
 
 static inline void PUSH( uint8_t O1 ) {
-    spcMemoryMapWrite( SP--, O1 );
+    spcWrite( SP--, O1 );
 }
 
 static void fsAE_POP() {
@@ -910,7 +925,7 @@ static void fs98_ADC() {
 static void fs7A_ADDW() {
     // TODO
     uint16_t YA = getYA();
-    uint16_t O1 = spcMemoryMapRead( direct_new( 0 ) );
+    uint16_t O1 = spcRead( direct_new( 0 ) );
     uint32_t result = (uint32_t)YA + (uint32_t)O1;
     PSW &= ~( SPC_NEGATIVE_FLAG | SPC_OVERFLOW_FLAG | SPC_HALF_CARRY_FLAG | SPC_ZERO_FLAG | SPC_CARRY_FLAG );
     PSW = PSW
@@ -961,7 +976,7 @@ static void fsB8_SBC() {
 static void fs9A_SUBW() {
     // TODO
     uint32_t YA = (uint32_t) getYA();
-    uint32_t O1 = (uint32_t) spcMemoryMapReadU16( direct_new( 0 ) );
+    uint32_t O1 = (uint32_t) spcReadU16( direct_new( 0 ) );
 
     uint32_t result = YA - O1;
     bool overflow = ( ( YA ^ O1 ) & ( YA ^ result ) ) & 0x8000;
@@ -1411,12 +1426,12 @@ static void fs8C_DEC() {
 }
 static void fs1A_DECW() {
     uint16_t addr = direct_new( 0 );
-    uint16_t O1 = spcMemoryMapReadU16( addr );
+    uint16_t O1 = spcReadU16( addr );
     PSW = ( PSW & ~( SPC_NEGATIVE_FLAG | SPC_ZERO_FLAG ) )
         | ( ( O1 & 0x8000 ) ? SPC_NEGATIVE_FLAG : 0x00 )
         | ( ( O1 == 0 ) ? SPC_ZERO_FLAG : 0x00 );
     
-    spcMemoryMapWriteU16( addr, O1 );
+    spcWriteU16( addr, O1 );
 }
 static void fsBC_INC() {
     IMPLIED_A_WRITEOUT_OP( INC );
@@ -1438,13 +1453,13 @@ static void fsAC_INC() {
 }
 static void fs3A_INCW() {
     uint16_t addr = direct_new( 0 );
-    uint16_t O1 = spcMemoryMapReadU16( addr );
+    uint16_t O1 = spcReadU16( addr );
     ++O1;
     PSW = ( PSW & ~( SPC_NEGATIVE_FLAG | SPC_ZERO_FLAG ) )
         | ( ( O1 & 0x8000 ) ? SPC_NEGATIVE_FLAG : 0x00 )
         | ( ( O1 == 0 ) ? SPC_ZERO_FLAG : 0x00 );
     
-    spcMemoryMapWriteU16( addr, O1 );
+    spcWriteU16( addr, O1 );
 }
 #pragma endregion 
 
@@ -1703,7 +1718,7 @@ static void fsCA_MOV1() {
 }
 static void fsBA_MOVW() {
     //DIRECT_YA_D_OP( MOVW_YA_D );
-    uint16_t YA = spcMemoryMapReadU16( direct_new( 0 ) );
+    uint16_t YA = spcReadU16( direct_new( 0 ) );
     storeYA( YA );
     PSW = ( PSW & ~( SPC_NEGATIVE_FLAG | SPC_ZERO_FLAG ) ) 
         | ( ( YA & 0x8000 ) ? SPC_NEGATIVE_FLAG : 0x00 )
@@ -1711,7 +1726,7 @@ static void fsBA_MOVW() {
 }
 static void fsDA_MOVW() {
     //DIRECT_D_YA_OP( MOVW_YA_D );
-    spcMemoryMapWriteU16( direct_new( 0 ), getYA() );
+    spcWriteU16( direct_new( 0 ), getYA() );
 }
 
 #pragma endregion
@@ -1948,23 +1963,23 @@ static void fsFF_STOP() {
 
 static void fs4E_TCLR1() {
     uint16_t addr = absolute_new();
-    uint8_t value = spcMemoryMapRead( addr );
+    uint8_t value = spcRead( addr );
     uint8_t temp = value & A;
     PSW = ( PSW & ~( SPC_NEGATIVE_FLAG | SPC_ZERO_FLAG ) ) 
         | ( temp & 0x80 ? SPC_NEGATIVE_FLAG : 0x00 )
         | ( temp == 0 ? SPC_ZERO_FLAG : 0x00 );
 
-    spcMemoryMapWrite( addr, value & ~A );
+    spcWrite( addr, value & ~A );
 }
 static void fs0E_TSET1() {
     uint16_t addr = absolute_new();
-    uint8_t value = spcMemoryMapRead( addr );
+    uint8_t value = spcRead( addr );
     uint8_t temp = value & A;
     PSW = ( PSW & ~( SPC_NEGATIVE_FLAG | SPC_ZERO_FLAG ) ) 
         | ( temp & 0x80 ? SPC_NEGATIVE_FLAG : 0x00 )
         | ( temp == 0 ? SPC_ZERO_FLAG : 0x00 );
         
-    spcMemoryMapWrite( addr, value | A );
+    spcWrite( addr, value | A );
 }
 static void fs9F_XCN() {
     A = ( A >> 4 ) | ( A << 4 );
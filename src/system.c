@@ -4,39 +4,62 @@
 #include "cpu.h"
 #include "dsp.h"
 #include "ppu.h"
+#include "region.h"
 #include "wram.h"
 #include "spc700.h"
 
+#include <stdatomic.h>
 #include <stdio.h>
 #include <string.h>
 
 static uint8_t openBus;
 
 void cycle();
-bool execute;
+// Cleared by end_execution, which the render thread may call (e.g. on a golden hash mismatch)
+static atomic_bool execute;
 unsigned int cycle_counter;
 
 int startup() {
     cpuInitialise();
     spc700Initialise();
-    ppuInitialise();
+    if ( ppuInitialise() ) {
+        return 1;
+    }
     dspInitialise();
 
     return 0;
 }
 
 void begin_execution() {
-    execute = 1;
+    atomic_store( &execute, true );
     cycle();
 }
 
+void end_execution() {
+    atomic_store( &execute, false );
+}
+
+// The loop is built once per region so the tick functions it calls are the specialised ones
+#define CYCLE( REGION ) \
+    static void cycle##REGION() { \
+        while ( atomic_load_explicit( &execute, memory_order_relaxed ) ) { \
+            cpuTick##REGION(); \
+            spc700Tick(); \
+            dspTick(); \
+            ppuTick##REGION(); \
+            cycle_counter++; \
+        } \
+    }
+
+CYCLE( NTSC )
+CYCLE( PAL )
+
 void cycle() {
-    while ( execute ) {
-        cpuTick();
-        spc700Tick();
-        dspTick();
-        ppuTick();
-        cycle_counter++;
+    if ( regionCurrent() == REGION_PAL ) {
+        cyclePAL();
+    }
+    else {
+        cycleNTSC();
     }
 }
 
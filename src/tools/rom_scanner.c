@@ -0,0 +1,474 @@
+/*
+    ROM library scanner.
+    Walks a directory of ROM images on a pool of worker threads, runs the
+    cartridge header scoring on each image, verifies the internal checksum and
+    emits a CSV or JSON manifest for triage.
+
+    Usage: rom_scanner [-j threads] [-f csv|json] [-o output] <directory>
+*/
+
+#include "cartridge.h"
+
+#include <dirent.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#if defined( __AVX2__ ) || defined( __SSE2__ )
+#include <immintrin.h>
+#endif
+
+#define MAX_THREADS         64
+#define MAX_ROM_SIZE        ( 12 * 1024 * 1024 )
+#define COPIER_HEADER_SIZE  0x200
+#define TITLE_LENGTH        21
+
+typedef enum OutputFormat {
+    OutputCSV,
+    OutputJSON
+} OutputFormat;
+
+typedef enum RomLayout {
+    LayoutUnknown,
+    LayoutLoROM,
+    LayoutHiROM
+} RomLayout;
+
+typedef struct RomReport {
+    bool        valid;
+    const char  *error;
+    RomLayout   layout;
+    int         loScore;
+    int         hiScore;
+    bool        copierHeader;
+    uint32_t    fileSize;
+    char        title[ TITLE_LENGTH + 1 ];
+    uint8_t     mapMode;
+    uint8_t     region;
+    uint32_t    headerRomSize;
+    uint32_t    sramSize;
+    uint16_t    checksum;
+    uint16_t    complement;
+    uint16_t    computedChecksum;
+    bool        checksumOk;
+} RomReport;
+
+typedef struct PathList {
+    char        **paths;
+    size_t      count;
+    size_t      capacity;
+} PathList;
+
+typedef struct ScanJob {
+    PathList        *pathList;
+    RomReport       *reports;
+    atomic_size_t   nextIndex;
+} ScanJob;
+
+static const char *regionNames[] = {
+    "Japan", "North America", "Europe", "Sweden", "Finland", "Denmark", "France", "Netherlands",
+    "Spain", "Germany", "Italy", "China", "Indonesia", "Korea", "International", "Canada",
+    "Brazil", "Australia"
+};
+
+static const char *layoutNames[] = {
+    "Unknown", "LoROM", "HiROM"
+};
+
+#pragma region ByteSum
+// Sum of every byte in the buffer. SAD against zero yields per-lane byte sums, so
+// the inner loop is a single instruction per 16/32 bytes.
+static uint64_t byteSum( const uint8_t *data, size_t length ) {
+    uint64_t sum = 0;
+    size_t i = 0;
+
+#if defined( __AVX2__ )
+    __m256i zero = _mm256_setzero_si256();
+    __m256i acc = _mm256_setzero_si256();
+    for ( ; i + 32 <= length; i += 32 ) {
+        __m256i bytes = _mm256_loadu_si256( (const __m256i*)( data + i ) );
+        acc = _mm256_add_epi64( acc, _mm256_sad_epu8( bytes, zero ) );
+    }
+    uint64_t lanes[ 4 ];
+    _mm256_storeu_si256( (__m256i*)lanes, acc );
+    sum = lanes[ 0 ] + lanes[ 1 ] + lanes[ 2 ] + lanes[ 3 ];
+#elif defined( __SSE2__ )
+    __m128i zero = _mm_setzero_si128();
+    __m128i acc = _mm_setzero_si128();
+    for ( ; i + 16 <= length; i += 16 ) {
+        __m128i bytes = _mm_loadu_si128( (const __m128i*)( data + i ) );
+        acc = _mm_add_epi64( acc, _mm_sad_epu8( bytes, zero ) );
+    }
+    uint64_t lanes[ 2 ];
+    _mm_storeu_si128( (__m128i*)lanes, acc );
+    sum = lanes[ 0 ] + lanes[ 1 ];
+#endif
+
+    for ( ; i < length; ++i ) {
+        sum += data[ i ];
+    }
+    return sum;
+}
+
+static uint32_t largestPowerOfTwo( uint32_t value ) {
+    uint32_t result = 1;
+    while ( result <= value / 2 ) {
+        result <<= 1;
+    }
+    return result;
+}
+
+// Non power-of-two images are mirrored up to the next power of two before summing,
+// e.g. a 3MB image counts as 2MB + 1MB + 1MB.
+static uint64_t mirroredSum( const uint8_t *data, uint32_t size, uint32_t target ) {
+    if ( size == 0 ) {
+        return 0;
+    }
+    uint32_t base = largestPowerOfTwo( size );
+    if ( base == size ) {
+        return byteSum( data, size ) * ( target / size );
+    }
+    uint64_t blockSum = byteSum( data, base ) + mirroredSum( data + base, size - base, base );
+    return blockSum * ( target / ( base * 2 ) );
+}
+
+static uint16_t computeChecksum( const uint8_t *rom, uint32_t size ) {
+    uint32_t target = largestPowerOfTwo( size );
+    if ( target != size ) {
+        target <<= 1;
+    }
+    return (uint16_t)( mirroredSum( rom, size, target ) & 0xFFFF );
+}
+#pragma endregion
+
+#pragma region Scanning
+static void scanRom( const char *path, RomReport *report ) {
+    memset( report, 0x00, sizeof( RomReport ) );
+
+    FILE *romFile = fopen( path, "rb" );
+    if ( !romFile ) {
+        report->error = "open failed";
+        return;
+    }
+    fseek( romFile, 0, SEEK_END );
+    const long fileSize = ftell( romFile );
+    fseek( romFile, 0, SEEK_SET );
+    if ( fileSize <= 0 || fileSize > MAX_ROM_SIZE ) {
+        fclose( romFile );
+        report->error = "bad size";
+        return;
+    }
+
+    uint8_t *image = malloc( fileSize );
+    if ( !image || fread( image, fileSize, 1, romFile ) != 1 ) {
+        free( image );
+        fclose( romFile );
+        report->error = "read failed";
+        return;
+    }
+    fclose( romFile );
+
+    report->fileSize = (uint32_t)fileSize;
+    report->copierHeader = ( fileSize & 0x3FF ) == COPIER_HEADER_SIZE;
+    report->loScore = cartridgeScoreLoROM( image, report->fileSize, report->copierHeader );
+    report->hiScore = cartridgeScoreHiROM( image, report->fileSize, report->copierHeader );
+
+    const uint32_t headerSkip = report->copierHeader ? COPIER_HEADER_SIZE : 0;
+    const uint32_t romSize = report->fileSize - headerSkip;
+    const uint8_t *rom = image + headerSkip;
+    uint32_t headerBase;
+    if ( report->hiScore > report->loScore && romSize >= 0x10000 ) {
+        report->layout = LayoutHiROM;
+        headerBase = 0xFFC0;
+    }
+    else if ( romSize >= 0x8000 ) {
+        report->layout = LayoutLoROM;
+        headerBase = 0x7FC0;
+    }
+    else {
+        free( image );
+        report->error = "too small";
+        return;
+    }
+
+    const uint8_t *header = rom + headerBase;
+    for ( uint8_t i = 0; i < TITLE_LENGTH; ++i ) {
+        char c = (char)header[ i ];
+        report->title[ i ] = ( c >= 0x20 && c < 0x7F ) ? c : '.';
+    }
+    report->title[ TITLE_LENGTH ] = '\0';
+    for ( int8_t i = TITLE_LENGTH - 1; i >= 0 && report->title[ i ] == ' '; --i ) {
+        report->title[ i ] = '\0';
+    }
+
+    report->mapMode = header[ 0x15 ];
+    report->headerRomSize = header[ 0x17 ] < 0x10 ? ( 1024u << header[ 0x17 ] ) : 0;
+    report->sramSize = ( header[ 0x18 ] > 0 && header[ 0x18 ] < 0x10 ) ? ( 1024u << header[ 0x18 ] ) : 0;
+    report->region = header[ 0x19 ];
+    report->complement = ( (uint16_t)header[ 0x1D ] << 8 ) | header[ 0x1C ];
+    report->checksum = ( (uint16_t)header[ 0x1F ] << 8 ) | header[ 0x1E ];
+    report->computedChecksum = computeChecksum( rom, romSize );
+    report->checksumOk = ( report->checksum == report->computedChecksum )
+                         && ( (uint16_t)( report->checksum ^ report->complement ) == 0xFFFF );
+    report->valid = true;
+
+    free( image );
+}
+
+static void *scanWorker( void *userData ) {
+    ScanJob *job = (ScanJob*)userData;
+    for ( ;; ) {
+        size_t index = atomic_fetch_add( &job->nextIndex, 1 );
+        if ( index >= job->pathList->count ) {
+            break;
+        }
+        scanRom( job->pathList->paths[ index ], &job->reports[ index ] );
+    }
+    return NULL;
+}
+#pragma endregion
+
+#pragma region DirectoryWalk
+static bool isRomFile( const char *name ) {
+    static const char *extensions[] = { ".sfc", ".smc", ".swc", ".fig", ".bin" };
+    const char *extension = strrchr( name, '.' );
+    if ( !extension ) {
+        return false;
+    }
+    for ( size_t i = 0; i < sizeof( extensions ) / sizeof( extensions[ 0 ] ); ++i ) {
+        if ( strcasecmp( extension, extensions[ i ] ) == 0 ) {
+            return true;
+        }
+    }
+    return false;
+}
+
+static void pathListAppend( PathList *list, const char *path ) {
+    if ( list->count == list->capacity ) {
+        list->capacity = list->capacity ? list->capacity * 2 : 256;
+        list->paths = realloc( list->paths, list->capacity * sizeof( char* ) );
+    }
+    list->paths[ list->count++ ] = strdup( path );
+}
+
+static void walkDirectory( const char *directory, PathList *list ) {
+    DIR *dir = opendir( directory );
+    if ( !dir ) {
+        fprintf( stderr, "Failed to open directory: %s\n", directory );
+        return;
+    }
+
+    struct dirent *entry;
+    while ( ( entry = readdir( dir ) ) != NULL ) {
+        if ( strcmp( entry->d_name, "." ) == 0 || strcmp( entry->d_name, ".." ) == 0 ) {
+            continue;
+        }
+        size_t pathLength = strlen( directory ) + strlen( entry->d_name ) + 2;
+        char *path = malloc( pathLength );
+        snprintf( path, pathLength, "%s/%s", directory, entry->d_name );
+
+        // Links are followed to files, never to directories, which could lead back up the tree
+        struct stat pathStat;
+        if ( lstat( path, &pathStat ) == 0 ) {
+            const bool isLink = S_ISLNK( pathStat.st_mode );
+            if ( isLink && stat( path, &pathStat ) != 0 ) {
+                pathStat.st_mode = 0;
+            }
+            if ( S_ISDIR( pathStat.st_mode ) ) {
+                if ( !isLink ) {
+                    walkDirectory( path, list );
+                }
+            }
+            else if ( S_ISREG( pathStat.st_mode ) && isRomFile( entry->d_name ) ) {
+                pathListAppend( list, path );
+            }
+        }
+        free( path );
+    }
+    closedir( dir );
+}
+
+static int comparePaths( const void *a, const void *b ) {
+    return strcmp( *(char* const*)a, *(char* const*)b );
+}
+#pragma endregion
+
+#pragma region Output
+static const char *regionName( uint8_t region ) {
+    if ( region < sizeof( regionNames ) / sizeof( regionNames[ 0 ] ) ) {
+        return regionNames[ region ];
+    }
+    return "Unknown";
+}
+
+static void writeEscaped( FILE *out, const char *text, OutputFormat format ) {
+    for ( ; *text; ++text ) {
+        if ( *text == '"' ) {
+            fputs( format == OutputCSV ? "\"\"" : "\\\"", out );
+        }
+        else if ( *text == '\\' && format == OutputJSON ) {
+            fputs( "\\\\", out );
+        }
+        else if ( (unsigned char)*text < 0x20 && format == OutputJSON ) {
+            fprintf( out, "\\u%04x", (unsigned char)*text );
+        }
+        else {
+            fputc( *text, out );
+        }
+    }
+}
+
+static void writeCSV( FILE *out, const PathList *list, const RomReport *reports ) {
+    fprintf( out, "path,status,layout,lo_score,hi_score,title,region,rom_size,file_size,sram_size,"
+                  "copier_header,checksum,complement,computed_checksum,checksum_ok\n" );
+    for ( size_t i = 0; i < list->count; ++i ) {
+        const RomReport *report = &reports[ i ];
+        fputc( '"', out );
+        writeEscaped( out, list->paths[ i ], OutputCSV );
+        fputc( '"', out );
+        if ( !report->valid ) {
+            fprintf( out, ",%s,,,,,,,,,,,,,\n", report->error );
+            continue;
+        }
+        fprintf( out, ",ok,%s,%d,%d,\"", layoutNames[ report->layout ], report->loScore, report->hiScore );
+        writeEscaped( out, report->title, OutputCSV );
+        fprintf( out, "\",%s,%u,%u,%u,%d,0x%04X,0x%04X,0x%04X,%d\n",
+                 regionName( report->region ), report->headerRomSize, report->fileSize, report->sramSize,
+                 report->copierHeader, report->checksum, report->complement, report->computedChecksum,
+                 report->checksumOk );
+    }
+}
+
+static void writeJSON( FILE *out, const PathList *list, const RomReport *reports ) {
+    fprintf( out, "[\n" );
+    for ( size_t i = 0; i < list->count; ++i ) {
+        const RomReport *report = &reports[ i ];
+        fprintf( out, "  { \"path\": \"" );
+        writeEscaped( out, list->paths[ i ], OutputJSON );
+        if ( !report->valid ) {
+            fprintf( out, "\", \"status\": \"%s\" }%s\n", report->error, i + 1 < list->count ? "," : "" );
+            continue;
+        }
+        fprintf( out, "\", \"status\": \"ok\", \"layout\": \"%s\", \"lo_score\": %d, \"hi_score\": %d, \"title\": \"",
+                 layoutNames[ report->layout ], report->loScore, report->hiScore );
+        writeEscaped( out, report->title, OutputJSON );
+        fprintf( out, "\", \"region\": \"%s\", \"rom_size\": %u, \"file_size\": %u, \"sram_size\": %u, "
+                      "\"copier_header\": %s, \"checksum\": %u, \"complement\": %u, \"computed_checksum\": %u, "
+                      "\"checksum_ok\": %s }%s\n",
+                 regionName( report->region ), report->headerRomSize, report->fileSize, report->sramSize,
+                 report->copierHeader ? "true" : "false", report->checksum, report->complement,
+                 report->computedChecksum, report->checksumOk ? "true" : "false",
+                 i + 1 < list->count ? "," : "" );
+    }
+    fprintf( out, "]\n" );
+}
+#pragma endregion
+
+static void printUsage( const char *program ) {
+    fprintf( stderr, "Usage: %s [-j threads] [-f csv|json] [-o output] <directory>\n", program );
+}
+
+int main( int argc, char **argv ) {
+    long numThreads = sysconf( _SC_NPROCESSORS_ONLN );
+    OutputFormat format = OutputCSV;
+    const char *outputPath = NULL;
+
+    int opt;
+    while ( ( opt = getopt( argc, argv, "j:f:o:h" ) ) != -1 ) {
+        switch ( opt ) {
+            case 'j':
+                numThreads = strtol( optarg, NULL, 10 );
+                break;
+            case 'f':
+                if ( strcmp( optarg, "json" ) == 0 ) {
+                    format = OutputJSON;
+                }
+                else if ( strcmp( optarg, "csv" ) == 0 ) {
+                    format = OutputCSV;
+                }
+                else {
+                    printUsage( argv[ 0 ] );
+                    return 1;
+                }
+                break;
+            case 'o':
+                outputPath = optarg;
+                break;
+            default:
+                printUsage( argv[ 0 ] );
+                return 1;
+        }
+    }
+    if ( optind != argc - 1 ) {
+        printUsage( argv[ 0 ] );
+        return 1;
+    }
+    if ( numThreads < 1 ) {
+        numThreads = 1;
+    }
+    else if ( numThreads > MAX_THREADS ) {
+        numThreads = MAX_THREADS;
+    }
+
+    PathList pathList = { NULL, 0, 0 };
+    walkDirectory( argv[ optind ], &pathList );
+    if ( pathList.count > 0 ) {
+        qsort( pathList.paths, pathList.count, sizeof( char* ), comparePaths );
+    }
+
+    ScanJob job;
+    job.pathList = &pathList;
+    job.reports = calloc( pathList.count ? pathList.count : 1, sizeof( RomReport ) );
+    atomic_init( &job.nextIndex, 0 );
+
+    pthread_t threads[ MAX_THREADS ];
+    long numStarted = 0;
+    for ( long i = 0; i < numThreads; ++i ) {
+        if ( pthread_create( &threads[ numStarted ], NULL, scanWorker, &job ) != 0 ) {
+            fprintf( stderr, "Failed to start scan thread %ld\n", i );
+            continue;
+        }
+        ++numStarted;
+    }
+    if ( numStarted == 0 ) {
+        scanWorker( &job );
+    }
+    for ( long i = 0; i < numStarted; ++i ) {
+        pthread_join( threads[ i ], NULL );
+    }
+
+    FILE *out = outputPath ? fopen( outputPath, "w" ) : stdout;
+    if ( !out ) {
+        fprintf( stderr, "Failed to open output file: %s\n", outputPath );
+        return 1;
+    }
+    if ( format == OutputJSON ) {
+        writeJSON( out, &pathList, job.reports );
+    }
+    else {
+        writeCSV( out, &pathList, job.reports );
+    }
+    if ( out != stdout ) {
+        fclose( out );
+    }
+
+    size_t numValid = 0, numChecksumOk = 0;
+    for ( size_t i = 0; i < pathList.count; ++i ) {
+        numValid += job.reports[ i ].valid;
+        numChecksumOk += job.reports[ i ].checksumOk;
+        free( pathList.paths[ i ] );
+    }
+    fprintf( stderr, "Scanned %zu images (%zu readable, %zu checksum ok) on %ld threads\n",
+             pathList.count, numValid, numChecksumOk, numThreads );
+
+    free( pathList.paths );
+    free( job.reports );
+    return 0;
+}
@@ -0,0 +1,259 @@
+/*
+    Standalone SPC700/DSP runner.
+    Loads a .spc snapshot into the APU core, runs it headless as fast as it
+    will go with no 65816 or PPU, optionally writes the audio to a WAV file and
+    reports SPC700 instructions/sec and DSP samples/sec. A reproducible
+    benchmark for the audio core.
+
+    Usage: spc_runner [-s seconds] [-o output.wav] <file.spc>
+
+    Built with `make spc_runner`, against a DSP compiled without PortAudio.
+*/
+
+#include "dsp.h"
+#include "spc700.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#define DEFAULT_SECONDS     30
+#define SPC_CLOCK           1024000 // Hz
+#define SAMPLE_RATE         32000
+#define CYCLES_PER_SAMPLE   ( SPC_CLOCK / SAMPLE_RATE )
+#define WAV_CHUNK_FRAMES    4096
+
+// .spc file layout, v0.30
+#define SPC_SIGNATURE       "SNES-SPC700 Sound File Data"
+#define SPC_HAS_ID666       0x23
+#define SPC_REGISTERS       0x25 // PC low, PC high, A, X, Y, PSW, SP
+#define SPC_SONG_TITLE      0x2E
+#define SPC_TITLE_LENGTH    32
+#define SPC_RAM             0x100
+#define SPC_DSP_REGISTERS   0x10100
+#define SPC_IPL_RAM         0x101C0 // RAM hidden under the IPL ROM
+#define SPC_MIN_SIZE        0x10200
+#define DSP_REGISTER_COUNT  128
+#define IPL_ROM_ADDRESS     0xFFC0
+#define IPL_ROM_SIZE        64
+
+typedef struct WavWriter {
+    FILE        *file;
+    int16_t     frames[ WAV_CHUNK_FRAMES * 2 ];
+    uint32_t    numBuffered;
+    uint32_t    numWritten;
+} WavWriter;
+
+static void printUsage( const char *program ) {
+    fprintf( stderr, "Usage: %s [-s seconds] [-o output.wav] <file.spc>\n", program );
+}
+
+static double hostSeconds() {
+    struct timespec now;
+    clock_gettime( CLOCK_MONOTONIC, &now );
+    return (double)now.tv_sec + now.tv_nsec / 1e9;
+}
+
+#pragma region Snapshot
+
+static uint8_t *loadFile( const char *path, long *size ) {
+    FILE *file = fopen( path, "rb" );
+    if ( !file ) {
+        return NULL;
+    }
+    fseek( file, 0, SEEK_END );
+    *size = ftell( file );
+    fseek( file, 0, SEEK_SET );
+    uint8_t *data = *size > 0 ? malloc( *size ) : NULL;
+    if ( data && fread( data, *size, 1, file ) != 1 ) {
+        free( data );
+        data = NULL;
+    }
+    fclose( file );
+    return data;
+}
+
+// Fills the snapshot and the DSP registers, printing why on failure
+static bool parseSpc( const uint8_t *data, long size, SPC700Snapshot *snapshot, uint8_t *dspRegisters ) {
+    if ( size < SPC_MIN_SIZE || memcmp( data, SPC_SIGNATURE, strlen( SPC_SIGNATURE ) ) != 0 ) {
+        fprintf( stderr, "Not a .spc file\n" );
+        return false;
+    }
+    const uint8_t *cpu = &data[ SPC_REGISTERS ];
+    snapshot->PC = cpu[ 0 ] | ( (uint16_t)cpu[ 1 ] << 8 );
+    snapshot->A = cpu[ 2 ];
+    snapshot->X = cpu[ 3 ];
+    snapshot->Y = cpu[ 4 ];
+    snapshot->PSW = cpu[ 5 ];
+    snapshot->SP = cpu[ 6 ];
+
+    memcpy( snapshot->ram, &data[ SPC_RAM ], SPC700_RAM_SIZE );
+    // With the IPL ROM mapped the dump shows the ROM, the RAM under it is kept separately
+    if ( snapshot->ram[ 0xF1 ] & 0x80 ) {
+        memcpy( &snapshot->ram[ IPL_ROM_ADDRESS ], &data[ SPC_IPL_RAM ], IPL_ROM_SIZE );
+    }
+    memcpy( dspRegisters, &data[ SPC_DSP_REGISTERS ], DSP_REGISTER_COUNT );
+
+    if ( data[ SPC_HAS_ID666 ] == 26 ) {
+        char title[ SPC_TITLE_LENGTH + 1 ] = { 0 };
+        memcpy( title, &data[ SPC_SONG_TITLE ], SPC_TITLE_LENGTH );
+        fprintf( stderr, "Playing '%s'\n", title );
+    }
+    return true;
+}
+
+#pragma endregion
+
+#pragma region WAV
+
+static void putU16( uint8_t *destination, uint16_t value ) {
+    destination[ 0 ] = (uint8_t)value;
+    destination[ 1 ] = (uint8_t)( value >> 8 );
+}
+
+static void putU32( uint8_t *destination, uint32_t value ) {
+    putU16( destination, (uint16_t)value );
+    putU16( destination + 2, (uint16_t)( value >> 16 ) );
+}
+
+// 16-bit stereo PCM. The sizes are filled in by wavClose.
+static void wavWriteHeader( FILE *file, uint32_t numFrames ) {
+    const uint32_t dataBytes = numFrames * 2 * sizeof( int16_t );
+    uint8_t header[ 44 ];
+    memcpy( &header[ 0 ], "RIFF", 4 );
+    putU32( &header[ 4 ], 36 + dataBytes );
+    memcpy( &header[ 8 ], "WAVEfmt ", 8 );
+    putU32( &header[ 16 ], 16 );
+    putU16( &header[ 20 ], 1 ); // PCM
+    putU16( &header[ 22 ], 2 );
+    putU32( &header[ 24 ], SAMPLE_RATE );
+    putU32( &header[ 28 ], SAMPLE_RATE * 2 * sizeof( int16_t ) );
+    putU16( &header[ 32 ], 2 * sizeof( int16_t ) );
+    putU16( &header[ 34 ], 16 );
+    memcpy( &header[ 36 ], "data", 4 );
+    putU32( &header[ 40 ], dataBytes );
+    fwrite( header, sizeof( header ), 1, file );
+}
+
+static bool wavOpen( WavWriter *writer, const char *path ) {
+    writer->file = fopen( path, "wb" );
+    writer->numBuffered = 0;
+    writer->numWritten = 0;
+    if ( !writer->file ) {
+        fprintf( stderr, "Failed to open output file: %s\n", path );
+        return false;
+    }
+    wavWriteHeader( writer->file, 0 );
+    return true;
+}
+
+static void wavFlush( WavWriter *writer ) {
+    // Samples are little endian in the file, as they are on the host
+    fwrite( writer->frames, 2 * sizeof( int16_t ), writer->numBuffered, writer->file );
+    writer->numWritten += writer->numBuffered;
+    writer->numBuffered = 0;
+}
+
+static void wavAddFrame( WavWriter *writer, int16_t left, int16_t right ) {
+    writer->frames[ writer->numBuffered * 2 ] = left;
+    writer->frames[ writer->numBuffered * 2 + 1 ] = right;
+    if ( ++writer->numBuffered == WAV_CHUNK_FRAMES ) {
+        wavFlush( writer );
+    }
+}
+
+static void wavClose( WavWriter *writer ) {
+    wavFlush( writer );
+    fseek( writer->file, 0, SEEK_SET );
+    wavWriteHeader( writer->file, writer->numWritten );
+    fclose( writer->file );
+}
+
+#pragma endregion
+
+int main( int argc, char **argv ) {
+    long seconds = DEFAULT_SECONDS;
+    const char *outputPath = NULL;
+
+    int opt;
+    while ( ( opt = getopt( argc, argv, "s:o:h" ) ) != -1 ) {
+        switch ( opt ) {
+            case 's':
+                seconds = strtol( optarg, NULL, 10 );
+                break;
+            case 'o':
+                outputPath = optarg;
+                break;
+            default:
+                printUsage( argv[ 0 ] );
+                return 1;
+        }
+    }
+    if ( optind != argc - 1 || seconds < 1 ) {
+        printUsage( argv[ 0 ] );
+        return 1;
+    }
+
+    long size;
+    uint8_t *data = loadFile( argv[ optind ], &size );
+    if ( !data ) {
+        fprintf( stderr, "Failed to read %s\n", argv[ optind ] );
+        return 1;
+    }
+    SPC700Snapshot *snapshot = malloc( sizeof( SPC700Snapshot ) );
+    uint8_t dspRegisters[ DSP_REGISTER_COUNT ];
+    if ( !snapshot || !parseSpc( data, size, snapshot, dspRegisters ) ) {
+        free( snapshot );
+        free( data );
+        return 1;
+    }
+    free( data );
+
+    WavWriter writer;
+    if ( outputPath && !wavOpen( &writer, outputPath ) ) {
+        free( snapshot );
+        return 1;
+    }
+
+    dspUseAudioOutput( false );
+    spc700Initialise();
+    dspInitialise();
+    spc700LoadSnapshot( snapshot );
+    dspLoadRegisters( dspRegisters );
+    free( snapshot );
+
+    const uint64_t numSamples = (uint64_t)seconds * SAMPLE_RATE;
+    uint64_t instructions = 0;
+    uint64_t samples = 0;
+    uint64_t nextSampleCycle = spc700Cycles() + CYCLES_PER_SAMPLE;
+    const double start = hostSeconds();
+    while ( samples < numSamples ) {
+        spc700Tick();
+        ++instructions;
+        if ( spc700Cycles() >= nextSampleCycle ) {
+            nextSampleCycle += CYCLES_PER_SAMPLE;
+            dspTick();
+            int16_t left;
+            int16_t right;
+            dspNextSample( &left, &right );
+            ++samples;
+            if ( outputPath ) {
+                wavAddFrame( &writer, left, right );
+            }
+        }
+    }
+    const double elapsed = hostSeconds() - start;
+
+    if ( outputPath ) {
+        wavClose( &writer );
+    }
+    fprintf( stderr, "Ran %ld emulated seconds in %.3f seconds (%.1fx real time)\n", seconds, elapsed, seconds / elapsed );
+    fprintf( stderr, "SPC700: %llu instructions, %.0f instructions/sec\n", (unsigned long long)instructions,
+             instructions / elapsed );
+    fprintf( stderr, "DSP: %llu samples, %.0f samples/sec\n", (unsigned long long)samples, samples / elapsed );
+    return 0;
+}
@@ -1,5 +1,7 @@
 #include "wram.h"
 
+#include "dma.h"
+
 #include <assert.h>
 #include <memory.h>
 #include <stdio.h>
@@ -15,6 +17,71 @@ typedef struct WRAMPorts {
 
 static WRAMPorts ports;
 
+// WRAM ranges each HDMA channel's compiled lines were read from. A write into
+// one invalidates that channel's schedule. watchLow and watchHigh span all of
+// them, and are empty when watchLow > watchHigh.
+static uint8_t watchedChannels;
+static uint32_t channelWatchLow[ 8 ];
+static uint32_t channelWatchHigh[ 8 ];
+static uint32_t watchLow = UINT32_MAX;
+static uint32_t watchHigh = 0;
+
+#define WRAM_SIZE           0x20000
+#define WRAM_ADDRESS_MASK   0x1FFFF
+
+static inline uint32_t getPortAddress() {
+    return ( ( (uint32_t) ( ports.WMADDh & 0x01 ) ) << 16 ) | ( ( (uint32_t) ports.WMADDm ) << 8 ) | ( (uint32_t) ports.WMADDl );
+}
+
+static void updateWatchSpan() {
+    watchLow = UINT32_MAX;
+    watchHigh = 0;
+    for ( uint8_t i = 0; i < 8; ++i ) {
+        if ( watchedChannels & ( 1 << i ) ) {
+            watchLow = channelWatchLow[ i ] < watchLow ? channelWatchLow[ i ] : watchLow;
+            watchHigh = channelWatchHigh[ i ] > watchHigh ? channelWatchHigh[ i ] : watchHigh;
+        }
+    }
+}
+
+static void invalidateWatched( uint32_t low, uint32_t high ) {
+    uint8_t channels = 0x00;
+    for ( uint8_t i = 0; i < 8; ++i ) {
+        if ( ( watchedChannels & ( 1 << i ) ) && low <= channelWatchHigh[ i ] && high >= channelWatchLow[ i ] ) {
+            channels |= 1 << i;
+        }
+    }
+    if ( channels ) {
+        watchedChannels &= ~channels;
+        updateWatchSpan();
+        dmaHDMAInvalidate( channels );
+    }
+}
+
+static inline void checkWatch( uint32_t low, uint32_t high ) {
+    if ( low <= watchHigh && high >= watchLow ) {
+        invalidateWatched( low, high );
+    }
+}
+
+void wramWatchWrites( uint8_t channel, uint32_t low, uint32_t high ) {
+    if ( low <= high ) {
+        watchedChannels |= 1 << channel;
+        channelWatchLow[ channel ] = low;
+        channelWatchHigh[ channel ] = high;
+    }
+    else {
+        watchedChannels &= ~( 1 << channel );
+    }
+    updateWatchSpan();
+}
+
+static inline void setPortAddress( uint32_t wramAddress ) {
+    ports.WMADDl = (uint8_t)( wramAddress & 0x0000FF );
+    ports.WMADDm = (uint8_t)( ( wramAddress >> 8 ) & 0x0000FF );
+    ports.WMADDh = (uint8_t)( ( wramAddress >> 16 ) & 0x000001 );
+}
+
 void wramInitialise() {
     // TODO - memset ram?
     memset( &ports, 0x00, sizeof( WRAMPorts ) );
@@ -28,9 +95,10 @@ void wramBBusAccess( uint8_t addressBus, uint8_t *dataBus, bool writeLine ) {
     addressBus -= 0x80;
     if ( addressBus == 0x00 ) {
         // WMDATA
-        uint32_t wramAddress = ( ( (uint32_t) ( ports.WMADDh & 0x01 ) ) << 16 ) | ( ( (uint32_t) ports.WMADDm ) << 8 ) | ( (uint32_t) ports.WMADDl );
+        uint32_t wramAddress = getPortAddress();
         if( writeLine ) {
             WRAM[ wramAddress ] = *dataBus;
+            checkWatch( wramAddress, wramAddress );
         }
         else {
             *dataBus = WRAM[ wramAddress ];
@@ -52,6 +120,10 @@ void wramBBusAccess( uint8_t addressBus, uint8_t *dataBus, bool writeLine ) {
     }
 }
 
+uint8_t *wramHostPointer( uint32_t wramIndex ) {
+    return &WRAM[ wramIndex & WRAM_ADDRESS_MASK ];
+}
+
 void wramABusAccess( MemoryAddress addressBus, uint8_t *dataBus, bool writeLine ) {
     // Access through A-Bus
     
@@ -60,8 +132,55 @@ void wramABusAccess( MemoryAddress addressBus, uint8_t *dataBus, bool writeLine
 
     if ( writeLine ) {
         WRAM[ wramIndex ] = *dataBus;
+        checkWatch( wramIndex, wramIndex );
     }
     else {
         *dataBus = WRAM[ wramIndex ];
     }
 }
+
+// Bulk WMDATA transfers. Equivalent to length single-byte accesses of 0x2180,
+// but split into at most two contiguous copies around the 17-bit wrap, with the
+// port address written back once at the end.
+void wramBBusBulkWrite( const uint8_t *source, uint32_t length ) {
+    uint32_t wramAddress = getPortAddress();
+    uint32_t remaining = length;
+    while ( remaining > 0 ) {
+        uint32_t chunk = WRAM_SIZE - wramAddress;
+        chunk = chunk < remaining ? chunk : remaining;
+        memcpy( &WRAM[ wramAddress ], source, chunk );
+        checkWatch( wramAddress, wramAddress + chunk - 1 );
+        source += chunk;
+        remaining -= chunk;
+        wramAddress = ( wramAddress + chunk ) & WRAM_ADDRESS_MASK;
+    }
+    setPortAddress( wramAddress );
+}
+
+void wramBBusBulkRead( uint8_t *destination, uint32_t length ) {
+    uint32_t wramAddress = getPortAddress();
+    uint32_t remaining = length;
+    while ( remaining > 0 ) {
+        uint32_t chunk = WRAM_SIZE - wramAddress;
+        chunk = chunk < remaining ? chunk : remaining;
+        memcpy( destination, &WRAM[ wramAddress ], chunk );
+        destination += chunk;
+        remaining -= chunk;
+        wramAddress = ( wramAddress + chunk ) & WRAM_ADDRESS_MASK;
+    }
+    setPortAddress( wramAddress );
+}
+
+void wramBBusBulkFill( uint8_t value, uint32_t length ) {
+    uint32_t wramAddress = getPortAddress();
+    uint32_t remaining = length;
+    while ( remaining > 0 ) {
+        uint32_t chunk = WRAM_SIZE - wramAddress;
+        chunk = chunk < remaining ? chunk : remaining;
+        memset( &WRAM[ wramAddress ], value, chunk );
+        checkWatch( wramAddress, wramAddress + chunk - 1 );
+        remaining -= chunk;
+        wramAddress = ( wramAddress + chunk ) & WRAM_ADDRESS_MASK;
+    }
+    setPortAddress( wramAddress );
+}